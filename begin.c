@@ -1,39 +1,565 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L /* mmap, clock_gettime and getrusage */
+#endif
+
+/* parse_jobs parses functions on a pool of threads */
+#if !defined(_WIN32) && !defined(NO_THREADS)
+#define THREADS
+#endif
+
+/* the JIT emits x86-64 code into memory mapped executable */
+#if defined(__x86_64__) && defined(__linux__) && !defined(NO_JIT)
+#define JIT
+#endif
+
+/* the lexer classifies its input 64 bytes at a time into masks of whitespace, letters and digits */
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(NO_SIMD)
+#define LEX_SIMD
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
+#include <stdint.h>
+#include <time.h>
+#include <signal.h>
+#include <setjmp.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef THREADS
+#include <pthread.h>
+#endif
+
+#ifdef LEX_SIMD
+#include <immintrin.h>
+#endif
 
 enum tk_type
 {
-	keyword,
-	id,
-	uint,
+	id, /* first, so the lookup tables below can use 0 for "not a keyword or punctuator" */
+	integer,
 	num,
-	delim,
-	arrow,
-	eoi /* end of input */
+	eoi, /* end of input */
+	
+	/* keywords */
+	tk_decl,
+	tk_ret,
+	tk_print,
+	tk_if,
+	tk_while,
+	tk_for,
+	tk_and,
+	tk_or,
+	
+	/* punctuators */
+	tk_semi,
+	tk_lparen,
+	tk_rparen,
+	tk_plus,
+	tk_minus,
+	tk_star,
+	tk_slash,
+	tk_less,
+	tk_more,
+	tk_comma,
+	tk_equal,
+	tk_dot,
+	tk_arrow
+};
+
+/* the lexeme of every token that doesn't carry its own */
+char *tk_names[] =
+{
+	"id", "integer", "num", "end of input",
+	"decl", "ret", "print", "if", "while", "for", "and", "or",
+	";", "(", ")", "+", "-", "*", "/", "<", ">", ",", "=", ".", "->"
 };
 
 struct token
 {
 	char *lex; /* lexeme */
 	enum tk_type type;
+	int sym; /* interned id for identifiers and literals, -1 for everything else */
+};
+
+/*
+	every distinct identifier and literal the lexer has seen, numbered in the order they were
+	first seen, so the rest of the compiler can compare them as ints
+*/
+struct interner
+{
+	char **strings; /* by symbol id */
+	int *lengths;
+	unsigned int *hashes;
+	int num_of_strings;
+	int strings_size;
+	
+	int *index; /* open addressing table of symbol ids, -1 for empty */
+	int index_size; /* always a power of 2 */
+	
+	char *pool; /* strings are copied into blocks so they never move */
+	int pool_left;
+};
+
+struct interner interner = {NULL, NULL, NULL, 0, 0, NULL, 0, NULL, 0};
+
+/* FNV-1a, a word at a time while there are 8 bytes left, for long literals and whole functions */
+unsigned int hash_str(const char *str, int len)
+{
+	unsigned int hash = 2166136261u;
+	uint64_t word;
+	
+	int i;
+	for(i = 0; i + 8 <= len; i += 8)
+	{
+		memcpy(&word, str + i, 8);
+		hash ^= (unsigned int)(word ^ (word >> 32));
+		hash *= 16777619u;
+		hash ^= hash >> 15;
+	}
+	
+	for(; i<len; i++)
+	{
+		hash ^= (unsigned char)str[i];
+		hash *= 16777619u;
+	}
+	
+	return hash;
+}
+
+void grow_index(void)
+{
+	free(interner.index);
+	
+	interner.index_size = interner.index_size == 0 ? 1024 : interner.index_size * 2;
+	interner.index = malloc(interner.index_size * sizeof(int));
+	memset(interner.index, -1, interner.index_size * sizeof(int));
+	
+	int i;
+	for(i = 0; i<interner.num_of_strings; i++)
+	{
+		unsigned int h = interner.hashes[i] & (interner.index_size - 1);
+		while(interner.index[h] != -1) h = (h + 1) & (interner.index_size - 1);
+		
+		interner.index[h] = i;
+	}
+}
+
+int intern(const char *str, int len)
+{
+	if(2 * (interner.num_of_strings + 1) > interner.index_size) grow_index();
+	
+	unsigned int hash = hash_str(str, len);
+	unsigned int h = hash & (interner.index_size - 1);
+	
+	while(interner.index[h] != -1)
+	{
+		int sym = interner.index[h];
+		
+		if(interner.hashes[sym] == hash && interner.lengths[sym] == len && memcmp(interner.strings[sym], str, len) == 0) return sym;
+		
+		h = (h + 1) & (interner.index_size - 1);
+	}
+	
+	if(interner.pool_left < len + 1)
+	{
+		interner.pool_left = len + 1 > 65536 ? len + 1 : 65536;
+		interner.pool = malloc(interner.pool_left);
+	}
+	
+	if(interner.num_of_strings == interner.strings_size)
+	{
+		interner.strings_size = interner.strings_size * 2 + 256;
+		interner.strings = realloc(interner.strings, interner.strings_size * sizeof(char *));
+		interner.lengths = realloc(interner.lengths, interner.strings_size * sizeof(int));
+		interner.hashes = realloc(interner.hashes, interner.strings_size * sizeof(unsigned int));
+	}
+	
+	int sym = interner.num_of_strings;
+	interner.num_of_strings++;
+	
+	memcpy(interner.pool, str, len);
+	interner.pool[len] = '\0';
+	
+	interner.strings[sym] = interner.pool;
+	interner.lengths[sym] = len;
+	interner.hashes[sym] = hash;
+	interner.index[h] = sym;
+	
+	interner.pool += len + 1;
+	interner.pool_left -= len + 1;
+	
+	return sym;
+}
+
+/*
+	keywords by (3*first char + last char + length) % 16, which sends each of these eight to a
+	slot of its own, so a lookup is one hash and one compare
+*/
+struct keyword
+{
+	char *str;
+	int len;
+	enum tk_type type;
+};
+
+struct keyword keywords[16] =
+{
+	[1]  = {"or",    2, tk_or},
+	[3]  = {"if",    2, tk_if},
+	[7]  = {"for",   3, tk_for},
+	[9]  = {"print", 5, tk_print},
+	[10] = {"and",   3, tk_and},
+	[12] = {"decl",  4, tk_decl},
+	[13] = {"ret",   3, tk_ret},
+	[15] = {"while", 5, tk_while}
+};
+
+/* id if it isn't a keyword */
+enum tk_type keyword_type(const char *str, int len)
+{
+	struct keyword *kw = &keywords[(3 * (unsigned char)str[0] + (unsigned char)str[len-1] + len) & 15];
+	
+	if(kw->len == len && memcmp(kw->str, str, len) == 0) return kw->type;
+	
+	return id;
+}
+
+/* single char punctuators, "->" is handled in get_delim */
+enum tk_type punctuators[128] =
+{
+	[';'] = tk_semi,
+	['('] = tk_lparen,
+	[')'] = tk_rparen,
+	['+'] = tk_plus,
+	['-'] = tk_minus,
+	['*'] = tk_star,
+	['/'] = tk_slash,
+	['<'] = tk_less,
+	['>'] = tk_more,
+	[','] = tk_comma,
+	['='] = tk_equal,
+	['.'] = tk_dot
+};
+
+/*
+	character classes, in place of ctype, which is slower and goes by the locale. the chars past
+	127 are in none of them
+*/
+#define CL_SPACE 1
+#define CL_DIGIT 2
+#define CL_ALPHA 4
+#define CL_PUNCT 8 /* the single char punctuators, and the '-' of "->" */
+#define CL_END 16 /* '\0' */
+
+#define S CL_SPACE
+#define D CL_DIGIT
+#define A CL_ALPHA
+#define P CL_PUNCT
+#define E CL_END
+unsigned char char_class[256] =
+{
+	E, 0, 0, 0, 0, 0, 0, 0, 0, S, S, S, S, S, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	S, 0, 0, 0, 0, 0, 0, 0, P, P, P, P, P, P, P, P,
+	D, D, D, D, D, D, D, D, D, D, 0, P, P, P, P, 0,
+	0, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,
+	A, A, A, A, A, A, A, A, A, A, A, 0, 0, 0, 0, 0,
+	0, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,
+	A, A, A, A, A, A, A, A, A, A, A, 0, 0, 0, 0, 0
+};
+#undef S
+#undef D
+#undef A
+#undef P
+#undef E
+
+#define IS_SPACE(c) (char_class[(unsigned char)(c)] & CL_SPACE)
+#define IS_DIGIT(c) (char_class[(unsigned char)(c)] & CL_DIGIT)
+#define IS_ALPHA(c) (char_class[(unsigned char)(c)] & CL_ALPHA)
+#define IS_DELIM(c) (char_class[(unsigned char)(c)] & (CL_SPACE | CL_PUNCT | CL_END))
+
+#ifdef THREADS
+#define THREAD_LOCAL __thread
+#else
+#define THREAD_LOCAL
+#endif
+
+/*
+	a run of whitespace, letters and digits, or digits ends at the first char from at on that
+	isn't in it. '\0' is in none of them, so every run stops at the end
+*/
+#ifdef LEX_SIMD
+/*
+	the runs end by bitmasks: a kernel classifies a 64 byte block at once into masks of which of
+	its bytes are in each class, and a run ends at the first byte from where it starts that is
+	out of its mask, one count of trailing zeros instead of a look at every char. the masks of
+	the last block are kept, so at a few chars a token a block is classified once for a dozen
+	tokens or more. the vector kernels' loads are aligned so they never cross into a page past
+	the one the '\0' is in, but they do read before the start and past the end of the string,
+	which the hardware doesn't mind and the address sanitizer does
+*/
+#define NO_ASAN __attribute__((no_sanitize_address))
+#define AVX2 __attribute__((target("avx2")))
+
+#define LEX_BLOCK 64
+
+enum lex_class
+{
+	lex_space,
+	lex_alnum,
+	lex_digit,
+	num_of_lex_classes
 };
 
+struct lex_window
+{
+	const char *block; /* the one the masks are of, NULL for none */
+	uint64_t masks[num_of_lex_classes];
+};
+
+THREAD_LOCAL struct lex_window lex_window;
+
+/* bytes of v in [lo, lo + n), as 0xFF */
+#define SSE2_RANGE(v, lo, n) _mm_cmpgt_epi8(_mm_set1_epi8((char)((n) - 128)), _mm_add_epi8(v, _mm_set1_epi8((char)(128 - (lo)))))
+#define AVX2_RANGE(v, lo, n) _mm256_cmpgt_epi8(_mm256_set1_epi8((char)((n) - 128)), _mm256_add_epi8(v, _mm256_set1_epi8((char)(128 - (lo)))))
+
+__m128i sse2_space(__m128i v) { return _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), SSE2_RANGE(v, '\t', 5)); }
+__m128i sse2_digit(__m128i v) { return SSE2_RANGE(v, '0', 10); }
+__m128i sse2_alpha(__m128i v) { return SSE2_RANGE(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 26); }
+
+AVX2 __m256i avx2_space(__m256i v) { return _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), AVX2_RANGE(v, '\t', 5)); }
+AVX2 __m256i avx2_digit(__m256i v) { return AVX2_RANGE(v, '0', 10); }
+AVX2 __m256i avx2_alpha(__m256i v) { return AVX2_RANGE(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 26); }
+
+NO_ASAN void sse2_classify(const char *str, const char *block)
+{
+	uint64_t space = 0, alnum = 0, digit = 0;
+	
+	int i;
+	for(i = 0; i<LEX_BLOCK; i += 16)
+	{
+		__m128i v = _mm_load_si128((const __m128i *)(block + i));
+		__m128i d = sse2_digit(v);
+		
+		space |= (uint64_t)(unsigned int)_mm_movemask_epi8(sse2_space(v)) << i;
+		alnum |= (uint64_t)(unsigned int)_mm_movemask_epi8(_mm_or_si128(d, sse2_alpha(v))) << i;
+		digit |= (uint64_t)(unsigned int)_mm_movemask_epi8(d) << i;
+	}
+	
+	lex_window.block = block;
+	lex_window.masks[lex_space] = space;
+	lex_window.masks[lex_alnum] = alnum;
+	lex_window.masks[lex_digit] = digit;
+}
+
+NO_ASAN AVX2 void avx2_classify(const char *str, const char *block)
+{
+	uint64_t space = 0, alnum = 0, digit = 0;
+	
+	int i;
+	for(i = 0; i<LEX_BLOCK; i += 32)
+	{
+		__m256i v = _mm256_load_si256((const __m256i *)(block + i));
+		__m256i d = avx2_digit(v);
+		
+		space |= (uint64_t)(unsigned int)_mm256_movemask_epi8(avx2_space(v)) << i;
+		alnum |= (uint64_t)(unsigned int)_mm256_movemask_epi8(_mm256_or_si256(d, avx2_alpha(v))) << i;
+		digit |= (uint64_t)(unsigned int)_mm256_movemask_epi8(d) << i;
+	}
+	
+	lex_window.block = block;
+	lex_window.masks[lex_space] = space;
+	lex_window.masks[lex_alnum] = alnum;
+	lex_window.masks[lex_digit] = digit;
+}
+
+/* the classes' bits in char_class, for a look at every char */
+const unsigned char lex_class_bits[num_of_lex_classes] = {CL_SPACE, CL_ALPHA | CL_DIGIT, CL_DIGIT};
+
+/*
+	the kernel for this CPU, picked on the first call, NULL for scalar, which has no masks and
+	looks at every char. threads that race to pick all pick the same one
+*/
+void pick_classify(const char *str, const char *block);
+
+void (*classify_kernel)(const char *str, const char *block) = pick_classify;
+#endif
+
+char *lex_kernel = "scalar"; /* which it is, once picked */
+
+/*
+	the kernel by name, "scalar", "sse2" or "avx2", in place of the picked one; -1 if this CPU
+	or build hasn't got it. without LEX_SIMD there is only scalar, a look at every char
+*/
+int set_kernels(char *name)
+{
+	if(strcmp(name, "scalar") == 0)
+	{
+#ifdef LEX_SIMD
+		classify_kernel = NULL;
+	} else if(strcmp(name, "sse2") == 0)
+	{
+		classify_kernel = sse2_classify;
+	} else if(strcmp(name, "avx2") == 0 && (__builtin_cpu_init(), __builtin_cpu_supports("avx2")))
+	{
+		classify_kernel = avx2_classify;
+#endif
+	} else
+	{
+		return -1;
+	}
+	
+	lex_kernel = name;
+	
+	return 0;
+}
+
+/* the widest this CPU has */
+void pick_kernels(void)
+{
+	if(set_kernels("avx2") != 0 && set_kernels("sse2") != 0) set_kernels("scalar");
+}
+
+/*
+	forgets the masks of the last block, which has to be done before lexing a string that may
+	have been put where one lexed before was
+*/
+void lex_reset(void)
+{
+#ifdef LEX_SIMD
+	lex_window.block = NULL;
+#endif
+}
+
+#ifdef LEX_SIMD
+/* x86_64 always has sse2, so it never picks scalar */
+void pick_classify(const char *str, const char *block)
+{
+	pick_kernels();
+	
+	classify_kernel(str, block);
+}
+
+/* the bytes of the first block before at are masked off, the blocks after it are classified until one is out of class */
+int span_blocks(const char *str, int at, enum lex_class class)
+{
+	if(classify_kernel == NULL)
+	{
+		while(char_class[(unsigned char)str[at]] & lex_class_bits[class]) at++;
+		
+		return at;
+	}
+	
+	const char *block = (const char *)((uintptr_t)(str + at) & ~(uintptr_t)(LEX_BLOCK - 1));
+	if(block != lex_window.block) classify_kernel(str, block);
+	
+	uint64_t out = ~lex_window.masks[class] & (~(uint64_t)0 << (str + at - block));
+	
+	while(out == 0)
+	{
+		block += LEX_BLOCK;
+		classify_kernel(str, block);
+		out = ~lex_window.masks[class];
+	}
+	
+	return (int)(block - str) + __builtin_ctzll(out);
+}
+
+/* small enough to be inlined for the usual case, a run that ends in the block the masks are of */
+int span_class(const char *str, int at, enum lex_class class)
+{
+	uintptr_t p = (uintptr_t)(str + at);
+	uint64_t out = ~lex_window.masks[class] >> (p & (LEX_BLOCK - 1));
+	
+	if((p & ~(uintptr_t)(LEX_BLOCK - 1)) == (uintptr_t)lex_window.block && out != 0) return at + __builtin_ctzll(out);
+	
+	return span_blocks(str, at, class);
+}
+
+int span_space(const char *str, int at)
+{
+	return span_class(str, at, lex_space);
+}
+
+int span_alnum(const char *str, int at)
+{
+	return span_class(str, at, lex_alnum);
+}
+
+int span_digit(const char *str, int at)
+{
+	return span_class(str, at, lex_digit);
+}
+#else
+int span_space(const char *str, int at)
+{
+	while(IS_SPACE(str[at])) at++;
+	
+	return at;
+}
+
+int span_alnum(const char *str, int at)
+{
+	while(char_class[(unsigned char)str[at]] & (CL_ALPHA | CL_DIGIT)) at++;
+	
+	return at;
+}
+
+int span_digit(const char *str, int at)
+{
+	while(IS_DIGIT(str[at])) at++;
+	
+	return at;
+}
+#endif
+
+/*
+	every error the lexer, symbol tables and parser find goes through compile_error. the threads
+	parse_jobs works ahead on are quiet: they only count their errors, and it falls back to a
+	serial parse to print them in the order a serial compile would
+*/
+THREAD_LOCAL int quiet = 0;
+THREAD_LOCAL int quiet_errors = 0;
+
+void compile_error(char *fmt, ...)
+{
+	if(quiet)
+	{
+		quiet_errors++;
+		return;
+	}
+	
+	va_list list;
+	va_start(list, fmt);
+	vprintf(fmt, list);
+	va_end(list);
+}
+
 int start_panic(char *str, int forward, int *panic, char *errMsg)
 {
-	printf(errMsg, str[forward]);
+	compile_error(errMsg, str[forward]);
 	forward++; /* skip past erroneous char  */
     (*panic) = 1; /* panicking is handled in next_token */
 	
 	return forward;
 }
 
+/* '\0' ends a token as well */
 int isdelim(char c)
 {
-    if(strchr(";()+-*/<>,=.", c) != NULL || isspace(c)) return 1;
+    if(IS_DELIM(c)) return 1;
     
     return 0;
 }
@@ -42,14 +568,24 @@ int get_delim(char *str, int *begin, struct token *tk)
 {
 	int forward = *begin;
 	
-	tk->type = delim;
-	
-	if(str[forward] == '\0') tk->type = eoi;
+	if(str[forward] == '\0')
+	{
+		tk->type = eoi;
+	} else
+	{
+		tk->type = punctuators[(unsigned char)str[forward]];
+	}
 	
 	if(str[forward] == '-')
 	{
 		forward++;
-		if(str[forward] == '>') forward++; /* 2 chars for arrow */
+		
+		/* 2 chars for arrow */
+		if(str[forward] == '>')
+		{
+			tk->type = tk_arrow;
+			forward++;
+		}
 	} else
 	{
 		forward++; /* single char */
@@ -60,7 +596,7 @@ int get_delim(char *str, int *begin, struct token *tk)
 
 int elim_whitespace(char *str, int *begin)
 {
-    while(isspace(str[*begin])) (*begin)++;
+    *begin = span_space(str, *begin);
     
     return *begin;
 }
@@ -71,10 +607,7 @@ int get_id(char *str, int *begin, int *panic, struct token *tk)
 	
 	int forward = *begin;
 	
-    do
-	{
-		forward++;
-	} while(isalpha(str[forward]) || isdigit(str[forward]));
+	forward = span_alnum(str, forward + 1);
 	
 	if(!isdelim(str[forward])) goto PANIC;
 	
@@ -93,22 +626,16 @@ int get_num(char *str, int *begin, int *panic, struct token *tk)
 	char *errMsg;
 	int forward = *begin;
 	
-    do
-    {
-        forward++;
-    } while(isdigit(str[forward]));
+    forward = span_digit(str, forward + 1);
     
     if(str[forward] == '.') 
     {
 		tk->type = num;
 		
 		forward++;
-		if(isdigit(str[forward]))
+		if(IS_DIGIT(str[forward]))
 		{
-			do
-			{
-				forward++;
-			} while(isdigit(str[forward]));
+			forward = span_digit(str, forward + 1);
 		} else
 		{
 			errMsg = "expected a digit, got '%c'\n";
@@ -116,7 +643,7 @@ int get_num(char *str, int *begin, int *panic, struct token *tk)
 		}
     } else /* fall through if unsigned */
 	{
-		tk->type = uint;
+		tk->type = integer;
 	}
     
     if(!isdelim(str[forward])) 
@@ -148,10 +675,10 @@ struct token next_token(char *str, int *begin)
         forward = elim_whitespace(str, begin);
 	
         panic = 0;
-        if(isdigit(str[forward]))
+        if(IS_DIGIT(str[forward]))
         {
             forward = get_num(str, begin, &panic, &temp_tk);
-        } else if(isalpha(str[forward])) 
+        } else if(IS_ALPHA(str[forward])) 
         {
             forward = get_id(str, begin, &panic, &temp_tk);
         } else if(isdelim(str[forward])) /* single char tokens */
@@ -163,19 +690,18 @@ struct token next_token(char *str, int *begin)
         }
     } while(panic == 1); /* keep searching until no longer panicking */
 	
-    /* find length of string, allocate space for it and copy it from str */
-    temp_tk.lex = calloc(forward-(*begin)+1, 1);
-    memcpy(temp_tk.lex, str+(*begin), forward-(*begin));
+	int len = forward-(*begin);
 	
-	if(temp_tk.type == id)
+	if(temp_tk.type == id) temp_tk.type = keyword_type(str+(*begin), len);
+	
+	if(temp_tk.type == id || temp_tk.type == integer || temp_tk.type == num)
 	{
-		char *keywords[8] = {"decl", "ret", "print", "if", "while", "for", "and", "or"};
-		
-		int i;
-		for(i = 0; i<8; i++) 
-		{
-			if(strcmp(temp_tk.lex, keywords[i]) == 0) temp_tk.type = keyword;
-		}
+		temp_tk.sym = intern(str+(*begin), len);
+		temp_tk.lex = interner.strings[temp_tk.sym];
+	} else
+	{
+		temp_tk.sym = -1;
+		temp_tk.lex = tk_names[temp_tk.type];
 	}
 
     (*begin) = forward; /* set begin to forward for later use */
@@ -183,1144 +709,7893 @@ struct token next_token(char *str, int *begin)
     return temp_tk;
 }
 
-enum type
-{
-    var_type,
-    func_type
-};
+/*
+	region allocator for everything that only lives as long as a compile: symbol tables,
+	instructions and their operands. small allocations are bumped out of chained blocks, big ones
+	(the arrays that keep growing) get a block each so arena_grow can realloc them in place, and
+	all of them are released at once by arena_free, so nothing in between has to be freed piece
+	by piece
+*/
+#define ARENA_BLOCK 65536
+#define ARENA_BIG (ARENA_BLOCK / 4) /* anything bigger gets a block to itself */
+#define ARENA_ALIGN 8 /* enough for anything the compiler puts in one, and where data starts after the header */
 
-struct entry
+struct arena_block
 {
-	char *name;
-	enum type type;
-	float rel_addr;
-	int num_of_args;
+	struct arena_block *next;
+	size_t size;
+	size_t used;
+	unsigned char data[];
 };
 
-struct node
+struct arena
 {
-	struct entry *entry;
-	int num_of_entries;
-	struct node *back; /* to implement cactus stack */
+	struct arena_block *block; /* the one being bumped, the rest hang off next */
+	struct arena_block *big; /* the blocks with one big allocation each */
+	size_t allocated; /* bytes handed out, including the copies left behind by arena_grow */
+	size_t reserved; /* bytes of blocks malloced */
 };
 
-struct entry * search_entry(struct node *current, char *name, enum type type)
+struct arena * create_arena(void)
 {
-    struct entry *entry = NULL;
-    
-    while(current != NULL)
-    {
-        int i;
-        for(i = current->num_of_entries; i>0; i--)
-        {
-            if(strcmp(current->entry[i-1].name, name) == 0 && current->entry[i-1].type == type)
-            {
-				entry = &current->entry[i-1];
-				goto found; /* break */
-            }
-        }
-        
-        current = current->back;
-    }
+	struct arena *temp = malloc(sizeof(struct arena));
 	
-	found:
-    
-    if(entry == NULL)
-    {
-        printf("ERROR! '%s' hasn't been declared!\n", name);
-    }
+	temp->block = NULL;
+	temp->big = NULL;
+	temp->allocated = 0;
+	temp->reserved = 0;
 	
-	return entry;
+	return temp;
 }
 
-struct node * create_entry(struct node *current, int rel_addr, char *name, enum type type)
+struct arena_block * new_block(struct arena_block *block, size_t size)
 {
-    if(current == NULL)
-    {
-        printf("ERROR! cannot create entry: no table!\n");
-        exit(-1);
-    }
-    
-    int i;
-    for(i = current->num_of_entries; i>0; i--)
-    {
-        if(strcmp(current->entry[i-1].name, name) == 0 && current->entry[i-1].type == type)
-        {
-            printf("ERROR! redeclaration of '%s'!\n", name);
-        }
-    }
-    
-    current->num_of_entries++;
-    current->entry = realloc(current->entry, current->num_of_entries * sizeof(struct entry));
-    
-    /* temporary so it can be freed later by pop_tb */
-    char *temp_name = calloc(strlen(name)+1, 1);
-    strcat(temp_name, name);
-    
-    current->entry[current->num_of_entries-1].name = temp_name;
-    current->entry[current->num_of_entries-1].type = type;
-    current->entry[current->num_of_entries-1].rel_addr = rel_addr;
-    
-    return current;
+	struct arena_block *temp = realloc(block, sizeof(struct arena_block) + size);
+	if(temp == NULL)
+	{
+		printf("ERROR! out of memory!\n");
+		exit(-1);
+	}
+	
+	temp->size = size;
+	
+	return temp;
 }
 
-struct node * create_st(struct node *current)
+void * arena_alloc(struct arena *arena, size_t size)
 {
-    current = realloc(current, sizeof(struct node));
-    
-    current->entry = NULL;
-    current->num_of_entries = 0;
-    current->back = NULL;
-    
-    return current;
+	size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+	arena->allocated += size;
+	
+	if(size > ARENA_BIG)
+	{
+		struct arena_block *temp = new_block(NULL, size);
+		
+		temp->next = arena->big;
+		temp->used = size;
+		
+		arena->big = temp;
+		arena->reserved += sizeof(struct arena_block) + size;
+		
+		return temp->data;
+	}
+	
+	if(arena->block == NULL || arena->block->size - arena->block->used < size)
+	{
+		struct arena_block *temp = new_block(NULL, ARENA_BLOCK);
+		
+		temp->next = arena->block;
+		temp->used = 0;
+		
+		arena->block = temp;
+		arena->reserved += sizeof(struct arena_block) + ARENA_BLOCK;
+	}
+	
+	void *ptr = arena->block->data + arena->block->used;
+	arena->block->used += size;
+	
+	return ptr;
 }
 
-struct node * push_tb(struct node *current)
+/* like realloc; old_size has to be the size ptr was allocated or last grown with */
+void * arena_grow(struct arena *arena, void *ptr, size_t old_size, size_t new_size)
 {
-    struct node *temp;
-    
-    if(current == NULL)
-    {
-        current = create_st(current);
-    } else
-    {
-        temp = malloc(sizeof(struct node));
-        temp->entry = NULL;
-        temp->num_of_entries = 0;
-        temp->back = current;
-        
-        current = temp;
-    }
-    
-    return current;
+	old_size = (old_size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+	new_size = (new_size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+	
+	if(ptr != NULL && old_size > ARENA_BIG)
+	{
+		struct arena_block **link = &arena->big;
+		while((*link)->data != (unsigned char *)ptr) link = &(*link)->next;
+		
+		struct arena_block *next = (*link)->next;
+		
+		*link = new_block(*link, new_size);
+		(*link)->next = next;
+		(*link)->used = new_size;
+		
+		arena->allocated += new_size - old_size;
+		arena->reserved += new_size - old_size;
+		
+		return (*link)->data;
+	}
+	
+	void *temp = arena_alloc(arena, new_size);
+	if(ptr != NULL) memcpy(temp, ptr, old_size);
+	
+	return temp;
 }
 
-struct node * pop_tb(struct node *current)
+/* moves from's blocks into arena, whose they then are; from is left empty */
+void arena_adopt(struct arena *arena, struct arena *from)
 {
-    if(current == NULL)
-    {
-        printf("ERROR! unable to pop: no table on the stack!\n");
-        exit(-1);
-    }
-    
-    if(current->entry != NULL)
-    {
-        int i;
-        for(i = 0; i<current->num_of_entries; i++)
-        {
-            free(current->entry[i].name);
-        }
-        
-        free(current->entry);
-    }
-    
-    struct node *temp = current->back;
-    free(current);
-    
-    return temp;
+	struct arena_block **link = &arena->block;
+	while(*link != NULL) link = &(*link)->next;
+	*link = from->block;
+	
+	link = &arena->big;
+	while(*link != NULL) link = &(*link)->next;
+	*link = from->big;
+	
+	arena->allocated += from->allocated;
+	arena->reserved += from->reserved;
+	
+	from->block = NULL;
+	from->big = NULL;
+	from->allocated = 0;
+	from->reserved = 0;
 }
 
-enum inst_type
+void arena_free(struct arena *arena)
 {
-    label,
-    decl,
-    push_adr,
-	push_loc,
-    push_val,
-    pop,
-	print,
-    jmpf,
-    jmp,
-	call,
-    param,
-    ret_val,
-    ret_none,
-	set_equal,
-	less_than,
-	more_than,
-	plus,
-	minus,
-	multiply,
-	divide,
-	and,
-	or
+	while(arena->block != NULL)
+	{
+		struct arena_block *temp = arena->block->next;
+		free(arena->block);
+		arena->block = temp;
+	}
+	
+	while(arena->big != NULL)
+	{
+		struct arena_block *temp = arena->big->next;
+		free(arena->big);
+		arena->big = temp;
+	}
+	
+	free(arena);
+}
+
+enum type
+{
+    var_type,
+    func_type
 };
 
-struct inst
+struct entry
 {
-	enum inst_type type;
-	float *args;
+	int sym; /* interned name */
+	enum type type;
+	int rel_addr;
 	int num_of_args;
 };
 
-struct opstack
+struct node
 {
-    float *stack;
-    int top;
+	struct entry *entry;
+	int num_of_entries;
+	int entries_size; /* entries are allocated in bulk, doubling each time */
+	
+	int *index; /* open addressing table of positions in entry keyed by name and type, -1 for empty */
+	int index_size; /* a power of 2, at least twice num_of_entries */
+	
+	struct node *back; /* to implement cactus stack */
 };
 
-struct opstack * create_opstack(void)
+char * sym_name(int sym)
 {
-    struct opstack *temp = malloc(sizeof(struct opstack));
-    
-    temp->stack = NULL;
-    temp->top = -1;
-    
-    return temp;
+	if(sym < 0) return "?"; /* a token that wasn't an id, after a syntax error */
+	
+	return interner.strings[sym];
 }
 
-struct opstack * push_op(struct opstack *op, float n)
+unsigned int entry_hash(int sym, enum type type)
 {
-    op->top++;
-    op->stack = realloc(op->stack, (op->top + 1) * sizeof(float));
-    op->stack[op->top] = n;
-    
-    return op;
+	return ((unsigned int)sym * 2 + type) * 2654435761u;
+}
+
+/* position of the entry in this scope alone, -1 if it isn't there */
+int find_entry(struct node *current, int sym, enum type type)
+{
+	if(current->index_size == 0) return -1;
+	
+	unsigned int h = entry_hash(sym, type) & (current->index_size - 1);
+	
+	while(current->index[h] != -1)
+	{
+		struct entry *entry = &current->entry[current->index[h]];
+		
+		if(entry->sym == sym && entry->type == type) return current->index[h];
+		
+		h = (h + 1) & (current->index_size - 1);
+	}
+	
+	return -1;
+}
+
+/* points the index at position i for i's name and type, replacing an older entry with the same key */
+void index_entry(struct node *current, int i)
+{
+	unsigned int h = entry_hash(current->entry[i].sym, current->entry[i].type) & (current->index_size - 1);
+	
+	while(current->index[h] != -1)
+	{
+		struct entry *entry = &current->entry[current->index[h]];
+		
+		if(entry->sym == current->entry[i].sym && entry->type == current->entry[i].type) break;
+		
+		h = (h + 1) & (current->index_size - 1);
+	}
+	
+	current->index[h] = i;
 }
 
-struct opstack * pop_op(struct opstack *op)
+struct entry * search_entry(struct node *current, int sym, enum type type)
 {
-    if(op->stack != NULL)
+    struct entry *entry = NULL;
+    
+    while(current != NULL)
     {
-        op->top--;
+        int i = find_entry(current, sym, type);
         
-        if(op->top == -1)
-        {
-            op->stack = NULL;
-        } else
+        if(i != -1)
         {
-            op->stack = realloc(op->stack, (op->top + 1) * sizeof(float));
+            entry = &current->entry[i];
+            break;
         }
-    } else
-    {
-        printf("RUNTIME ERROR: unable to pop!\n");
-        exit(-1);
+        
+        current = current->back;
     }
     
-    return op;
+    if(entry == NULL)
+    {
+        compile_error("ERROR! '%s' hasn't been declared!\n", sym_name(sym));
+    }
+	
+	return entry;
 }
 
-struct frame
-{
-    float *locals;
-    int num_of_locals;
-	struct opstack *op;
-	float *ret_val;
-};
-
-struct frstack
-{
-    struct frame *frame;
-    int top;
-};
-
-struct frstack * declare_local(struct frstack *stack, float val)
+struct node * create_entry(struct arena *arena, struct node *current, int rel_addr, int sym, enum type type)
 {
-    stack->frame[stack->top].num_of_locals++;
-    stack->frame[stack->top].locals = realloc(stack->frame[stack->top].locals, stack->frame[stack->top].num_of_locals * sizeof(int));
-    stack->frame[stack->top].locals[stack->frame[stack->top].num_of_locals-1] = val;
+    if(current == NULL)
+    {
+        printf("ERROR! cannot create entry: no table!\n");
+        exit(-1);
+    }
     
-    return stack;
+    if(find_entry(current, sym, type) != -1)
+    {
+        compile_error("ERROR! redeclaration of '%s'!\n", sym_name(sym));
+    }
+    
+    if(current->num_of_entries == current->entries_size)
+    {
+        int old_size = current->entries_size;
+        
+        current->entries_size = current->entries_size == 0 ? 8 : current->entries_size * 2;
+        current->entry = arena_grow(arena, current->entry, old_size * sizeof(struct entry), current->entries_size * sizeof(struct entry));
+    }
+    
+    current->num_of_entries++;
+    
+    current->entry[current->num_of_entries-1].sym = sym;
+    current->entry[current->num_of_entries-1].type = type;
+    current->entry[current->num_of_entries-1].rel_addr = rel_addr;
+    current->entry[current->num_of_entries-1].num_of_args = 0;
+    
+    if(2 * current->num_of_entries > current->index_size)
+    {
+        /* rebuild the index at twice the size */
+        current->index_size = current->index_size == 0 ? 16 : current->index_size * 2;
+        current->index = arena_alloc(arena, current->index_size * sizeof(int));
+        memset(current->index, -1, current->index_size * sizeof(int));
+        
+        int i;
+        for(i = 0; i<current->num_of_entries; i++) index_entry(current, i);
+    } else
+    {
+        index_entry(current, current->num_of_entries-1);
+    }
+    
+    return current;
 }
 
-struct frstack * push_frame(struct frstack *stack)
+struct node * create_st(struct arena *arena)
 {
-    stack->top++;
-    stack->frame = realloc(stack->frame, (stack->top + 1) * sizeof(struct frame));
-    stack->frame[stack->top].locals = NULL;
-    stack->frame[stack->top].num_of_locals = 0;
-	stack->frame[stack->top].op = create_opstack();
-    stack->frame[stack->top].ret_val = NULL;
+    struct node *current = arena_alloc(arena, sizeof(struct node));
     
-    return stack;
+    current->entry = NULL;
+    current->num_of_entries = 0;
+    current->entries_size = 0;
+    current->index = NULL;
+    current->index_size = 0;
+    current->back = NULL;
+    
+    return current;
 }
 
-struct frstack * pop_frame(struct frstack *stack)
+struct node * push_tb(struct arena *arena, struct node *current)
 {
-    if(stack->top > 0)
-    {
-        stack->top--;
-        stack->frame = realloc(stack->frame, (stack->top + 1) * sizeof(struct frame));
-    } else if(stack->top == 0)
+    struct node *temp;
+    
+    if(current == NULL)
     {
-        stack->top--;
-        stack->frame = NULL;
-    } else if(stack->top == -1)
+        current = create_st(arena);
+    } else
     {
-        printf("ERROR: unable to pop, nothing on the stack!\n");
-        exit(-1);
+        temp = create_st(arena);
+        temp->back = current;
+        
+        current = temp;
     }
-	
-	return stack;
+    
+    return current;
 }
 
-void print_top(struct frstack *stack)
+struct node * pop_tb(struct node *current)
 {
-    printf("(");
-	
-	if(stack->frame[stack->top].locals != NULL)
-	{
-		int i;
-		for(i = 0; i<stack->frame[stack->top].num_of_locals; i++)
-		{
-			if(i == 0) printf("%f", stack->frame[stack->top].locals[i]);
-			if(i > 0)  printf(", %f", stack->frame[stack->top].locals[i]);
-		}
+    if(current == NULL)
+    {
+        printf("ERROR! unable to pop: no table on the stack!\n");
+        exit(-1);
     }
-	
-    printf(")\n");
     
-    printf("%d\n", stack->frame[stack->top].num_of_locals);
-	
-	if(stack->frame[stack->top].op->stack == NULL)
-	{
-		printf("NULL\n");
-    } else
+    return current->back; /* the scope itself stays in the arena until the compile is done */
+}
+
+void runtime_error(char *fmt, ...); /* forward declaration for the bignum routines, dumps the trace if there is one */
+
+/*
+	arbitrary precision integers: sign and magnitude, the magnitude in 32 bit limbs with the
+	least significant limb first. values are immutable once built and shared by reference
+	counting between locals, the operand stack and the constant pool
+*/
+struct bignum
+{
+	int refs;
+	int sign; /* 1 or -1, zero is always positive */
+	int size; /* limbs in use, 0 for zero */
+	uint32_t limb[];
+};
+
+/* limb counts at which multiplication switches algorithm, tuned with bench/mul.c */
+#ifndef KARATSUBA_THRESHOLD
+#define KARATSUBA_THRESHOLD 40
+#endif
+
+#ifndef TOOM3_THRESHOLD
+#define TOOM3_THRESHOLD 300
+#endif
+
+#ifndef NTT_THRESHOLD
+#define NTT_THRESHOLD 2500
+#endif
+
+/* and below which decimal conversion goes 9 digits at a time instead of splitting */
+#ifndef DEC_THRESHOLD
+#define DEC_THRESHOLD 60
+#endif
+
+struct bignum * bn_new(int size)
+{
+	struct bignum *temp = malloc(sizeof(struct bignum) + size * sizeof(uint32_t));
+
+	if(temp == NULL)
 	{
-		printf("%f\n", stack->frame[stack->top].op->stack[stack->frame[stack->top].op->top]);
+		runtime_error("out of memory for a %d limb number!", size);
 	}
-	
-    if(stack->frame[stack->top].ret_val == NULL)
-    {
-        printf("NULL\n");
-    } else
-    {
-        printf("%f\n", *(stack->frame[stack->top].ret_val));
-    }
+
+	temp->refs = 1;
+	temp->sign = 1;
+	temp->size = size;
+
+	return temp;
 }
 
-struct frstack * create_frstack(void)
+struct bignum * bn_retain(struct bignum *n)
 {
-    struct frstack *temp_st = malloc(sizeof(struct frstack));
-    temp_st->frame = NULL;
-    temp_st->top = -1;
-    
-    return temp_st;
+	n->refs++;
+
+	return n;
 }
 
-struct vm
+void bn_release(struct bignum *n)
 {
-	struct inst *code;
-	int num_of_insts;
-	float *label_list;
-	int num_of_labels;
-	
-	struct frstack *stack;
-};
+	if(n == NULL) return;
 
-void run_vm(struct vm *vm)
+	n->refs--;
+	if(n->refs == 0) free(n);
+}
+
+/* drops leading zero limbs */
+struct bignum * bn_norm(struct bignum *n)
 {
-	int i;
-	for(i = 0; i<vm->num_of_insts; i++)
-	{
-		struct frame * current_frame = &vm->stack->frame[vm->stack->top];
-		
-		float top = current_frame->op->stack[current_frame->op->top];
-		float topminus1 = current_frame->op->stack[current_frame->op->top-1];
-		float inter;
-		
-		switch(vm->code[i].type)
-		{
-			case decl: vm->stack = declare_local(vm->stack, vm->code[i].args[0]); break;
-			case label: break;
-			
-			case push_adr: current_frame->op = push_op(current_frame->op, vm->code[i].args[0]); break;
-			case push_loc: current_frame->op = push_op(current_frame->op, current_frame->locals[(int)vm->code[i].args[0]]); break;
-			case push_val: current_frame->op = push_op(current_frame->op, vm->code[i].args[0]); break;
-			
-			case set_equal:
-				current_frame->locals[(int)current_frame->op->stack[current_frame->op->top]] = current_frame->op->stack[current_frame->op->top-1];
-				current_frame->op = pop_op(current_frame->op);
-				current_frame->op = pop_op(current_frame->op);
-			break;
+	while(n->size > 0 && n->limb[n->size-1] == 0) n->size--;
+
+	if(n->size == 0) n->sign = 1;
+
+	return n;
+}
+
+struct bignum * bn_from_limbs(const uint32_t *limb, int size)
+{
+	struct bignum *temp = bn_new(size);
+	memcpy(temp->limb, limb, size * sizeof(uint32_t));
+
+	return bn_norm(temp);
+}
+
+struct bignum * bn_from_int(int64_t n)
+{
+	uint64_t mag = n < 0 ? 0 - (uint64_t)n : (uint64_t)n;
+
+	struct bignum *temp = bn_new(2);
+	temp->limb[0] = (uint32_t)mag;
+	temp->limb[1] = (uint32_t)(mag >> 32);
+	temp->sign = n < 0 ? -1 : 1;
+
+	return bn_norm(temp);
+}
+
+int bn_is_zero(struct bignum *n)
+{
+	return n->size == 0;
+}
+
+int mag_cmp(const uint32_t *a, int an, const uint32_t *b, int bn)
+{
+	if(an != bn) return an < bn ? -1 : 1;
+
+	int i;
+	for(i = an-1; i>=0; i--)
+	{
+		if(a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+	}
+
+	return 0;
+}
+
+/* r[0..rn) += a[0..an), an <= rn; returns the carry out of r */
+uint32_t mag_add_to(uint32_t *r, int rn, const uint32_t *a, int an)
+{
+	uint64_t carry = 0;
+
+	int i;
+	for(i = 0; i<an; i++)
+	{
+		carry += (uint64_t)r[i] + a[i];
+		r[i] = (uint32_t)carry;
+		carry >>= 32;
+	}
+
+	for(; i<rn && carry != 0; i++)
+	{
+		carry += r[i];
+		r[i] = (uint32_t)carry;
+		carry >>= 32;
+	}
+
+	return (uint32_t)carry;
+}
+
+/* r[0..rn) -= a[0..an), an <= rn; returns the borrow out of r */
+uint32_t mag_sub_from(uint32_t *r, int rn, const uint32_t *a, int an)
+{
+	uint32_t borrow = 0;
+
+	int i;
+	for(i = 0; i<an; i++)
+	{
+		uint64_t d = (uint64_t)r[i] - a[i] - borrow;
+		r[i] = (uint32_t)d;
+		borrow = (d >> 32) != 0;
+	}
+
+	for(; i<rn && borrow != 0; i++)
+	{
+		borrow = r[i] == 0;
+		r[i]--;
+	}
+
+	return borrow;
+}
+
+void mag_mul(uint32_t *r, const uint32_t *a, int an, const uint32_t *b, int bn);
+
+/* r[0..an+bn) = a * b, the schoolbook way */
+void mag_mul_basecase(uint32_t *r, const uint32_t *a, int an, const uint32_t *b, int bn)
+{
+	memset(r, 0, (an + bn) * sizeof(uint32_t));
+
+	int i, j;
+	for(i = 0; i<an; i++)
+	{
+		uint64_t carry = 0;
+		uint64_t ai = a[i];
+
+		for(j = 0; j<bn; j++)
+		{
+			carry += ai * b[j] + r[i+j];
+			r[i+j] = (uint32_t)carry;
+			carry >>= 32;
+		}
+
+		r[i+bn] = (uint32_t)carry;
+	}
+}
+
+/*
+	r[0..an+bn) = a * b with a = a1*B^m + a0, b = b1*B^m + b0, needs an >= bn >= m where
+	m = ceil(an/2):  a*b = a1*b1*B^2m + ((a0+a1)(b0+b1) - a0*b0 - a1*b1)*B^m + a0*b0
+*/
+void mag_karatsuba(uint32_t *r, const uint32_t *a, int an, const uint32_t *b, int bn)
+{
+	int m = (an + 1) / 2;
+	int a1n = an - m;
+	int b1n = bn - m;
+
+	/* a0*b0 goes in the low 2m limbs and a1*b1 right above it, together they fill r exactly */
+	mag_mul(r, a, m, b, m);
+	mag_mul(r + 2*m, a + m, a1n, b + m, b1n);
+
+	uint32_t *sa = calloc(4*m + 4, sizeof(uint32_t));
+	uint32_t *sb = sa + m + 1;
+	uint32_t *t = sb + m + 1;
+
+	memcpy(sa, a, m * sizeof(uint32_t));
+	mag_add_to(sa, m+1, a + m, a1n);
+
+	memcpy(sb, b, m * sizeof(uint32_t));
+	mag_add_to(sb, m+1, b + m, b1n);
+
+	mag_mul(t, sa, m+1, sb, m+1);
+	mag_sub_from(t, 2*m + 2, r, 2*m);
+	mag_sub_from(t, 2*m + 2, r + 2*m, a1n + b1n);
+
+	/* whatever of the middle term sticks out past the product is zero */
+	int tn = 2*m + 2;
+	if(tn > an + bn - m) tn = an + bn - m;
+
+	mag_add_to(r + m, an + bn - m, t, tn);
+
+	free(sa);
+}
+
+struct bignum * bn_add(struct bignum *a, struct bignum *b);
+struct bignum * bn_sub(struct bignum *a, struct bignum *b);
+struct bignum * bn_mul_small(struct bignum *a, uint32_t m);
+struct bignum * bn_div_small(struct bignum *a, uint32_t d, uint32_t *rem);
+struct bignum * bn_mul(struct bignum *a, struct bignum *b);
+
+/* the limbs a[from..from+k), cut short at an */
+struct bignum * bn_slice(const uint32_t *a, int an, int from, int k)
+{
+	if(from >= an) return bn_new(0);
+	if(from + k > an) k = an - from;
+
+	return bn_from_limbs(a + from, k);
+}
+
+/* p(x) = n0 + n1*x + n2*x^2 evaluated at 1, -1 and 2 */
+void toom3_eval(struct bignum *n0, struct bignum *n1, struct bignum *n2, struct bignum **p1, struct bignum **pm1, struct bignum **p2)
+{
+	struct bignum *even = bn_add(n0, n2);
+
+	*p1 = bn_add(even, n1);
+	*pm1 = bn_sub(even, n1);
+
+	struct bignum *t1 = bn_mul_small(n2, 2);
+	struct bignum *t2 = bn_add(n1, t1);
+	struct bignum *t3 = bn_mul_small(t2, 2);
+	*p2 = bn_add(n0, t3);
+
+	bn_release(even);
+	bn_release(t1);
+	bn_release(t2);
+	bn_release(t3);
+}
+
+/*
+	r[0..an+bn) = a * b by splitting both in three pieces of k limbs, multiplying the pieces'
+	polynomials at 0, 1, -1, 2 and infinity and interpolating; needs an >= bn > an/2
+*/
+void mag_toom3(uint32_t *r, const uint32_t *a, int an, const uint32_t *b, int bn)
+{
+	int k = (an + 2) / 3;
+
+	struct bignum *a0 = bn_slice(a, an, 0, k), *a1 = bn_slice(a, an, k, k), *a2 = bn_slice(a, an, 2*k, k);
+	struct bignum *b0 = bn_slice(b, bn, 0, k), *b1 = bn_slice(b, bn, k, k), *b2 = bn_slice(b, bn, 2*k, k);
+
+	struct bignum *pa1, *pam1, *pa2, *pb1, *pbm1, *pb2;
+	toom3_eval(a0, a1, a2, &pa1, &pam1, &pa2);
+	toom3_eval(b0, b1, b2, &pb1, &pbm1, &pb2);
+
+	struct bignum *v0 = bn_mul(a0, b0);
+	struct bignum *v1 = bn_mul(pa1, pb1);
+	struct bignum *vm1 = bn_mul(pam1, pbm1);
+	struct bignum *v2 = bn_mul(pa2, pb2);
+	struct bignum *vinf = bn_mul(a2, b2);
+
+	/*
+		c2 = (v1 + vm1)/2 - c0 - c4
+		s  = (v1 - vm1)/2                   = c1 + c3
+		t  = (v2 - c0 - 4*c2 - 16*c4)/2     = c1 + 4*c3
+		c3 = (t - s)/3, c1 = s - c3
+	*/
+	struct bignum *c[5];
+	struct bignum *t1, *t2, *t3, *t4, *s, *t;
+
+	c[0] = bn_retain(v0);
+	c[4] = bn_retain(vinf);
+
+	t1 = bn_add(v1, vm1);
+	t2 = bn_div_small(t1, 2, NULL);
+	t3 = bn_sub(t2, v0);
+	c[2] = bn_sub(t3, vinf);
+	bn_release(t1); bn_release(t2); bn_release(t3);
+
+	t1 = bn_sub(v1, vm1);
+	s = bn_div_small(t1, 2, NULL);
+	bn_release(t1);
+
+	t1 = bn_sub(v2, v0);
+	t2 = bn_mul_small(c[2], 4);
+	t3 = bn_sub(t1, t2);
+	bn_release(t1); bn_release(t2);
+	t1 = bn_mul_small(vinf, 16);
+	t4 = bn_sub(t3, t1);
+	t = bn_div_small(t4, 2, NULL);
+	bn_release(t1); bn_release(t3); bn_release(t4);
+
+	t1 = bn_sub(t, s);
+	c[3] = bn_div_small(t1, 3, NULL);
+	c[1] = bn_sub(s, c[3]);
+	bn_release(t1); bn_release(s); bn_release(t);
+
+	/* the coefficients of a product of non-negative polynomials are non-negative */
+	memset(r, 0, (an + bn) * sizeof(uint32_t));
+
+	int i;
+	for(i = 0; i<5; i++)
+	{
+		if(c[i]->size > 0) mag_add_to(r + i*k, an + bn - i*k, c[i]->limb, c[i]->size);
+		bn_release(c[i]);
+	}
+
+	struct bignum *temps[] = {a0, a1, a2, b0, b1, b2, pa1, pam1, pa2, pb1, pbm1, pb2, v0, v1, vm1, v2, vinf};
+	for(i = 0; i<17; i++) bn_release(temps[i]);
+}
+
+/*
+	r[0..an+bn) = a * b by number theoretic transforms. the limbs of a and b are the coefficients
+	of two polynomials, whose product's coefficients are each less than min(an, bn) * 2^64: too
+	big for one 31 bit prime, so the product is taken mod three of them, each with roots of unity
+	for transforms up to 2^NTT_MAX_LOG long, and put back together by the Chinese remainder
+	theorem. each transform's butterflies are split between the threads of a pool, see struct ntt
+*/
+#define NTT_MAX_LOG 24 /* a transform of 2^24 keeps min(an, bn) * 2^64 under the three primes' product */
+
+struct ntt_prime
+{
+	uint32_t p;
+	uint32_t g; /* a primitive root */
+	uint32_t pinv; /* -1/p mod 2^32 */
+	uint32_t r2; /* 2^64 mod p, which takes a number into montgomery form */
+};
+
+/* pinv and r2 are worked out by ntt_setup */
+struct ntt_prime ntt_primes[3] =
+{
+	{.p = 2013265921u, .g = 31}, /* 15 * 2^27 + 1 */
+	{.p = 469762049u, .g = 3}, /* 7 * 2^26 + 1 */
+	{.p = 754974721u, .g = 11} /* 45 * 2^24 + 1 */
+};
+
+/* a * b / 2^32 mod p, for a * b < 2^32 * p */
+uint32_t mont_mul(uint32_t a, uint32_t b, const struct ntt_prime *m)
+{
+	uint64_t t = (uint64_t)a * b;
+	uint32_t q = (uint32_t)t * m->pinv;
+	uint32_t u = (uint32_t)((t + (uint64_t)q * m->p) >> 32);
+	
+	return u >= m->p ? u - m->p : u;
+}
+
+uint32_t mod_add(uint32_t a, uint32_t b, uint32_t p)
+{
+	uint32_t s = a + b;
+	
+	return s >= p ? s - p : s;
+}
+
+uint32_t mod_sub(uint32_t a, uint32_t b, uint32_t p)
+{
+	return a >= b ? a - b : a + p - b;
+}
+
+uint32_t mod_pow(uint32_t a, uint64_t e, uint32_t p)
+{
+	uint64_t r = 1, x = a % p;
+	
+	while(e > 0)
+	{
+		if(e & 1) r = r * x % p;
+		x = x * x % p;
+		e >>= 1;
+	}
+	
+	return (uint32_t)r;
+}
+
+/* fills in what the multiplications need from p */
+void ntt_setup(struct ntt_prime *m)
+{
+	uint32_t inv = m->p; /* right in the low 3 bits, and each step doubles that */
+	
+	int i;
+	for(i = 0; i<4; i++) inv *= 2 - m->p * inv;
+	
+	m->pinv = 0 - inv;
+	
+	uint64_t r = ((uint64_t)1 << 32) % m->p;
+	m->r2 = (uint32_t)(r * r % m->p);
+}
+
+/*
+	the butterflies first..end of one stage of a transform of n, whose blocks are len long; inverse
+	for the stages from bit reversed order back to natural, otherwise from natural to bit reversed.
+	roots are w^0 .. w^(n/2 - 1) for the whole transform in montgomery form, w being a primitive nth
+	root of unity or, for inverse, its inverse. the butterflies are numbered block by block, so a
+	stage can be split into runs of them that touch none of the same elements, and the runs of the
+	stages whose blocks are no longer than a run's elements stay within those elements
+*/
+void ntt_butterflies(uint32_t *x, int n, int len, int first, int end, const uint32_t *roots, const struct ntt_prime *m, int inverse)
+{
+	int half = len / 2, step = n / len;
+	int k = first;
+	
+	while(k < end)
+	{
+		uint32_t *lo = x + k / half * len, *hi = lo + half;
+		int j = k % half;
+		int stop = end - k < half - j ? j + end - k : half;
+		
+		k += stop - j;
+		
+		if(inverse)
+		{
+			for(; j<stop; j++)
+			{
+				uint32_t u = lo[j], v = mont_mul(hi[j], roots[j*step], m);
+				
+				lo[j] = mod_add(u, v, m->p);
+				hi[j] = mod_sub(u, v, m->p);
+			}
+		} else
+		{
+			for(; j<stop; j++)
+			{
+				uint32_t u = lo[j], v = hi[j];
+				
+				lo[j] = mod_add(u, v, m->p);
+				hi[j] = mont_mul(mod_sub(u, v, m->p), roots[j*step], m);
+			}
+		}
+	}
+}
+
+/*
+	one multiplication's transforms, worked through in steps that ntt_parallel hands out in parts.
+	part i of a step takes elements i*n/parts up to the next part's of every array, or the
+	butterflies i*n/2/parts up to the next part's of one stage of every transform. a stage's blocks
+	are longer than a part's elements until the last log2(n/parts) of them, so each of those stages
+	is a step of its own, and the rest are done together in one: a part's butterflies are then in
+	blocks of its own elements, and no other part reads or writes them
+*/
+enum ntt_step
+{
+	ntt_make_roots,     /* each prime's roots, and their inverses */
+	ntt_load,           /* a and b into montgomery form for each prime, padded with zeros */
+	ntt_forward_stage,  /* one stage with blocks longer than a part, len */
+	ntt_forward_blocks, /* the rest of them, within each part */
+	ntt_multiply,       /* the transforms multiplied, and divided by n ahead of the inverse */
+	ntt_inverse_blocks, /* the inverse's stages within each part */
+	ntt_inverse_stage,  /* then one at a time, len */
+	ntt_garner          /* count limbs of r with a carry for each part's limbs, see ntt_product */
+};
+
+struct ntt
+{
+	const uint32_t *a, *b;
+	int an, bn;
+	int log;
+	int square; /* a and b are the same, so b needn't be transformed */
+	int parts; /* a power of two */
+	
+	struct ntt_prime primes[3];
+	uint32_t *fa[3], *fb[3];
+	uint32_t *roots[3], *inverse_roots[3];
+	uint32_t n_inv[3];
+	
+	enum ntt_step step;
+	int len;
+	
+	uint32_t *r;
+	int count;
+	uint64_t *carries;
+};
+
+void ntt_part(void *arg, int part)
+{
+	struct ntt *ntt = arg;
+	int n = 1 << ntt->log;
+	int size = n / ntt->parts, first = part * size; /* elements, and half of them butterflies */
+	int transforms = ntt->square ? 3 : 6; /* a for each prime, then b */
+	
+	int i, k, len;
+	switch(ntt->step)
+	{
+		case ntt_make_roots:
+			for(k = 0; k<3; k++)
+			{
+				struct ntt_prime *m = &ntt->primes[k];
+				
+				uint32_t w = mod_pow(m->g, (m->p - 1) >> ntt->log, m->p);
+				uint32_t wi = mod_pow(w, m->p - 2, m->p);
+				uint32_t mw = mont_mul(w, m->r2, m), mwi = mont_mul(wi, m->r2, m);
+				
+				/* from w^(first/2) on, so every part can start on its own */
+				uint32_t r = mont_mul(mod_pow(w, first / 2, m->p), m->r2, m);
+				uint32_t ri = mont_mul(mod_pow(wi, first / 2, m->p), m->r2, m);
+				
+				for(i = first / 2; i<(first + size) / 2; i++)
+				{
+					ntt->roots[k][i] = r;
+					ntt->inverse_roots[k][i] = ri;
+					r = mont_mul(r, mw, m);
+					ri = mont_mul(ri, mwi, m);
+				}
+			}
+		break;
+		
+		case ntt_load:
+			for(k = 0; k<transforms; k++)
+			{
+				struct ntt_prime *m = &ntt->primes[k % 3];
+				const uint32_t *src = k < 3 ? ntt->a : ntt->b;
+				int src_size = k < 3 ? ntt->an : ntt->bn;
+				uint32_t *x = k < 3 ? ntt->fa[k] : ntt->fb[k-3];
+				
+				for(i = first; i<first + size; i++) x[i] = i < src_size ? mont_mul(src[i], m->r2, m) : 0;
+			}
+		break;
+		
+		case ntt_forward_stage:
+		case ntt_forward_blocks:
+			for(k = 0; k<transforms; k++)
+			{
+				uint32_t *x = k < 3 ? ntt->fa[k] : ntt->fb[k-3];
+				
+				if(ntt->step == ntt_forward_stage)
+				{
+					ntt_butterflies(x, n, ntt->len, first / 2, (first + size) / 2, ntt->roots[k % 3], &ntt->primes[k % 3], 0);
+				} else
+				{
+					for(len = size; len>=2; len >>= 1) ntt_butterflies(x, n, len, first / 2, (first + size) / 2, ntt->roots[k % 3], &ntt->primes[k % 3], 0);
+				}
+			}
+		break;
+		
+		case ntt_multiply:
+			for(k = 0; k<3; k++)
+			{
+				struct ntt_prime *m = &ntt->primes[k];
+				uint32_t *x = ntt->fa[k], *y = ntt->square ? ntt->fa[k] : ntt->fb[k];
+				
+				/* the inverse is linear, so dividing by n first is the same; out of montgomery form along with it */
+				for(i = first; i<first + size; i++) x[i] = mont_mul(mont_mul(x[i], y[i], m), ntt->n_inv[k], m);
+			}
+		break;
+		
+		case ntt_inverse_blocks:
+		case ntt_inverse_stage:
+			for(k = 0; k<3; k++)
+			{
+				if(ntt->step == ntt_inverse_stage)
+				{
+					ntt_butterflies(ntt->fa[k], n, ntt->len, first / 2, (first + size) / 2, ntt->inverse_roots[k], &ntt->primes[k], 1);
+				} else
+				{
+					for(len = 2; len<=size; len <<= 1) ntt_butterflies(ntt->fa[k], n, len, first / 2, (first + size) / 2, ntt->inverse_roots[k], &ntt->primes[k], 1);
+				}
+			}
+		break;
+		
+		case ntt_garner:
+		{
+			/*
+				Garner's: the coefficient is x = r0 + p0*y1 + p0*p1*y2 with y1 < p1 and y2 < p2, where
+				y1 = (r1 - r0) / p0 mod p1 and y2 = (r2 - r0 - p0*y1) / (p0*p1) mod p2. the mod p1 and
+				p2 sums are done in montgomery form
+			*/
+			struct ntt_prime *m0 = &ntt->primes[0], *m1 = &ntt->primes[1], *m2 = &ntt->primes[2];
+			
+			uint32_t inv01 = mod_pow(m0->p % m1->p, m1->p - 2, m1->p);
+			uint32_t inv012 = mod_pow((uint32_t)((uint64_t)m0->p * m1->p % m2->p), m2->p - 2, m2->p);
+			uint32_t p0_r2 = mont_mul(mont_mul(m0->p % m2->p, m2->r2, m2), m2->r2, m2); /* p0 * 2^64, so y1 * p0 comes out in montgomery form */
+			uint64_t p01 = (uint64_t)m0->p * m1->p;
+			
+			uint64_t carry = 0; /* below 2^57, a coefficient's most over 2^32 */
+			
+			int end = (int)((long long)ntt->count * (part + 1) / ntt->parts);
+			for(i = (int)((long long)ntt->count * part / ntt->parts); i<end; i++)
+			{
+				uint32_t r0 = ntt->fa[0][i], r1 = ntt->fa[1][i], r2 = ntt->fa[2][i];
+				
+				uint32_t y1 = mont_mul(mod_sub(mont_mul(r1, m1->r2, m1), mont_mul(r0, m1->r2, m1), m1->p), inv01, m1);
+				
+				uint32_t t = mod_add(mont_mul(r0, m2->r2, m2), mont_mul(y1, p0_r2, m2), m2->p);
+				uint32_t y2 = mont_mul(mod_sub(mont_mul(r2, m2->r2, m2), t, m2->p), inv012, m2);
+				
+				/* x + carry, a limb out and the rest carried, with p0*p1*y2 split at 32 bits */
+				uint64_t sum = carry + r0 + (uint64_t)m0->p * y1 + (p01 & 0xFFFFFFFFu) * y2;
+				
+				ntt->r[i] = (uint32_t)sum;
+				carry = (sum >> 32) + (p01 >> 32) * y2;
+			}
+			
+			ntt->carries[part] = carry;
+		}
+		break;
+	}
+}
+
+/*
+	the threads ntt_parallel hands parts out to, started the first time a multiplication wants
+	them and kept for the rest of the run: ntt_threads - 1 of them, or one less than there are
+	processors, since the thread that asked works on the parts as well
+*/
+#ifdef THREADS
+struct ntt_pool
+{
+	pthread_mutex_t use; /* held by the thread whose step the pool is on, one at a time */
+	pthread_mutex_t lock; /* for the rest */
+	pthread_cond_t work;
+	pthread_cond_t done;
+	int num_of_workers;
+	
+	void (*task)(void *arg, int part);
+	void *arg;
+	int parts;
+	int next; /* the part to hand out next */
+	int left; /* parts not finished yet */
+};
+
+struct ntt_pool ntt_pool =
+{
+	.use = PTHREAD_MUTEX_INITIALIZER,
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.work = PTHREAD_COND_INITIALIZER,
+	.done = PTHREAD_COND_INITIALIZER
+};
+
+pthread_once_t ntt_pool_once = PTHREAD_ONCE_INIT;
+#endif
+
+/* threads for the transforms, 0 for one per processor; 1 keeps them on the thread that multiplies */
+int ntt_threads = 0;
+
+/*
+	set on the threads of a pool, this one's, the runner's and parse_jobs', which already have
+	the other processors busy, so what they multiply doesn't start on more of them
+*/
+THREAD_LOCAL int pool_thread = 0;
+
+#ifdef THREADS
+/* takes parts of the step being worked on as long as there are any, and waits for the next */
+void * ntt_worker(void *arg)
+{
+	pool_thread = 1;
+	
+	pthread_mutex_lock(&ntt_pool.lock);
+	
+	for(;;)
+	{
+		while(ntt_pool.next >= ntt_pool.parts) pthread_cond_wait(&ntt_pool.work, &ntt_pool.lock);
+		
+		int part = ntt_pool.next++;
+		void (*task)(void *, int) = ntt_pool.task;
+		void *task_arg = ntt_pool.arg;
+		
+		pthread_mutex_unlock(&ntt_pool.lock);
+		
+		task(task_arg, part);
+		
+		pthread_mutex_lock(&ntt_pool.lock);
+		
+		ntt_pool.left--;
+		if(ntt_pool.left == 0) pthread_cond_signal(&ntt_pool.done);
+	}
+	
+	return NULL;
+}
+
+void start_ntt_pool(void)
+{
+	int threads = ntt_threads;
+	if(threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	
+	/* as many as could be started, none of them means the parts are all done by whoever asks */
+	for(ntt_pool.num_of_workers = 0; ntt_pool.num_of_workers<threads - 1; ntt_pool.num_of_workers++)
+	{
+		pthread_t thread;
+		
+		if(pthread_create(&thread, NULL, ntt_worker, NULL) != 0) break;
+		pthread_detach(thread);
+	}
+}
+#endif
+
+/* task(arg, part) for every part, on the pool where it can be; returns once they have all run */
+void ntt_parallel(void (*task)(void *arg, int part), void *arg, int parts)
+{
+	int i;
+	
+#ifdef THREADS
+	if(parts > 1 && ntt_threads != 1 && !pool_thread)
+	{
+		pthread_once(&ntt_pool_once, start_ntt_pool);
+		
+		/* another thread's multiplication has the pool, this one goes on without it */
+		if(ntt_pool.num_of_workers > 0 && pthread_mutex_trylock(&ntt_pool.use) == 0)
+		{
+			pthread_mutex_lock(&ntt_pool.lock);
+			
+			ntt_pool.task = task;
+			ntt_pool.arg = arg;
+			ntt_pool.parts = parts;
+			ntt_pool.next = 0;
+			ntt_pool.left = parts;
+			pthread_cond_broadcast(&ntt_pool.work);
+			
+			while(ntt_pool.next < parts)
+			{
+				int part = ntt_pool.next++;
+				pthread_mutex_unlock(&ntt_pool.lock);
+				
+				task(arg, part);
+				
+				pthread_mutex_lock(&ntt_pool.lock);
+				ntt_pool.left--;
+			}
+			
+			while(ntt_pool.left > 0) pthread_cond_wait(&ntt_pool.done, &ntt_pool.lock);
+			
+			pthread_mutex_unlock(&ntt_pool.lock);
+			pthread_mutex_unlock(&ntt_pool.use);
+			
+			return;
+		}
+	}
+#endif
+	
+	for(i = 0; i<parts; i++) task(arg, i);
+}
+
+#define NTT_GRAIN 4096 /* elements of each array a part gets at least, less isn't worth handing to another thread */
+#define NTT_MAX_PARTS 64
+
+/* one step of every part */
+void ntt_step(struct ntt *ntt, enum ntt_step step, int len)
+{
+	ntt->step = step;
+	ntt->len = len;
+	
+	ntt_parallel(ntt_part, ntt, ntt->parts);
+}
+
+/*
+	the coefficients of a * b mod x^(2^log) - 1 as count limbs of r, returning what carries out of
+	the last one. that is the product itself when 2^log >= an + bn - 1, and it wrapped around
+	when it is shorter
+*/
+uint64_t ntt_product(uint32_t *r, int count, const uint32_t *a, int an, const uint32_t *b, int bn, int log)
+{
+	struct ntt ntt;
+	
+	ntt.a = a;
+	ntt.b = b;
+	ntt.an = an;
+	ntt.bn = bn;
+	ntt.square = a == b && an == bn;
+	ntt.log = log;
+	ntt.r = r;
+	ntt.count = count;
+	
+	int n = 1 << ntt.log;
+	
+	/* the same parts on any number of threads, so the work is too */
+	ntt.parts = 1;
+	while(ntt.parts < NTT_MAX_PARTS && n / ntt.parts >= 2 * NTT_GRAIN) ntt.parts *= 2;
+	
+	int size = n / ntt.parts;
+	
+	int i;
+	for(i = 0; i<3; i++)
+	{
+		ntt.primes[i] = ntt_primes[i];
+		ntt_setup(&ntt.primes[i]);
+		ntt.n_inv[i] = mod_pow(n, ntt.primes[i].p - 2, ntt.primes[i].p);
+		
+		ntt.fa[i] = malloc(n * sizeof(uint32_t));
+		ntt.fb[i] = ntt.square ? NULL : malloc(n * sizeof(uint32_t));
+		ntt.roots[i] = malloc((n / 2 + 1) * sizeof(uint32_t));
+		ntt.inverse_roots[i] = malloc((n / 2 + 1) * sizeof(uint32_t));
+	}
+	
+	ntt.carries = malloc(ntt.parts * sizeof(uint64_t));
+	
+	ntt_step(&ntt, ntt_make_roots, 0);
+	ntt_step(&ntt, ntt_load, 0);
+	
+	int len;
+	for(len = n; len>size; len >>= 1) ntt_step(&ntt, ntt_forward_stage, len);
+	ntt_step(&ntt, ntt_forward_blocks, 0);
+	
+	ntt_step(&ntt, ntt_multiply, 0);
+	
+	ntt_step(&ntt, ntt_inverse_blocks, 0);
+	for(len = 2 * size; len<=n; len <<= 1) ntt_step(&ntt, ntt_inverse_stage, len);
+	
+	ntt_step(&ntt, ntt_garner, 0);
+	
+	/* each part's carry goes into the bottom of the next part's limbs, and what it carries out of them on */
+	uint64_t carry = ntt.carries[0];
+	
+	int part;
+	for(part = 1; part<ntt.parts; part++)
+	{
+		i = (int)((long long)count * part / ntt.parts);
+		int end = (int)((long long)count * (part + 1) / ntt.parts);
+		
+		for(; carry != 0 && i<end; i++)
+		{
+			uint64_t sum = (uint64_t)r[i] + (uint32_t)carry;
+			
+			r[i] = (uint32_t)sum;
+			carry = (carry >> 32) + (sum >> 32);
+		}
+		
+		carry += ntt.carries[part];
+	}
+	
+	for(i = 0; i<3; i++)
+	{
+		free(ntt.fa[i]);
+		free(ntt.fb[i]);
+		free(ntt.roots[i]);
+		free(ntt.inverse_roots[i]);
+	}
+	
+	free(ntt.carries);
+	
+	return carry;
+}
+
+/* needs an + bn - 1 <= 2^NTT_MAX_LOG */
+void mag_ntt(uint32_t *r, const uint32_t *a, int an, const uint32_t *b, int bn)
+{
+	int log = 0;
+	while((1 << log) < an + bn - 1) log++;
+	
+	r[an + bn - 1] = (uint32_t)ntt_product(r, an + bn - 1, a, an, b, bn, log);
+}
+
+/*
+	r[0..2^log) = a * b mod B^(2^log) - 1, for an and bn up to 2^log <= 2^NTT_MAX_LOG. B^(2^log)
+	being 1 mod that, what carries out of the top limb goes back in at the bottom. the transform
+	is half as long as the whole product's, for a remainder that is known to be smaller
+*/
+void mag_ntt_wrap(uint32_t *r, const uint32_t *a, int an, const uint32_t *b, int bn, int log)
+{
+	int n = 1 << log;
+	uint64_t carry = ntt_product(r, n, a, an, b, bn, log);
+	
+	while(carry != 0)
+	{
+		uint32_t c[2] = {(uint32_t)carry, (uint32_t)(carry >> 32)};
+		carry = mag_add_to(r, n, c, 2);
+	}
+}
+
+/* r[0..an+bn) = a * b, picking the algorithm by the size of the smaller operand */
+void mag_mul(uint32_t *r, const uint32_t *a, int an, const uint32_t *b, int bn)
+{
+	if(an < bn)
+	{
+		const uint32_t *temp = a; a = b; b = temp;
+		int temp_n = an; an = bn; bn = temp_n;
+	}
+
+	if(bn == 0)
+	{
+		memset(r, 0, an * sizeof(uint32_t));
+	} else if(bn < KARATSUBA_THRESHOLD)
+	{
+		mag_mul_basecase(r, a, an, b, bn);
+	} else if(bn >= NTT_THRESHOLD && an + bn - 1 <= 1 << NTT_MAX_LOG)
+	{
+		/* the transforms don't mind the operands being lopsided */
+		mag_ntt(r, a, an, b, bn);
+	} else if(an >= 2*bn)
+	{
+		/* lopsided: multiply b by bn limb chunks of a and add them up */
+		uint32_t *t = malloc(2 * bn * sizeof(uint32_t));
+
+		memset(r, 0, (an + bn) * sizeof(uint32_t));
+
+		int i;
+		for(i = 0; i<an; i += bn)
+		{
+			int chunk = an - i < bn ? an - i : bn;
+
+			mag_mul(t, a + i, chunk, b, bn);
+			mag_add_to(r + i, an + bn - i, t, chunk + bn);
+		}
+
+		free(t);
+	} else if(bn < TOOM3_THRESHOLD)
+	{
+		mag_karatsuba(r, a, an, b, bn);
+	} else
+	{
+		mag_toom3(r, a, an, b, bn);
+	}
+}
+
+/*
+	q[0..an-bn+1) = a / b and r[0..bn) = a % b, Knuth's algorithm D as written in Hacker's Delight;
+	needs an >= bn >= 2 and b[bn-1] != 0
+*/
+void mag_divmod(uint32_t *q, uint32_t *r, const uint32_t *a, int an, const uint32_t *b, int bn)
+{
+	uint32_t *un = malloc((an + 1 + bn) * sizeof(uint32_t));
+	uint32_t *vn = un + an + 1;
+
+	/* shift so the divisor's top limb has its high bit set */
+	int s = 0;
+	while((b[bn-1] << s & 0x80000000u) == 0) s++;
+
+	int i, j;
+	for(i = bn-1; i>0; i--) vn[i] = (b[i] << s) | (uint32_t)((uint64_t)b[i-1] >> (32 - s));
+	vn[0] = b[0] << s;
+
+	un[an] = (uint32_t)((uint64_t)a[an-1] >> (32 - s));
+	for(i = an-1; i>0; i--) un[i] = (a[i] << s) | (uint32_t)((uint64_t)a[i-1] >> (32 - s));
+	un[0] = a[0] << s;
+
+	for(j = an - bn; j>=0; j--)
+	{
+		uint64_t num = ((uint64_t)un[j+bn] << 32) | un[j+bn-1];
+		uint64_t qhat = num / vn[bn-1];
+		uint64_t rhat = num - qhat * vn[bn-1];
+
+		while(qhat > 0xFFFFFFFFu || qhat * vn[bn-2] > ((rhat << 32) | un[j+bn-2]))
+		{
+			qhat--;
+			rhat += vn[bn-1];
+			if(rhat > 0xFFFFFFFFu) break;
+		}
+
+		/* multiply and subtract */
+		int64_t k = 0, t;
+		for(i = 0; i<bn; i++)
+		{
+			uint64_t p = qhat * vn[i];
+			t = (int64_t)un[i+j] - k - (int64_t)(p & 0xFFFFFFFFu);
+			un[i+j] = (uint32_t)t;
+			k = (int64_t)(p >> 32) - (t >> 32);
+		}
+		t = (int64_t)un[j+bn] - k;
+		un[j+bn] = (uint32_t)t;
+
+		q[j] = (uint32_t)qhat;
+
+		/* subtracted too much, add one divisor back */
+		if(t < 0)
+		{
+			q[j]--;
+
+			uint64_t carry = 0;
+			for(i = 0; i<bn; i++)
+			{
+				carry += (uint64_t)un[i+j] + vn[i];
+				un[i+j] = (uint32_t)carry;
+				carry >>= 32;
+			}
+			un[j+bn] += (uint32_t)carry;
+		}
+	}
+
+	if(r != NULL)
+	{
+		for(i = 0; i<bn-1; i++) r[i] = (un[i] >> s) | (uint32_t)((uint64_t)un[i+1] << (32 - s));
+		r[bn-1] = un[bn-1] >> s;
+	}
+
+	free(un);
+}
+
+int bn_cmp(struct bignum *a, struct bignum *b)
+{
+	if(a->sign != b->sign) return a->sign < b->sign ? -1 : 1;
+
+	return a->sign * mag_cmp(a->limb, a->size, b->limb, b->size);
+}
+
+/* a + b*bsign */
+struct bignum * bn_add_signed(struct bignum *a, struct bignum *b, int bsign)
+{
+	struct bignum *temp;
+	bsign *= b->sign;
+
+	if(a->sign == bsign)
+	{
+		if(a->size < b->size)
+		{
+			struct bignum *swap = a; a = b; b = swap;
+		}
+
+		temp = bn_new(a->size + 1);
+		memcpy(temp->limb, a->limb, a->size * sizeof(uint32_t));
+		temp->limb[a->size] = mag_add_to(temp->limb, a->size, b->limb, b->size);
+		temp->sign = bsign;
+	} else
+	{
+		int sign = a->sign;
+
+		if(mag_cmp(a->limb, a->size, b->limb, b->size) < 0)
+		{
+			struct bignum *swap = a; a = b; b = swap;
+			sign = bsign;
+		}
+
+		temp = bn_new(a->size);
+		memcpy(temp->limb, a->limb, a->size * sizeof(uint32_t));
+		mag_sub_from(temp->limb, a->size, b->limb, b->size);
+		temp->sign = sign;
+	}
+
+	return bn_norm(temp);
+}
+
+struct bignum * bn_add(struct bignum *a, struct bignum *b)
+{
+	return bn_add_signed(a, b, 1);
+}
+
+struct bignum * bn_sub(struct bignum *a, struct bignum *b)
+{
+	return bn_add_signed(a, b, -1);
+}
+
+struct bignum * bn_mul(struct bignum *a, struct bignum *b)
+{
+	struct bignum *temp = bn_new(a->size + b->size);
+
+	mag_mul(temp->limb, a->limb, a->size, b->limb, b->size);
+	temp->sign = a->sign * b->sign;
+
+	return bn_norm(temp);
+}
+
+struct bignum * bn_mul_small(struct bignum *a, uint32_t m)
+{
+	struct bignum *temp = bn_new(a->size + 1);
+	uint64_t carry = 0;
+
+	int i;
+	for(i = 0; i<a->size; i++)
+	{
+		carry += (uint64_t)a->limb[i] * m;
+		temp->limb[i] = (uint32_t)carry;
+		carry >>= 32;
+	}
+	temp->limb[a->size] = (uint32_t)carry;
+	temp->sign = a->sign;
+
+	return bn_norm(temp);
+}
+
+/* quotient truncated toward zero, the magnitude of the remainder goes in rem */
+struct bignum * bn_div_small(struct bignum *a, uint32_t d, uint32_t *rem)
+{
+	struct bignum *temp = bn_new(a->size);
+	uint64_t r = 0;
+
+	int i;
+	for(i = a->size-1; i>=0; i--)
+	{
+		r = r << 32 | a->limb[i];
+		temp->limb[i] = (uint32_t)(r / d);
+		r %= d;
+	}
+	temp->sign = a->sign;
+
+	if(rem != NULL) *rem = (uint32_t)r;
+
+	return bn_norm(temp);
+}
+
+/* quotient truncated toward zero, like C's integer division */
+struct bignum * bn_div(struct bignum *a, struct bignum *b)
+{
+	if(bn_is_zero(b))
+	{
+		runtime_error("division by zero!");
+	}
+
+	struct bignum *temp;
+
+	if(mag_cmp(a->limb, a->size, b->limb, b->size) < 0)
+	{
+		temp = bn_new(0);
+	} else if(b->size == 1)
+	{
+		temp = bn_div_small(a, b->limb[0], NULL);
+	} else
+	{
+		temp = bn_new(a->size - b->size + 1);
+		mag_divmod(temp->limb, NULL, a->limb, a->size, b->limb, b->size);
+	}
+
+	temp->sign = a->sign * b->sign;
+
+	return bn_norm(temp);
+}
+
+/*
+	decimal conversion in both directions splits the number around a power of ten with half its
+	digits, 10^(9*2^k), so the work is in a few big multiplications instead of a pass over the
+	whole number for every 9 digits. the powers, and the reciprocals division by them is done
+	with, are worked out the first time they are needed and kept for the life of the process
+*/
+#define TEN_POWERS 32
+
+struct bignum *ten_powers[TEN_POWERS]; /* 10^(9*2^k) */
+struct bignum *ten_recips[TEN_POWERS]; /* B^2m / each, m being its size in limbs, or 1 less, see ten_recip */
+
+#ifdef THREADS
+pthread_mutex_t ten_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#define TEN_LOAD(p) __atomic_load_n(&(p), __ATOMIC_ACQUIRE)
+#define TEN_STORE(p, n) __atomic_store_n(&(p), n, __ATOMIC_RELEASE)
+#define TEN_LOCK() pthread_mutex_lock(&ten_lock)
+#define TEN_UNLOCK() pthread_mutex_unlock(&ten_lock)
+#else
+#define TEN_LOAD(p) (p)
+#define TEN_STORE(p, n) ((p) = (n))
+#define TEN_LOCK()
+#define TEN_UNLOCK()
+#endif
+
+/* n * B^k, or for negative k n / B^-k truncated toward zero, B being 2^32 */
+struct bignum * bn_shift(struct bignum *n, int k)
+{
+	if(k < 0)
+	{
+		struct bignum *temp = bn_slice(n->limb, n->size, -k, n->size);
+		temp->sign = n->sign;
+
+		return bn_norm(temp);
+	}
+
+	if(n->size == 0) return bn_new(0);
+
+	struct bignum *temp = bn_new(n->size + k);
+	memset(temp->limb, 0, k * sizeof(uint32_t));
+	memcpy(temp->limb + k, n->limb, n->size * sizeof(uint32_t));
+	temp->sign = n->sign;
+
+	return temp;
+}
+
+/* B^k */
+struct bignum * bn_limb_power(int k)
+{
+	struct bignum *temp = bn_new(k + 1);
+	memset(temp->limb, 0, k * sizeof(uint32_t));
+	temp->limb[k] = 1;
+
+	return temp;
+}
+
+/*
+	c - a*b for a difference known to be less than B^(2^log) / 2 either way. it is worked out
+	mod B^(2^log) - 1, where a*b takes a transform half as long as the whole product's when the
+	difference is about as long as a, and which half of that range it lands in gives the sign.
+	c and a*b can be anything up to twice that long
+*/
+struct bignum * bn_sub_mul_wrap(struct bignum *c, struct bignum *a, struct bignum *b, int log)
+{
+	int size = 1 << log;
+	uint32_t *x = calloc(size, sizeof(uint32_t));
+	uint32_t *w = malloc(size * sizeof(uint32_t));
+	uint32_t carry = 0;
+
+	/* c folds into L limbs, and what carries out goes back in at the bottom */
+	memcpy(x, c->limb, (c->size < size ? c->size : size) * sizeof(uint32_t));
+	if(c->size > size) carry = mag_add_to(x, size, c->limb + size, c->size - size);
+	while(carry != 0) carry = mag_add_to(x, size, &carry, 1);
+
+	int i;
+	if(c->sign < 0) for(i = 0; i<size; i++) x[i] = ~x[i];
+
+	/* minus a*b as plus its complement, B^L - 1 - a*b */
+	mag_ntt_wrap(w, a->limb, a->size, b->limb, b->size, log);
+
+	if(a->sign * b->sign > 0) for(i = 0; i<size; i++) w[i] = ~w[i];
+	carry = mag_add_to(x, size, w, size);
+	while(carry != 0) carry = mag_add_to(x, size, &carry, 1);
+
+	/* the top half of the range is the negative differences, B^L - 1 - x of them */
+	int negative = (x[size-1] & 0x80000000u) != 0;
+	if(negative) for(i = 0; i<size; i++) x[i] = ~x[i];
+
+	/* B^L - 1 is the other way of writing 0 */
+	for(i = 0; i<size && x[i] == 0xFFFFFFFFu; i++);
+	if(i == size) memset(x, 0, size * sizeof(uint32_t));
+
+	struct bignum *temp = bn_from_limbs(x, size);
+	if(negative && temp->size > 0) temp->sign = -1;
+
+	free(x);
+	free(w);
+
+	return temp;
+}
+
+/* c - a*b, known to be no longer than size limbs: wrapped when the transform would be used anyway */
+struct bignum * bn_sub_mul(struct bignum *c, struct bignum *a, struct bignum *b, int size)
+{
+	int log = 0;
+	while((1 << log) < size + 1) log++;
+
+	if((a->size < b->size ? a->size : b->size) >= NTT_THRESHOLD && log <= NTT_MAX_LOG && a->size <= 1 << log && b->size <= 1 << log)
+	{
+		return bn_sub_mul_wrap(c, a, b, log);
+	}
+
+	struct bignum *t = bn_mul(a, b);
+	struct bignum *temp = bn_sub(c, t);
+	bn_release(t);
+
+	return temp;
+}
+
+/*
+	B^2m / d rounded down, for d of m limbs: a Newton step from the reciprocal of d's top half,
+	which is within a few of it, then fixed up exactly
+*/
+struct bignum * bn_recip(struct bignum *d)
+{
+	int m = d->size;
+
+	if(m <= DEC_THRESHOLD)
+	{
+		struct bignum *b2m = bn_limb_power(2*m);
+		struct bignum *temp = bn_div(b2m, d);
+		bn_release(b2m);
+
+		return temp;
+	}
+
+	/*
+		the reciprocal y of d's top h limbs, scaled up to x = y*B^(m-h), is off by a part in
+		B^(h-1). x + x*e/B^2m, with e = B^2m - d*x, squares that, and x having only h limbs
+		that aren't zero keeps every product here to about half of d's size on one side
+	*/
+	int h = (m + 1) / 2;
+	struct bignum *top = bn_shift(d, h - m);
+	struct bignum *y = bn_recip(top);
+	bn_release(top);
+
+	/*
+		e is B^(m-h) * (B^(m+h) - d*y), and x being off by a part in B^(h-1) keeps that
+		difference within B^(m+1), so only it is worked out rather than all of d*y
+	*/
+	struct bignum *t = bn_limb_power(m + h);
+	struct bignum *u = bn_sub_mul(t, d, y, m + 2);
+	struct bignum *e = bn_shift(u, m - h);
+	bn_release(t);
+	bn_release(u);
+
+	/* e's bottom m-1 limbs make less than 1 of difference to x*e/B^2m = y*e/B^(m+h) */
+	struct bignum *e_top = bn_shift(e, -(m-1));
+	t = bn_mul(y, e_top);
+	struct bignum *step = bn_shift(t, -(h+1));
+	bn_release(t);
+	bn_release(e_top);
+
+	t = bn_shift(y, m - h);
+	struct bignum *x = bn_add(t, step);
+	bn_release(t);
+	bn_release(y);
+
+	/* B^2m - d*x, which is now a couple of limbs longer than d at most, so dividing it out is cheap */
+	struct bignum *r = bn_sub_mul(e, d, step, m + 3);
+	bn_release(step);
+	bn_release(e);
+
+	struct bignum *adjust = bn_div(r, d);
+
+	t = bn_add(x, adjust);
+	bn_release(x);
+	x = t;
+
+	t = bn_mul(adjust, d);
+	struct bignum *r2 = bn_sub(r, t);
+	bn_release(t);
+	bn_release(r);
+	bn_release(adjust);
+	r = r2;
+
+	struct bignum *one = bn_from_int(1);
+
+	while(r->sign < 0 || bn_cmp(r, d) >= 0)
+	{
+		struct bignum *x2, *r2;
+
+		if(r->sign < 0)
+		{
+			x2 = bn_sub(x, one);
+			r2 = bn_add(r, d);
+		} else
+		{
+			x2 = bn_add(x, one);
+			r2 = bn_sub(r, d);
+		}
+
+		bn_release(x); bn_release(r);
+		x = x2;
+		r = r2;
+	}
+
+	bn_release(r);
+	bn_release(one);
+
+	return x;
+}
+
+/* 10^(9*2^k) */
+struct bignum * ten_power(int k)
+{
+	struct bignum *p = TEN_LOAD(ten_powers[k]);
+	if(p != NULL) return p;
+
+	TEN_LOCK();
+
+	int i;
+	for(i = 0; i<=k; i++)
+	{
+		if(ten_powers[i] == NULL) TEN_STORE(ten_powers[i], i == 0 ? bn_from_int(1000000000) : bn_mul(ten_powers[i-1], ten_powers[i-1]));
+	}
+
+	TEN_UNLOCK();
+
+	return ten_powers[k];
+}
+
+/*
+	the reciprocal of 10^(9*2^k). dec_rec asks for them from the top down, so all but the first
+	come from the one above, which is the reciprocal of this power squared: B^2m / d is
+	d * (B^2M / d^2) / B^(2M-2m), one multiplication where bn_recip would take several. only the
+	top m+2 limbs of the one above go into it, which keeps the product to 2m limbs and costs
+	less than 1 more of shortfall; with the rounding down that makes this one at most 2 short
+	whatever the one above was, which ten_divmod's correction takes care of
+*/
+struct bignum * ten_recip(int k)
+{
+	struct bignum *p = TEN_LOAD(ten_recips[k]);
+	if(p != NULL) return p;
+
+	struct bignum *power = ten_power(k);
+
+	TEN_LOCK();
+
+	if(ten_recips[k] == NULL)
+	{
+		struct bignum *above = k+1 < TEN_POWERS ? ten_recips[k+1] : NULL;
+
+		if(above != NULL)
+		{
+			int drop = above->size - (power->size + 2);
+			if(drop < 0) drop = 0;
+
+			struct bignum *top = bn_shift(above, -drop);
+			struct bignum *t = bn_mul(power, top);
+			TEN_STORE(ten_recips[k], bn_shift(t, drop - 2 * (ten_powers[k+1]->size - power->size)));
+			bn_release(t);
+			bn_release(top);
+		} else
+		{
+			TEN_STORE(ten_recips[k], bn_recip(power));
+		}
+	}
+
+	TEN_UNLOCK();
+
+	return ten_recips[k];
+}
+
+/*
+	q = n / 10^(9*2^k) and r = n % 10^(9*2^k) for 0 <= n < 10^(9*2^(k+1)) by Barrett's method:
+	the quotient from n's top limbs times the reciprocal is short by at most 2, or 4 with a
+	reciprocal that is 2 short
+*/
+void ten_divmod(struct bignum *n, int k, struct bignum **q, struct bignum **r)
+{
+	struct bignum *d = ten_power(k);
+	int m = d->size;
+
+	struct bignum *top = bn_shift(n, -(m-1));
+	struct bignum *t = bn_mul(top, ten_recip(k));
+	*q = bn_shift(t, -(m+1));
+	bn_release(top);
+	bn_release(t);
+
+	/* n - q*d is below 5d < B^(m+1), so only that much of q*d is worked out */
+	*r = bn_sub_mul(n, *q, d, m + 1);
+
+	struct bignum *one = bn_from_int(1);
+
+	while(bn_cmp(*r, d) >= 0)
+	{
+		struct bignum *q2 = bn_add(*q, one);
+		struct bignum *r2 = bn_sub(*r, d);
+
+		bn_release(*q); bn_release(*r);
+		*q = q2;
+		*r = r2;
+	}
+
+	bn_release(one);
+}
+
+/* decimal digits to a number, 9 digits at a time */
+struct bignum * bn_from_str_basecase(const char *str, int len)
+{
+	struct bignum *temp = bn_new(len / 9 + 1);
+	temp->size = 0;
+
+	int i = 0;
+	while(i < len)
+	{
+		int chunk = (len - i) % 9 == 0 ? 9 : (len - i) % 9;
+		uint32_t mul = 1, add = 0;
+
+		for(; chunk>0; chunk--, i++)
+		{
+			mul *= 10;
+			add = add * 10 + (str[i] - '0');
+		}
+
+		uint64_t carry = add;
+
+		int j;
+		for(j = 0; j<temp->size; j++)
+		{
+			carry += (uint64_t)temp->limb[j] * mul;
+			temp->limb[j] = (uint32_t)carry;
+			carry >>= 32;
+		}
+
+		if(carry != 0)
+		{
+			temp->limb[temp->size] = (uint32_t)carry;
+			temp->size++;
+		}
+	}
+
+	return bn_norm(temp);
+}
+
+/* decimal digits to a number: the top digits times 10^(9*2^k) plus the bottom 9*2^k */
+struct bignum * bn_from_str(const char *str, int len)
+{
+	if(len <= DEC_THRESHOLD * 9) return bn_from_str_basecase(str, len);
+
+	int k = 0;
+	while((9 << (k+1)) < len) k++;
+
+	int low = 9 << k;
+
+	struct bignum *hi = bn_from_str(str, len - low);
+	struct bignum *lo = bn_from_str(str + len - low, low);
+	struct bignum *t = bn_mul(hi, ten_power(k));
+	struct bignum *temp = bn_add(t, lo);
+
+	bn_release(hi);
+	bn_release(lo);
+	bn_release(t);
+
+	return temp;
+}
+
+/* where digits go: straight into a file, or into a string big enough for them */
+struct dec_out
+{
+	FILE *out;
+	char *str;
+};
+
+void dec_write(struct dec_out *w, const char *s, int len)
+{
+	if(w->out != NULL)
+	{
+		fwrite(s, 1, len, w->out);
+	} else
+	{
+		memcpy(w->str, s, len);
+		w->str += len;
+	}
+}
+
+void dec_zeros(struct dec_out *w, long count)
+{
+	static const char zeros[64] = "0000000000000000000000000000000000000000000000000000000000000000";
+
+	for(; count>0; count -= 64) dec_write(w, zeros, count < 64 ? (int)count : 64);
+}
+
+/* a small non-negative n, peeling off 9 digits at a time from the bottom, at least width of them */
+void dec_basecase(struct dec_out *w, struct bignum *n, long width)
+{
+	char buf[DEC_THRESHOLD * 10 + 10];
+	char *end = buf + sizeof(buf);
+	char *p = end;
+
+	uint32_t mag[DEC_THRESHOLD + 1];
+	memcpy(mag, n->limb, n->size * sizeof(uint32_t));
+	int size = n->size;
+
+	do
+	{
+		uint64_t r = 0;
+
+		int i;
+		for(i = size-1; i>=0; i--)
+		{
+			r = r << 32 | mag[i];
+			mag[i] = (uint32_t)(r / 1000000000u);
+			r %= 1000000000u;
+		}
+
+		while(size > 0 && mag[size-1] == 0) size--;
+
+		/* all 9 digits of the chunk unless it is the top one */
+		int digits;
+		for(digits = 0; digits<9 && (size > 0 || r != 0 || digits == 0); digits++)
+		{
+			p--;
+			*p = '0' + r % 10;
+			r /= 10;
+		}
+	} while(size > 0);
+
+	/* a zero padded out to width is all padding */
+	if(n->size == 0 && width > 0) p++;
+
+	dec_zeros(w, width - (end - p));
+	dec_write(w, p, end - p);
+}
+
+/* non-negative n < 10^(9*2^(k+1)), at least width digits of it, most significant first */
+void dec_rec(struct dec_out *w, struct bignum *n, int k, long width)
+{
+	if(n->size <= DEC_THRESHOLD || k < 0)
+	{
+		dec_basecase(w, n, width);
+		return;
+	}
+
+	long low = 9L << k;
+
+	/* n has no more than low digits, so the top half would be all padding */
+	if(bn_cmp(n, ten_power(k)) < 0)
+	{
+		if(width > low)
+		{
+			dec_zeros(w, width - low);
+			width = low;
+		}
+
+		dec_rec(w, n, k-1, width);
+		return;
+	}
+
+	struct bignum *q, *r;
+	ten_divmod(n, k, &q, &r);
+
+	dec_rec(w, q, k-1, width > low ? width - low : 0);
+	dec_rec(w, r, k-1, low);
+
+	bn_release(q);
+	bn_release(r);
+}
+
+/* n in decimal, zero padded to at least width digits, streamed to w */
+void dec_print(struct dec_out *w, struct bignum *n, long width)
+{
+	if(n->sign < 0) dec_write(w, "-", 1);
+
+	struct bignum *mag = bn_from_limbs(n->limb, n->size);
+
+	/* squaring 10^(9*2^k) gives at least 2*size-1 limbs, so mag is below 10^(9*2^(k+1)) */
+	int k = 0;
+	if(mag->size > DEC_THRESHOLD) while(2 * ten_power(k)->size - 1 <= mag->size) k++;
+
+	dec_rec(w, mag, k, width);
+
+	bn_release(mag);
+}
+
+/* the number in decimal, malloced */
+char * bn_to_str(struct bignum *n)
+{
+	char *str = malloc(n->size * 10 + 3);
+
+	struct dec_out w = {NULL, str};
+	dec_print(&w, n, 0);
+	*w.str = '\0';
+
+	return str;
+}
+
+/* n in decimal with at least digits digits, zero padded like printf's precision */
+void bn_print(FILE *out, struct bignum *n, int digits)
+{
+	struct dec_out w = {out, NULL};
+	dec_print(&w, n, digits);
+}
+
+/*
+	values. everything the vm holds is a struct bignum *, but one with its low bit set is not a
+	pointer: it is a small integer shifted left by one (malloc never hands out odd addresses).
+	small values need no allocation or reference counting, and arithmetic on two of them is a
+	machine add/sub/mul checked for overflow. a result that leaves the small range is promoted
+	to a heap bignum, and a bignum result that fits is demoted again, so a value has exactly
+	one representation and nothing is ever truncated.
+*/
+#define SMALL_MAX (INTPTR_MAX >> 1)
+#define SMALL_MIN (-SMALL_MAX - 1)
+
+#define IS_SMALL(n) (((uintptr_t)(n) & 1) != 0)
+#define SMALL(i) ((struct bignum *)(((uintptr_t)(intptr_t)(i) << 1) | 1))
+#define SMALL_OF(n) ((intptr_t)(n) >> 1) /* arithmetic shift on every compiler this builds with */
+
+struct bignum * val_retain(struct bignum *n)
+{
+	if(!IS_SMALL(n)) n->refs++;
+
+	return n;
+}
+
+void val_release(struct bignum *n)
+{
+	if(!IS_SMALL(n)) bn_release(n);
+}
+
+/* takes a bignum and hands it back small if it fits */
+struct bignum * val_norm(struct bignum *n)
+{
+	if(n->size > 2) return n;
+
+	uint64_t mag = n->size == 0 ? 0 : n->limb[0];
+	if(n->size == 2) mag |= (uint64_t)n->limb[1] << 32;
+
+	intptr_t small;
+	if(mag <= (uint64_t)SMALL_MAX)
+	{
+		small = n->sign < 0 ? -(intptr_t)mag : (intptr_t)mag;
+	} else if(n->sign < 0 && mag == (uint64_t)SMALL_MAX + 1)
+	{
+		small = SMALL_MIN;
+	} else
+	{
+		return n;
+	}
+
+	bn_release(n);
+	return SMALL(small);
+}
+
+/* an integer as a value, boxed only if it does not fit */
+struct bignum * val_from_int(int64_t n)
+{
+	if(n >= SMALL_MIN && n <= SMALL_MAX) return SMALL(n);
+
+	return bn_from_int(n);
+}
+
+/* a new reference to n as a heap bignum, for the bn_ functions */
+struct bignum * val_box(struct bignum *n)
+{
+	return IS_SMALL(n) ? bn_from_int(SMALL_OF(n)) : bn_retain(n);
+}
+
+int val_is_zero(struct bignum *n)
+{
+	return IS_SMALL(n) ? SMALL_OF(n) == 0 : bn_is_zero(n);
+}
+
+/* applies a bn_ function to two values of which at least one is a bignum */
+struct bignum * val_slow(struct bignum * (*op)(struct bignum *, struct bignum *), struct bignum *a, struct bignum *b)
+{
+	struct bignum *x = val_box(a), *y = val_box(b);
+	struct bignum *result = op(x, y);
+	bn_release(x);
+	bn_release(y);
+
+	return val_norm(result);
+}
+
+int val_cmp(struct bignum *a, struct bignum *b)
+{
+	if(IS_SMALL(a) && IS_SMALL(b)) return (SMALL_OF(a) > SMALL_OF(b)) - (SMALL_OF(a) < SMALL_OF(b));
+
+	struct bignum *x = val_box(a), *y = val_box(b);
+	int cmp = bn_cmp(x, y);
+	bn_release(x);
+	bn_release(y);
+
+	return cmp;
+}
+
+/* the sum and difference of two small values always fit in an intptr_t, only the range is checked */
+struct bignum * val_add(struct bignum *a, struct bignum *b)
+{
+	if(IS_SMALL(a) && IS_SMALL(b)) return val_from_int(SMALL_OF(a) + SMALL_OF(b));
+
+	return val_slow(bn_add, a, b);
+}
+
+struct bignum * val_sub(struct bignum *a, struct bignum *b)
+{
+	if(IS_SMALL(a) && IS_SMALL(b)) return val_from_int(SMALL_OF(a) - SMALL_OF(b));
+
+	return val_slow(bn_sub, a, b);
+}
+
+struct bignum * val_mul(struct bignum *a, struct bignum *b)
+{
+	if(IS_SMALL(a) && IS_SMALL(b))
+	{
+		intptr_t x = SMALL_OF(a), y = SMALL_OF(b);
+#if defined(__GNUC__)
+		intptr_t product;
+		if(!__builtin_mul_overflow(x, y, &product) && product >= SMALL_MIN && product <= SMALL_MAX) return SMALL(product);
+#else
+		uintptr_t mx = x < 0 ? 0 - (uintptr_t)x : (uintptr_t)x;
+		uintptr_t my = y < 0 ? 0 - (uintptr_t)y : (uintptr_t)y;
+		if(mx == 0 || my <= (uintptr_t)SMALL_MAX / mx) return SMALL(x * y);
+#endif
+	}
+
+	return val_slow(bn_mul, a, b);
+}
+
+struct bignum * val_div(struct bignum *a, struct bignum *b)
+{
+	/* before val_slow boxes anything, so a failed instance has nothing extra to release */
+	if(val_is_zero(b))
+	{
+		runtime_error("division by zero!");
+	}
+
+	if(IS_SMALL(a) && IS_SMALL(b))
+	{
+		/* truncates toward zero like bn_div; only SMALL_MIN / -1 leaves the range */
+		return val_from_int(SMALL_OF(a) / SMALL_OF(b));
+	}
+
+	return val_slow(bn_div, a, b);
+}
+
+/* digits past which print's padding is refused, a hundred million zeros being a typo rather than a format */
+#define PRINT_MAX_DIGITS 100000000
+
+/* with at least digits digits, 0 for no padding */
+void val_print(FILE *out, struct bignum *n, int digits)
+{
+	if(IS_SMALL(n))
+	{
+		fprintf(out, "%.*lld", digits > 0 ? digits : 1, (long long)SMALL_OF(n));
+	} else
+	{
+		bn_print(out, n, digits);
+	}
+}
+
+enum inst_type
+{
+    label,
+    enter, /* what a function's label becomes once linked: sets up the frame for a call */
+    decl,
+    push_adr,
+	push_loc,
+    push_val,
+    pop,
+	print, /* digits to pad to, 0 for none */
+    jmpf,
+    jmp,
+	call,
+    param,
+    ret_val,
+    ret_none,
+	set_equal,
+	less_than,
+	more_than,
+	plus,
+	minus,
+	multiply,
+	divide,
+	and,
+	or,
+	
+	/* superinstructions, only made by optimize_code */
+	store,             /* a: pops into local a, for push_adr a ... set_equal */
+	store_val,         /* a, c: local a = constant c */
+	store_loc,         /* a, b: local a = local b */
+	add_loc_val,       /* a, c: local a = local a + constant c */
+	jmpf_less,         /* label: pops two, jumps unless the lower is less than the top */
+	jmpf_more,         /* label: same for more than */
+	jmpf_less_loc_val, /* label, a, c: jumps unless local a < constant c */
+	jmpf_more_loc_val, /* label, a, c: jumps unless local a > constant c */
+	tail_call,         /* label: call then ret_val, the callee takes the place of the caller's frame */
+	
+	/*
+		the register backend, only made by translate_regs. operands are registers of the frame
+		(its locals, then its temporaries) when >= 0, constant -n-1 when < 0
+	*/
+	r_move,       /* d, a: d = a */
+	r_less_than,  /* d, a, b: d = a < b, and the same for the rest of the binary operators */
+	r_more_than,  /* in the same order as the stack ones */
+	r_plus,
+	r_minus,
+	r_multiply,
+	r_divide,
+	r_and,
+	r_or,
+	r_param,      /* a */
+	r_call,       /* label, d: the callee's return value goes to d */
+	r_tail_call,  /* label: the callee returns straight to the caller's caller */
+	r_ret,        /* a */
+	r_ret_none,
+	r_print,      /* a, digits */
+	r_jmp,        /* label */
+	r_jmpf,       /* label, a */
+	r_jmpf_less,  /* label, a, b: jumps unless a < b */
+	r_jmpf_more,  /* label, a, b: jumps unless a > b */
+	
+	halt, /* only in packed bytecode, marks the end of it */
+	num_of_inst_types
+};
+
+/* same order as enum inst_type */
+char *inst_names[] =
+{
+	"label", "enter", "decl", "push_adr", "push_loc", "push_val", "pop", "print",
+	"jmpf", "jmp", "call", "param", "ret_val", "ret_none", "set_equal",
+	"less_than", "more_than", "plus", "minus", "multiply", "divide",
+	"and", "or",
+	"store", "store_val", "store_loc", "add_loc_val", "jmpf_less", "jmpf_more",
+	"jmpf_less_loc_val", "jmpf_more_loc_val", "tail_call",
+	"r_move", "r_less_than", "r_more_than", "r_plus", "r_minus", "r_multiply", "r_divide",
+	"r_and", "r_or", "r_param", "r_call", "r_tail_call", "r_ret", "r_ret_none", "r_print", "r_jmp", "r_jmpf",
+	"r_jmpf_less", "r_jmpf_more",
+	"halt"
+};
+
+/* whether the first operand of an instruction is a label, that link_code and pack_code turn into a position */
+int is_branch(enum inst_type type)
+{
+	return type == jmp || type == jmpf || type == call || (type >= jmpf_less && type <= tail_call) ||
+	       type == r_call || type == r_tail_call || (type >= r_jmp && type <= r_jmpf_more);
+}
+
+/* how many int operands follow an instruction's opcode in packed bytecode */
+int num_of_operands(enum inst_type type)
+{
+	switch(type)
+	{
+		case enter: return 4;
+		
+		case label:
+		case push_adr:
+		case push_loc:
+		case push_val:
+		case print:
+		case jmpf:
+		case jmp:
+		case call:
+		case store:
+		case jmpf_less:
+		case jmpf_more:
+		case tail_call:
+		case r_param:
+		case r_tail_call:
+		case r_ret:
+		case r_jmp: return 1;
+		
+		case store_val:
+		case store_loc:
+		case add_loc_val:
+		case r_move:
+		case r_call:
+		case r_print:
+		case r_jmpf: return 2;
+		
+		case jmpf_less_loc_val:
+		case jmpf_more_loc_val:
+		case r_jmpf_less:
+		case r_jmpf_more: return 3;
+		
+		default:
+			if(type >= r_less_than && type <= r_or) return 3;
+			
+			return 0;
+	}
+}
+
+struct inst
+{
+	enum inst_type type;
+	int *args;
+	int num_of_args;
+};
+
+/*
+	an operand stack entry: a value, or the local slot push_adr pushed for set_equal, which is
+	kept as a small value so that everything on an operand stack can be released the same way
+*/
+union slot
+{
+	struct bignum *num;
+};
+
+/* a callee's locals start where its arguments are on the caller's operand stack, so the two have to line up */
+typedef char slot_is_a_local[sizeof(union slot) == sizeof(struct bignum *) ? 1 : -1];
+
+/* a frame's operand stack, which run_vm keeps in sp while the frame runs */
+struct opstack
+{
+    union slot *stack;
+    int top; /* only kept up to date across a call, and for step_vm */
+    int size; /* capacity, taken from the function's max depth */
+};
+
+struct frame
+{
+    struct bignum **locals;
+    int num_of_locals;
+	struct opstack op; /* right after the locals on the frstack's slots */
+	unsigned char *pc; /* where to carry on from once the frame it called returns */
+	int func; /* index into vm->funcs of what runs in the frame, -1 for the one main returns into */
+};
+
+/*
+	every frame's locals and then its operand stack, one after the other in slots, so a call
+	takes the next num_of_locals + max_depth of them and a return gives them back. both sizes are
+	known from the function's enter, so nothing is allocated per call. when the slots run out they
+	are moved somewhere bigger and the frames pointed at the new place, which run_vm has to allow
+	for by reloading its locals and sp after every push_frame.
+
+	the calling convention: a caller evaluates its arguments onto its own operand stack, and the
+	callee's frame starts at the first of them, so they are its first locals without being copied
+	anywhere. the callee owns them from then on and releases them with its other locals. its
+	return value is left in the slot the first argument was in, on top of the caller's stack
+*/
+struct frstack
+{
+    struct frame *frame;
+    int top;
+    int size; /* frames there is room for */
+	
+	union slot *slots;
+	int used;
+	int slots_size;
+};
+
+#define FRSTACK_FRAMES 256
+#define FRSTACK_SLOTS 16384
+
+/* moves the slots so there is room for at least needed more */
+void grow_slots(struct frstack *stack, int needed)
+{
+	int size = stack->slots_size;
+	while(size - stack->used < needed) size *= 2;
+	
+	union slot *slots = malloc(size * sizeof(union slot));
+	
+	if(slots == NULL)
+	{
+		runtime_error("stack overflow, out of memory for %d slots!", size);
+	}
+	
+	/* all of them, since a tail call's arguments are moved down past the end of the frame below */
+	memcpy(slots, stack->slots, stack->slots_size * sizeof(union slot));
+	
+	int i;
+	for(i = 0; i<=stack->top; i++)
+	{
+		struct frame *frame = &stack->frame[i];
+		
+		frame->locals = (struct bignum **)(slots + ((union slot *)frame->locals - stack->slots));
+		frame->op.stack = slots + (frame->op.stack - stack->slots);
+	}
+	
+	free(stack->slots);
+	stack->slots = slots;
+	stack->slots_size = size;
+}
+
+/*
+	a frame starting at base, which is where the arguments are in the caller's operand stack or
+	NULL to start after the top frame. the locals past the arguments are left for the caller to
+	fill in
+*/
+struct frstack * push_frame(struct frstack *stack, union slot *base, int num_of_locals, int max_depth)
+{
+	if(max_depth < 1) max_depth = 1;
+	
+	if(stack->top+1 == stack->size)
+	{
+		stack->size *= 2;
+		stack->frame = realloc(stack->frame, stack->size * sizeof(struct frame));
+	}
+	
+	/* an index, since growing the slots moves base */
+	int at = base == NULL ? stack->used : base - stack->slots;
+	
+	if(stack->slots_size - at < num_of_locals + max_depth) grow_slots(stack, at + num_of_locals + max_depth - stack->used);
+	
+	stack->top++;
+	
+	struct frame *frame = &stack->frame[stack->top];
+	
+	frame->locals = (struct bignum **)(stack->slots + at);
+	frame->num_of_locals = num_of_locals;
+	frame->op.stack = stack->slots + at + num_of_locals;
+	frame->op.top = -1;
+	frame->op.size = max_depth;
+	frame->pc = NULL;
+	frame->func = -1;
+	
+	stack->used = at + num_of_locals + max_depth;
+    
+    return stack;
+}
+
+struct frstack * pop_frame(struct frstack *stack)
+{
+    if(stack->top == -1)
+    {
+        printf("ERROR: unable to pop, nothing on the stack!\n");
+        exit(-1);
+    }
+	
+	struct frame *frame = &stack->frame[stack->top];
+	
+	int i;
+	for(i = 0; i<frame->num_of_locals; i++) val_release(frame->locals[i]);
+	
+	stack->top--;
+	
+	/* back to the end of the frame below, which this one may have started inside of */
+	stack->used = stack->top == -1 ? 0 : stack->frame[stack->top].op.stack + stack->frame[stack->top].op.size - stack->slots;
+	
+	return stack;
+}
+
+void print_top(FILE *out, struct frstack *stack)
+{
+    fprintf(out, "(");
+	
+	if(stack->frame[stack->top].locals != NULL)
+	{
+		int i;
+		for(i = 0; i<stack->frame[stack->top].num_of_locals; i++)
+		{
+			if(i > 0) fprintf(out, ", ");
+			
+			/* a register the frame hasn't written yet */
+			if(stack->frame[stack->top].locals[i] == NULL)
+			{
+				fprintf(out, "-");
+			} else
+			{
+				val_print(out, stack->frame[stack->top].locals[i], 0);
+			}
+		}
+    }
+	
+    fprintf(out, ")\n");
+    
+    fprintf(out, "%d\n", stack->frame[stack->top].num_of_locals);
+	
+	/* the depth of the operand stack and what is on top of it, push_adr's slot showing as its index */
+	struct opstack *op = &stack->frame[stack->top].op;
+	fprintf(out, "%d\n", op->top + 1);
+	
+	if(op->top == -1)
+	{
+		fprintf(out, "-\n");
+	} else
+	{
+		val_print(out, op->stack[op->top].num, 0);
+		fprintf(out, "\n");
+	}
+}
+
+/* with room for frames frames and slots slots to begin with, both grow as they need to */
+struct frstack * create_frstack(int frames, int slots)
+{
+    struct frstack *temp_st = malloc(sizeof(struct frstack));
+    temp_st->frame = malloc(frames * sizeof(struct frame));
+    temp_st->top = -1;
+    temp_st->size = frames;
+	
+	temp_st->slots = malloc(slots * sizeof(union slot));
+	temp_st->used = 0;
+	temp_st->slots_size = slots;
+    
+    return temp_st;
+}
+
+/*
+	the last TRACE_SIZE instructions run_vm went through, kept when it is run with a trace. each
+	is recorded before it runs, with the depth of the operand stack and what is on top of it: a
+	small value as it is, push_adr's slot showing as its index the way print_top has it, and a
+	bignum by its size alone, since it may have been released by the time the trace is dumped. it
+	is dumped by runtime_error, or while running when the process gets SIGUSR1
+*/
+#ifndef TRACE_SIZE
+#define TRACE_SIZE 4096 /* a power of 2 */
+#endif
+
+struct trace_entry
+{
+	int offset; /* into the bytecode */
+	int depth;
+	int big; /* top is a bignum's limbs, negative for a negative one, rather than a small value */
+	intptr_t top; /* when depth isn't 0 */
+};
+
+struct trace
+{
+	struct trace_entry ring[TRACE_SIZE];
+	long long count; /* instructions recorded, the ring has the last TRACE_SIZE of them */
+};
+
+/*
+	the one run_vm is recording to, the code it is running and where its output goes, for
+	runtime_error, and where run_instance wants it to jump to instead of exiting. each thread
+	running a vm has its own
+*/
+THREAD_LOCAL struct trace *active_trace = NULL;
+THREAD_LOCAL unsigned char *active_code = NULL;
+THREAD_LOCAL FILE *active_out = NULL;
+THREAD_LOCAL jmp_buf *active_exit = NULL;
+
+/*
+	the top of the operand stack while a division runs, the one instruction of either machine
+	that fails on its operands rather than for want of memory, and NULL the rest of the time. the
+	frames below the top one know where theirs ends, at the arguments of the call they made, so
+	this is all run_instance needs to release what was on them when it fails
+*/
+THREAD_LOCAL union slot *active_sp = NULL;
+volatile sig_atomic_t trace_wanted = 0;
+
+#ifdef SIGUSR1
+void request_trace(int sig)
+{
+	trace_wanted = 1;
+	signal(sig, request_trace);
+}
+#endif
+
+struct trace * create_trace(void)
+{
+	struct trace *temp = malloc(sizeof(struct trace));
+	temp->count = 0;
+	
+#ifdef SIGUSR1
+	signal(SIGUSR1, request_trace);
+#endif
+	
+	return temp;
+}
+
+/* sp is only read when depth says there is something there */
+void trace_inst(struct trace *trace, int offset, int depth, union slot *sp)
+{
+	struct trace_entry *entry = &trace->ring[trace->count & (TRACE_SIZE - 1)];
+	
+	entry->offset = offset;
+	entry->depth = depth;
+	
+	if(depth > 0)
+	{
+		struct bignum *n = sp->num;
+		
+		entry->big = !IS_SMALL(n);
+		entry->top = IS_SMALL(n) ? SMALL_OF(n) : n->sign * n->size;
+	}
+	
+	trace->count++;
+}
+
+/* the opcode of each entry is read back out of the bytecode */
+void dump_trace(FILE *out, struct trace *trace, unsigned char *bytecode)
+{
+	long long first = trace->count > TRACE_SIZE ? trace->count - TRACE_SIZE : 0;
+	
+	fprintf(out, "trace: last %lld of %lld instructions, oldest first\n", trace->count - first, trace->count);
+	fprintf(out, "%8s  %-10s %5s  %s\n", "offset", "inst", "depth", "top");
+	
+	long long i;
+	for(i = first; i<trace->count; i++)
+	{
+		struct trace_entry *entry = &trace->ring[i & (TRACE_SIZE - 1)];
+		
+		fprintf(out, "%8d  %-10s %5d  ", entry->offset, inst_names[bytecode[entry->offset]], entry->depth);
+		
+		if(entry->depth == 0) fprintf(out, "-\n");
+		else if(entry->big) fprintf(out, "%sbignum of %lld limbs\n", entry->top < 0 ? "-" : "", (long long)(entry->top < 0 ? -entry->top : entry->top));
+		else fprintf(out, "%lld\n", (long long)entry->top);
+	}
+}
+
+void runtime_error(char *fmt, ...)
+{
+	va_list list;
+	va_start(list, fmt);
+	
+	FILE *out = active_out != NULL ? active_out : stdout;
+	
+	fprintf(out, "RUNTIME ERROR: ");
+	vfprintf(out, fmt, list);
+	fprintf(out, "\n");
+	
+	va_end(list);
+	
+	if(active_trace != NULL) dump_trace(out, active_trace, active_code);
+	
+	if(active_exit != NULL) longjmp(*active_exit, 1);
+	
+	exit(-1);
+}
+
+struct function
+{
+	int label;
+	int num_of_args;
+	int num_of_locals; /* arguments included */
+	int max_depth; /* deepest the operand stack gets inside the function, from parse until pack_code works it out again */
+	int start; /* index of its enter instruction once linked */
+	int offset; /* and where that ends up in the bytecode */
+	int name; /* interned, -1 in a loaded program since the symbols aren't saved */
+};
+
+/* the phases of compile, for the memory they each use */
+enum phase
+{
+	phase_parse, /* lexing happens as the parser pulls tokens */
+	phase_optimize,
+	phase_link,
+	phase_pack,
+	num_of_phases
+};
+
+char *phase_names[] = {"parse", "optimize", "link", "pack"};
+
+struct phase_mem
+{
+	size_t allocated; /* bytes the phase allocated */
+	size_t peak; /* bytes held by the compile when the phase was done, it only grows within a phase */
+};
+
+struct vm
+{
+	struct arena *arena; /* code and its operands, and scratch space for link_code and pack_code */
+	struct inst *code;
+	int num_of_insts;
+	int code_size;
+	int num_of_labels;
+	
+	unsigned char *bytecode; /* packed from code by pack_code, this is what run_vm executes */
+	int bytecode_size;
+	struct source *image; /* the file bytecode points into when load_code made the vm, otherwise NULL */
+	
+	struct bignum **consts; /* the literals, push_val pushes them by index */
+	int num_of_consts;
+	int consts_size;
+	
+	struct function *funcs;
+	int num_of_funcs;
+	int funcs_size;
+	int main; /* index into funcs, -1 if there is no main */
+	int depth; /* operand stack depth at the current point of codegen */
+	int max_depth;
+	
+	struct frstack *stack;
+	struct bignum *zero; /* what locals start out as */
+	
+	int registers; /* the code is for run_regs rather than the stack machine */
+	int jit; /* compile hot functions to machine code, where JIT is defined */
+	struct jit_code **native; /* for each function, NULL until it is compiled */
+	int *hot; /* and how many times it has been entered or looped */
+	unsigned char *leaf; /* and whether it makes no calls, the only ones whose enters are counted */
+	int step; /* print the frame and wait for input before every instruction */
+	struct trace *trace; /* NULL unless run_vm should record what it runs */
+	struct profile *profile; /* NULL unless it should count and time what it runs */
+	FILE *out; /* where print goes, stdout unless it is changed */
+	struct vm *program; /* for an instance, the vm whose code it runs; NULL for one that has its own */
+	
+	struct phase_mem mem[num_of_phases];
+};
+
+/* reads the operand that follows an opcode in the bytecode; memcpy because it isn't aligned */
+int read_int(unsigned char *pc)
+{
+	int n;
+	memcpy(&n, pc, sizeof(int));
+	
+	return n;
+}
+
+int * create_args(struct arena *arena, int num_of_args, ...); /* forward declaration for link_code */
+
+/*
+	resolves labels: every jmp, jmpf and call target becomes the index of the instruction it
+	lands on, a function's label becomes the enter instruction that sets up its frame and the
+	rest of the labels are dropped, so nothing has to be looked up while running
+*/
+struct vm * link_code(struct vm *vm)
+{
+	int *target = arena_alloc(vm->arena, vm->num_of_labels * sizeof(int));
+	int *func_of = arena_alloc(vm->arena, vm->num_of_labels * sizeof(int)); /* index into funcs or -1 */
+	
+	int i, n;
+	for(i = 0; i<vm->num_of_labels; i++) func_of[i] = -1;
+	for(i = 0; i<vm->num_of_funcs; i++) func_of[(int)vm->funcs[i].label] = i;
+	
+	/* where each label ends up once the plain labels are gone */
+	n = 0;
+	for(i = 0; i<vm->num_of_insts; i++)
+	{
+		if(vm->code[i].type == label)
+		{
+			target[vm->code[i].args[0]] = n;
+			if(func_of[vm->code[i].args[0]] != -1) n++;
+		} else
+		{
+			n++;
+		}
+	}
+	
+	n = 0;
+	for(i = 0; i<vm->num_of_insts; i++)
+	{
+		struct inst *inst = &vm->code[i];
+		
+		if(inst->type == label)
+		{
+			int f = func_of[inst->args[0]];
+			
+			if(f == -1) continue;
+			
+			vm->funcs[f].start = n;
+			
+			inst->type = enter;
+			inst->args = create_args(vm->arena, 4, vm->funcs[f].num_of_args, vm->funcs[f].num_of_locals, vm->funcs[f].max_depth, f);
+			inst->num_of_args = 4;
+		} else if(is_branch(inst->type))
+		{
+			inst->args[0] = target[inst->args[0]];
+		}
+		
+		vm->code[n] = *inst;
+		n++;
+	}
+	
+	vm->num_of_insts = n;
+	
+	return vm;
+}
+
+int stack_effect(enum inst_type type); /* forward declaration for frame_depth */
+
+/*
+	how much frame the function whose enter is at code + at needs past its locals, worked out from
+	the code it ended up with; parse's count is from before optimize_code folded constants, which
+	can leave it far deeper than anything that runs. for the stack machine that is the deepest its
+	operand stack gets, for registers the temporaries it uses or the arguments waiting for a call
+	at once, whichever is more. named is set to one past the highest local or register it names.
+	the code has to be whole up to the next enter or the halt, with calls landing on enters; -1 if
+	its operand stack would go below empty
+*/
+int frame_depth(unsigned char *code, int at, int registers, int num_of_locals, int *named)
+{
+	unsigned char *pc = code + at + 1 + 4*sizeof(int);
+	int depth = 0, max = 0, top = 0;
+	
+	*named = 0;
+	
+	for(; *pc != enter && *pc != halt; pc += 1 + num_of_operands(*pc) * sizeof(int))
+	{
+		enum inst_type type = *pc;
+		int n = num_of_operands(type);
+		int arg[4];
+		
+		int i;
+		for(i = 0; i<n; i++) arg[i] = read_int(pc + 1 + i*sizeof(int));
+		
+		/* the callee's enter says how many arguments it takes off the stack */
+		int args = type == call || type == tail_call || type == r_call || type == r_tail_call ? read_int(code + arg[0] + 1) : 0;
+		
+		if(registers)
+		{
+			for(i = is_branch(type) ? 1 : 0; i<(type == r_print ? 1 : n); i++) if(arg[i] >= *named) *named = arg[i] + 1;
+			
+			if(type == r_param) depth++;
+			else depth -= args;
+		} else
+		{
+			switch(type)
+			{
+				case push_adr:
+				case push_loc:
+				case store:
+				case store_val:
+				case add_loc_val: if(arg[0] >= *named) *named = arg[0] + 1; break;
+				case store_loc: if(arg[0] >= *named) *named = arg[0] + 1; if(arg[1] >= *named) *named = arg[1] + 1; break;
+				case jmpf_less_loc_val:
+				case jmpf_more_loc_val: if(arg[1] >= *named) *named = arg[1] + 1; break;
+				default: break;
+			}
+			
+			if(type == call) depth += 1 - args;
+			else if(type == tail_call) depth -= args; /* a call and the ret_val it replaced */
+			else depth += stack_effect(type);
+		}
+		
+		if(depth < 0) return -1;
+		if(depth > max) max = depth;
+	}
+	
+	/* a register past the locals is a temporary */
+	if(registers) top = *named - num_of_locals;
+	
+	return max > top ? max : top;
+}
+
+/* 
+	packs vm->code into vm->bytecode: one opcode byte per instruction followed by its operands
+	inline as 4 byte ints (push_val's is an index into vm->consts, jump and call targets are
+	byte offsets into the bytecode), ended by halt
+*/
+struct vm * pack_code(struct vm *vm)
+{
+	/* byte offset of every instruction, and of the halt after them */
+	int *pos = arena_alloc(vm->arena, (vm->num_of_insts + 1) * sizeof(int));
+	int size = 0;
+	
+	int i, j;
+	for(i = 0; i<vm->num_of_insts; i++)
+	{
+		pos[i] = size;
+		size += 1 + vm->code[i].num_of_args * sizeof(int);
+	}
+	pos[vm->num_of_insts] = size;
+	
+	free(vm->bytecode);
+	vm->bytecode = malloc(size + 1);
+	
+	unsigned char *pc = vm->bytecode;
+	
+	for(i = 0; i<vm->num_of_insts; i++)
+	{
+		enum inst_type type = vm->code[i].type;
+		
+		*pc = type;
+		pc++;
+		
+		for(j = 0; j<vm->code[i].num_of_args; j++)
+		{
+			int n = vm->code[i].args[j];
+			if(j == 0 && is_branch(type)) n = pos[n];
+			
+			memcpy(pc, &n, sizeof(int));
+			pc += sizeof(int);
+		}
+	}
+	
+	*pc = halt;
+	pc++;
+	
+	vm->bytecode_size = pc - vm->bytecode;
+	
+	/* and each frame sized for what is left of its function */
+	for(i = 0; i<vm->num_of_funcs; i++)
+	{
+		struct function *func = &vm->funcs[i];
+		int named;
+		
+		func->offset = pos[func->start];
+		func->max_depth = frame_depth(vm->bytecode, func->offset, vm->registers, func->num_of_locals, &named);
+		memcpy(vm->bytecode + func->offset + 1 + 2*sizeof(int), &func->max_depth, sizeof(int));
+		vm->code[func->start].args[2] = func->max_depth;
+	}
+	
+	return vm;
+}
+
+void step_vm(struct vm *vm, struct frame *frame, union slot *sp)
+{
+	/* top is what a call saved, which the return needs back */
+	int top = frame->op.top;
+	frame->op.top = sp - frame->op.stack;
+	
+	print_top(vm->out, vm->stack);
+	getchar();
+	
+	frame->op.top = top;
+}
+
+/* releases the operands of a binary instruction, whose result was computed from them first */
+struct bignum * binary_result(struct bignum *result, union slot *sp)
+{
+	val_release(sp[-1].num);
+	val_release(sp[0].num);
+	
+	return result;
+}
+
+/* computed goto where the compiler has it, a switch everywhere else */
+#if defined(__GNUC__) && !defined(NO_COMPUTED_GOTO)
+#define THREADED
+#endif
+
+/*
+	profiling, when it is run with -profile. it goes through the same hook as stepping and
+	tracing, so a run without it pays nothing. every instruction is counted and timed by the
+	offset it is at, from one hook to the next, and what the frame stack did in between tells
+	which function is running: a deeper stack is a call, a shallower one a return. an enter
+	belongs to the function it opens, though its frame is only made as it runs. calls are
+	kept as a tree of call paths for the folded stacks; the per opcode and per loop numbers are
+	added up from the per offset ones once it is done
+*/
+#ifndef PROFILE_DEPTH
+#define PROFILE_DEPTH 256 /* call paths deeper than this are folded into the one at this depth */
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PROFILE_UNIT "cycles"
+
+uint64_t profile_clock(void)
+{
+	unsigned int lo, hi;
+	__asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+	
+	return ((uint64_t)hi << 32) | lo;
+}
+#else
+#define PROFILE_UNIT "ns"
+
+uint64_t profile_clock(void)
+{
+#ifndef _WIN32
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+	return (uint64_t)clock() * (1000000000 / CLOCKS_PER_SEC);
+#endif
+}
+#endif
+
+struct profile_func
+{
+	long long calls;
+	uint64_t self; /* time in its own instructions */
+	uint64_t total; /* and in what it called, recursive calls counted once */
+	int active; /* frames of it on the stack */
+};
+
+/* a call path: the function, and the path it was called from */
+struct profile_node
+{
+	int func;
+	int parent, child, sibling; /* -1 for none */
+	uint64_t self;
+};
+
+struct profile_call
+{
+	int func;
+	int node;
+	uint64_t start;
+};
+
+struct profile
+{
+	long long *counts; /* for every bytecode offset, times the instruction there ran */
+	uint64_t *cycles; /* and the time it took */
+	int last; /* offset of the instruction being timed, -1 before the first */
+	uint64_t since; /* when it started */
+	uint64_t elapsed; /* time charged so far, the clock calls start and end by */
+	int base; /* frame stack top when the run started */
+	
+	struct profile_func *funcs;
+	
+	struct profile_call *calls; /* the frames above base */
+	int depth;
+	int calls_size;
+	
+	struct profile_node *nodes; /* 0 is the root, which is outside of main */
+	int num_of_nodes;
+	int nodes_size;
+};
+
+struct profile * create_profile(struct vm *vm)
+{
+	struct profile *temp = malloc(sizeof(struct profile));
+	
+	temp->counts = calloc(vm->bytecode_size, sizeof(long long));
+	temp->cycles = calloc(vm->bytecode_size, sizeof(uint64_t));
+	temp->last = -1;
+	temp->since = 0;
+	temp->elapsed = 0;
+	temp->base = 0;
+	
+	temp->funcs = calloc(vm->num_of_funcs, sizeof(struct profile_func));
+	
+	temp->calls = NULL;
+	temp->depth = 0;
+	temp->calls_size = 0;
+	
+	temp->nodes = malloc(sizeof(struct profile_node));
+	temp->nodes[0].func = -1;
+	temp->nodes[0].parent = temp->nodes[0].child = temp->nodes[0].sibling = -1;
+	temp->nodes[0].self = 0;
+	temp->num_of_nodes = 1;
+	temp->nodes_size = 1;
+	
+	return temp;
+}
+
+void free_profile(struct profile *profile)
+{
+	if(profile == NULL) return;
+	
+	free(profile->counts);
+	free(profile->cycles);
+	free(profile->funcs);
+	free(profile->calls);
+	free(profile->nodes);
+	free(profile);
+}
+
+/* the node for func called from parent, made the first time that path is seen */
+int profile_node(struct profile *profile, int parent, int func)
+{
+	int n;
+	for(n = profile->nodes[parent].child; n != -1; n = profile->nodes[n].sibling)
+	{
+		if(profile->nodes[n].func == func) return n;
+	}
+	
+	if(profile->num_of_nodes == profile->nodes_size)
+	{
+		profile->nodes_size *= 2;
+		profile->nodes = realloc(profile->nodes, profile->nodes_size * sizeof(struct profile_node));
+	}
+	
+	n = profile->num_of_nodes;
+	profile->num_of_nodes++;
+	
+	profile->nodes[n].func = func;
+	profile->nodes[n].parent = parent;
+	profile->nodes[n].child = -1;
+	profile->nodes[n].sibling = profile->nodes[parent].child;
+	profile->nodes[n].self = 0;
+	profile->nodes[parent].child = n;
+	
+	return n;
+}
+
+/* charges the instruction being timed with the time since it started */
+void profile_charge(struct profile *profile, uint64_t now)
+{
+	if(profile->last == -1) return;
+	
+	uint64_t spent = now - profile->since;
+	profile->cycles[profile->last] += spent;
+	profile->elapsed += spent;
+	
+	if(profile->depth > 0)
+	{
+		struct profile_call *call = &profile->calls[profile->depth-1];
+		
+		profile->funcs[call->func].self += spent;
+		profile->nodes[call->node].self += spent;
+	} else
+	{
+		profile->nodes[0].self += spent;
+	}
+}
+
+void profile_return(struct profile *profile)
+{
+	profile->depth--;
+	
+	struct profile_call *call = &profile->calls[profile->depth];
+	struct profile_func *f = &profile->funcs[call->func];
+	
+	f->active--;
+	if(f->active == 0) f->total += profile->elapsed - call->start;
+}
+
+/* called from the hook before every instruction, with the frame stack as it is then */
+void profile_inst(struct profile *profile, unsigned char *code, int offset, int top, int func)
+{
+	uint64_t now = profile_clock();
+	
+	profile_charge(profile, now);
+	
+	int depth = top - profile->base;
+	
+	/* frames that have returned, or gone for a tail call */
+	while(profile->depth > depth) profile_return(profile);
+	
+	/* an enter is the callee's already, not the caller's or, after a tail_call, its caller's */
+	if(code[offset] == enter)
+	{
+		depth++;
+		func = read_int(code + offset + 1 + 3*sizeof(int));
+	}
+	
+	/* a frame enter has just made, or is about to */
+	if(depth > profile->depth && func != -1)
+	{
+		if(profile->depth == profile->calls_size)
+		{
+			profile->calls_size = profile->calls_size * 2 + 64;
+			profile->calls = realloc(profile->calls, profile->calls_size * sizeof(struct profile_call));
+		}
+		
+		int parent = profile->depth > 0 ? profile->calls[profile->depth-1].node : 0;
+		
+		struct profile_call *call = &profile->calls[profile->depth];
+		call->func = func;
+		call->node = profile->depth < PROFILE_DEPTH ? profile_node(profile, parent, func) : parent;
+		call->start = profile->elapsed;
+		profile->depth++;
+		
+		profile->funcs[func].calls++;
+		profile->funcs[func].active++;
+	}
+	
+	profile->counts[offset]++;
+	profile->last = offset;
+	
+	/* what the bookkeeping took isn't charged to anything */
+	profile->since = profile_clock();
+}
+
+/* once main has returned */
+void profile_end(struct profile *profile)
+{
+	profile_charge(profile, profile_clock());
+	profile->last = -1;
+	
+	while(profile->depth > 0) profile_return(profile);
+}
+
+/* where a function name goes, a loaded program only has their indexes */
+void print_func_name(FILE *file, struct vm *vm, int f)
+{
+	if(f == -1)
+	{
+		fprintf(file, "[root]");
+	} else if(vm->funcs[f].name == -1)
+	{
+		fprintf(file, "func%d", f);
+	} else
+	{
+		fprintf(file, "%s", interner.strings[vm->funcs[f].name]);
+	}
+}
+
+/* the function whose code offset is in */
+int func_at(struct vm *vm, int offset)
+{
+	int f = -1, i;
+	for(i = 0; i<vm->num_of_funcs; i++)
+	{
+		if(vm->funcs[i].offset <= offset && (f == -1 || vm->funcs[i].offset > vm->funcs[f].offset)) f = i;
+	}
+	
+	return f;
+}
+
+/* a node's path from main down, ; between the functions as flame graph tools want */
+void print_path(FILE *file, struct vm *vm, struct profile *profile, int n)
+{
+	if(profile->nodes[n].parent > 0)
+	{
+		print_path(file, vm, profile, profile->nodes[n].parent);
+		fprintf(file, ";");
+	}
+	
+	print_func_name(file, vm, profile->nodes[n].func);
+}
+
+/*
+	writes the profile to path as json: per opcode, per function and per loop, where a loop is
+	a jmp back to an earlier offset and its time is that of the instructions between the two,
+	not counting what they call. the call paths go to path.folded, one line per path with the
+	time spent in it
+*/
+int write_profile(struct vm *vm, char *path)
+{
+	struct profile *profile = vm->profile;
+	FILE *file = fopen(path, "w");
+	
+	if(file == NULL)
+	{
+		printf("ERROR! unable to write '%s'!\n", path);
+		return -1;
+	}
+	
+	long long count[num_of_inst_types];
+	uint64_t cycles[num_of_inst_types];
+	long long total_count = 0;
+	uint64_t total_cycles = 0;
+	
+	int i, j;
+	for(i = 0; i<num_of_inst_types; i++)
+	{
+		count[i] = 0;
+		cycles[i] = 0;
+	}
+	
+	for(i = 0; i<vm->bytecode_size; i++)
+	{
+		if(profile->counts[i] == 0) continue;
+		
+		count[vm->bytecode[i]] += profile->counts[i];
+		cycles[vm->bytecode[i]] += profile->cycles[i];
+		total_count += profile->counts[i];
+		total_cycles += profile->cycles[i];
+	}
+	
+	fprintf(file, "{\n");
+	fprintf(file, "  \"unit\": \"%s\",\n", PROFILE_UNIT);
+	fprintf(file, "  \"instructions\": %lld,\n", total_count);
+	fprintf(file, "  \"time\": %llu,\n", (unsigned long long)total_cycles);
+	
+	fprintf(file, "  \"opcodes\": [");
+	for(i = 0, j = 0; i<num_of_inst_types; i++)
+	{
+		if(count[i] == 0) continue;
+		
+		fprintf(file, "%s\n    {\"name\": \"%s\", \"count\": %lld, \"time\": %llu}", j++ ? "," : "", inst_names[i], count[i], (unsigned long long)cycles[i]);
+	}
+	fprintf(file, "\n  ],\n");
+	
+	fprintf(file, "  \"functions\": [");
+	for(i = 0, j = 0; i<vm->num_of_funcs; i++)
+	{
+		struct profile_func *f = &profile->funcs[i];
+		if(f->calls == 0) continue;
+		
+		fprintf(file, "%s\n    {\"name\": \"", j++ ? "," : "");
+		print_func_name(file, vm, i);
+		fprintf(file, "\", \"offset\": %d, \"calls\": %lld, \"self\": %llu, \"total\": %llu}", vm->funcs[i].offset, f->calls, (unsigned long long)f->self, (unsigned long long)f->total);
+	}
+	fprintf(file, "\n  ],\n");
+	
+	fprintf(file, "  \"loops\": [");
+	for(i = 0, j = 0; i<vm->bytecode_size; i++)
+	{
+		if(profile->counts[i] == 0 || (vm->bytecode[i] != jmp && vm->bytecode[i] != r_jmp)) continue;
+		
+		int head = read_int(vm->bytecode + i + 1);
+		if(head >= i) continue;
+		
+		uint64_t time = 0;
+		int k;
+		for(k = head; k<=i; k++) time += profile->cycles[k];
+		
+		fprintf(file, "%s\n    {\"function\": \"", j++ ? "," : "");
+		print_func_name(file, vm, func_at(vm, i));
+		fprintf(file, "\", \"head\": %d, \"back_edge\": %d, \"iterations\": %lld, \"time\": %llu}", head, i, profile->counts[i], (unsigned long long)time);
+	}
+	fprintf(file, "\n  ]\n");
+	fprintf(file, "}\n");
+	
+	if(fclose(file) != 0)
+	{
+		printf("ERROR! unable to write '%s'!\n", path);
+		return -1;
+	}
+	
+	char *folded = malloc(strlen(path) + sizeof(".folded"));
+	sprintf(folded, "%s.folded", path);
+	
+	file = fopen(folded, "w");
+	
+	if(file == NULL)
+	{
+		printf("ERROR! unable to write '%s'!\n", folded);
+		free(folded);
+		return -1;
+	}
+	
+	for(i = 1; i<profile->num_of_nodes; i++)
+	{
+		if(profile->nodes[i].self == 0) continue;
+		
+		print_path(file, vm, profile, i);
+		fprintf(file, " %llu\n", (unsigned long long)profile->nodes[i].self);
+	}
+	
+	int failed = fclose(file) != 0;
+	if(failed) printf("ERROR! unable to write '%s'!\n", folded);
+	
+	free(folded);
+	
+	return failed ? -1 : 0;
+}
+
+#ifdef JIT
+/*
+	baseline JIT for the stack machine on x86-64 linux. once a function has been entered or gone
+	round a loop JIT_THRESHOLD times, entries counting only for functions that make no calls,
+	everything between its enter and the next function is
+	translated once, instruction by instruction, to machine code that does what run_vm's case for
+	it does, with the operand stack and locals left where they are in the frame. the bignum
+	arithmetic stays in C and is called; what goes is the dispatch, the operand decoding and the
+	pc, and jumps inside the function become native jumps.
+
+	call, tail_call, ret_val and ret_none aren't translated: the native code returns the pc of
+	one to run_vm, which runs it and comes back into the native code when the call returns, or
+	at the enter of the callee if that has been compiled too. so the interpreter is always what
+	handles frames, and the machine code only ever runs inside one. going in and out of it costs
+	more than the dispatch it saves in a function that is mostly calls, like a recursive one, so
+	those are only compiled for a loop
+
+	while native code runs
+
+		rbx  locals
+		r12  sp, the top of the operand stack
+		r13  vm->consts
+		r14  the jit_ctx it was started with
+		r15  vm
+*/
+#ifndef JIT_THRESHOLD
+#define JIT_THRESHOLD 1000
+#endif
+
+enum jit_reg
+{
+	RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+	R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+/* how run_vm starts native code, and where that leaves sp */
+struct jit_ctx
+{
+	struct bignum **locals;
+	union slot *sp;
+	struct bignum **consts;
+	struct vm *vm;
+	unsigned char *entry; /* native code to start at */
+};
+
+struct jit_code
+{
+	unsigned char *mem; /* mapped executable */
+	size_t size;
+	int start; /* bytecode offsets of the first instruction after enter, and of the end of the function */
+	int end;
+	unsigned char **entry; /* native address for each bytecode offset in between that starts an instruction */
+};
+
+/* machine code as it is generated, before it is copied somewhere executable */
+struct jit_buf
+{
+	unsigned char *code;
+	int size;
+	int capacity;
+};
+
+void jit_byte(struct jit_buf *b, int n)
+{
+	if(b->size == b->capacity)
+	{
+		b->capacity = b->capacity * 2 + 256;
+		b->code = realloc(b->code, b->capacity);
+	}
+	
+	b->code[b->size++] = n;
+}
+
+void jit_int(struct jit_buf *b, int n)
+{
+	int i;
+	for(i = 0; i<4; i++) jit_byte(b, (unsigned)n >> (8*i) & 0xFF);
+}
+
+void jit_ptr(struct jit_buf *b, void *p)
+{
+	uint64_t n = (uint64_t)(uintptr_t)p;
+	
+	int i;
+	for(i = 0; i<8; i++) jit_byte(b, n >> (8*i) & 0xFF);
+}
+
+/* op reg, [base+disp] for mov (0x8B), mov the other way (0x89) and lea (0x8D), 64 bit */
+void jit_mem(struct jit_buf *b, int op, int reg, int base, int disp)
+{
+	jit_byte(b, 0x48 | (reg >= 8 ? 4 : 0) | (base >= 8 ? 1 : 0));
+	jit_byte(b, op);
+	jit_byte(b, 0x80 | (reg & 7) << 3 | (base & 7));
+	if((base & 7) == RSP) jit_byte(b, 0x24); /* rsp and r12 need a SIB byte */
+	jit_int(b, disp);
+}
+
+/* mov dst, src */
+void jit_mov(struct jit_buf *b, int dst, int src)
+{
+	jit_byte(b, 0x48 | (src >= 8 ? 4 : 0) | (dst >= 8 ? 1 : 0));
+	jit_byte(b, 0x89);
+	jit_byte(b, 0xC0 | (src & 7) << 3 | (dst & 7));
+}
+
+/* add reg, n */
+void jit_add(struct jit_buf *b, int reg, int n)
+{
+	jit_byte(b, 0x48 | (reg >= 8 ? 1 : 0));
+	jit_byte(b, 0x81);
+	jit_byte(b, 0xC0 | (reg & 7));
+	jit_int(b, n);
+}
+
+/* mov reg, p */
+void jit_mov_ptr(struct jit_buf *b, int reg, void *p)
+{
+	jit_byte(b, 0x48 | (reg >= 8 ? 1 : 0));
+	jit_byte(b, 0xB8 + (reg & 7));
+	jit_ptr(b, p);
+}
+
+/* call through rax, which is free at every call site */
+void jit_call(struct jit_buf *b, void *fn)
+{
+	jit_mov_ptr(b, RAX, fn);
+	jit_byte(b, 0xFF);
+	jit_byte(b, 0xD0);
+}
+
+/* test eax, eax */
+void jit_test(struct jit_buf *b)
+{
+	jit_byte(b, 0x85);
+	jit_byte(b, 0xC0);
+}
+
+/* condition codes for jit_jump */
+#define JIT_ALWAYS -1
+#define JIT_NE 0x5
+#define JIT_GE 0xD
+#define JIT_LE 0xE
+
+/* a jump to bytecode offset target, whose rel32 is filled in once every instruction has an address */
+struct jit_fixup
+{
+	int at;
+	int target;
+};
+
+void jit_jump(struct jit_buf *b, int cc, int target, struct jit_fixup *fixups, int *num_of_fixups)
+{
+	if(cc == JIT_ALWAYS)
+	{
+		jit_byte(b, 0xE9);
+	} else
+	{
+		jit_byte(b, 0x0F);
+		jit_byte(b, 0x80 + cc);
+	}
+	
+	fixups[*num_of_fixups].at = b->size;
+	fixups[*num_of_fixups].target = target;
+	(*num_of_fixups)++;
+	
+	jit_int(b, 0);
+}
+
+/* push the value in rax, retained */
+void jit_push_rax(struct jit_buf *b)
+{
+	jit_byte(b, 0xA8); /* test al, 1: small values have no count */
+	jit_byte(b, 0x01);
+	jit_byte(b, 0x75); /* jnz over the inc */
+	jit_byte(b, 0x02);
+	jit_byte(b, 0xFF); /* inc dword [rax], refs is the first field */
+	jit_byte(b, 0x00);
+	jit_add(b, R12, sizeof(union slot));
+	jit_mem(b, 0x89, RAX, R12, 0);
+}
+
+/* what the native code calls, each the same as its case in run_vm */
+void jit_plus(union slot *sp)      { sp[-1].num = binary_result(val_add(sp[-1].num, sp[0].num), sp); }
+void jit_minus(union slot *sp)     { sp[-1].num = binary_result(val_sub(sp[-1].num, sp[0].num), sp); }
+void jit_multiply(union slot *sp)  { sp[-1].num = binary_result(val_mul(sp[-1].num, sp[0].num), sp); }
+void jit_divide(union slot *sp)    { active_sp = sp; sp[-1].num = binary_result(val_div(sp[-1].num, sp[0].num), sp); active_sp = NULL; }
+void jit_less_than(union slot *sp) { sp[-1].num = binary_result(SMALL(val_cmp(sp[-1].num, sp[0].num) < 0), sp); }
+void jit_more_than(union slot *sp) { sp[-1].num = binary_result(SMALL(val_cmp(sp[-1].num, sp[0].num) > 0), sp); }
+void jit_and(union slot *sp) { sp[-1].num = binary_result(SMALL(!val_is_zero(sp[-1].num) && !val_is_zero(sp[0].num)), sp); }
+void jit_or(union slot *sp)  { sp[-1].num = binary_result(SMALL(!val_is_zero(sp[-1].num) || !val_is_zero(sp[0].num)), sp); }
+
+/* in the same order as the operators in enum inst_type */
+void (*jit_binary[])(union slot *) = {jit_less_than, jit_more_than, jit_plus, jit_minus, jit_multiply, jit_divide, jit_and, jit_or};
+
+void jit_print(struct bignum *n, int digits)
+{
+	val_print(active_out, n, digits);
+	fputc('\n', active_out);
+	val_release(n);
+}
+
+/* for jmpf, releases n */
+int jit_is_zero(struct bignum *n)
+{
+	int zero = val_is_zero(n);
+	val_release(n);
+	
+	return zero;
+}
+
+/* for jmpf_less and jmpf_more, releases the two on top */
+int jit_compare(union slot *sp)
+{
+	int cmp = val_cmp(sp[-1].num, sp[0].num);
+	
+	val_release(sp[-1].num);
+	val_release(sp[0].num);
+	
+	return cmp;
+}
+
+void jit_set_equal(struct bignum **locals, union slot *sp)
+{
+	val_release(locals[SMALL_OF(sp[-1].num)]);
+	locals[SMALL_OF(sp[-1].num)] = sp[0].num;
+}
+
+/* takes n */
+void jit_store(struct bignum **local, struct bignum *n)
+{
+	val_release(*local);
+	*local = n;
+}
+
+/* doesn't, retained first in case it is the same local */
+void jit_store_copy(struct bignum **local, struct bignum *n)
+{
+	val_retain(n);
+	val_release(*local);
+	*local = n;
+}
+
+void jit_add_to(struct bignum **local, struct bignum *n)
+{
+	struct bignum *result = val_add(*local, n);
+	val_release(*local);
+	*local = result;
+}
+
+/* translates function f, NULL if it can't be */
+struct jit_code * jit_compile(struct vm *vm, int f)
+{
+	int start = vm->funcs[f].offset + 1 + 4*sizeof(int);
+	int end = vm->bytecode_size - 1; /* the halt */
+	
+	int i;
+	for(i = 0; i<vm->num_of_funcs; i++) if(vm->funcs[i].offset >= start && vm->funcs[i].offset < end) end = vm->funcs[i].offset;
+	
+	struct jit_buf b = {NULL, 0, 0};
+	
+	int *native = malloc((end - start + 1) * sizeof(int)); /* offset into b of each instruction, -1 between them */
+	struct jit_fixup *fixups = malloc((end - start + 1) * sizeof(struct jit_fixup));
+	int num_of_fixups = 0;
+	
+	for(i = 0; i<=end - start; i++) native[i] = -1;
+	
+	/* started by jit_run as a function of the jit_ctx, with rsp 16 byte aligned after the pushes */
+	jit_byte(&b, 0x53);                         /* push rbx */
+	jit_byte(&b, 0x41); jit_byte(&b, 0x54);     /* push r12 */
+	jit_byte(&b, 0x41); jit_byte(&b, 0x55);     /* push r13 */
+	jit_byte(&b, 0x41); jit_byte(&b, 0x56);     /* push r14 */
+	jit_byte(&b, 0x41); jit_byte(&b, 0x57);     /* push r15 */
+	jit_mov(&b, R14, RDI);
+	jit_mem(&b, 0x8B, RBX, R14, offsetof(struct jit_ctx, locals));
+	jit_mem(&b, 0x8B, R12, R14, offsetof(struct jit_ctx, sp));
+	jit_mem(&b, 0x8B, R13, R14, offsetof(struct jit_ctx, consts));
+	jit_mem(&b, 0x8B, R15, R14, offsetof(struct jit_ctx, vm));
+	jit_byte(&b, 0x41); jit_byte(&b, 0xFF); jit_byte(&b, 0xA6); jit_int(&b, offsetof(struct jit_ctx, entry)); /* jmp [r14+entry] */
+	
+	/* every exit comes here with the pc to carry on from in rax */
+	int exit = b.size;
+	jit_mem(&b, 0x89, R12, R14, offsetof(struct jit_ctx, sp));
+	jit_byte(&b, 0x41); jit_byte(&b, 0x5F);     /* pop r15 */
+	jit_byte(&b, 0x41); jit_byte(&b, 0x5E);     /* pop r14 */
+	jit_byte(&b, 0x41); jit_byte(&b, 0x5D);     /* pop r13 */
+	jit_byte(&b, 0x41); jit_byte(&b, 0x5C);     /* pop r12 */
+	jit_byte(&b, 0x5B);                         /* pop rbx */
+	jit_byte(&b, 0xC3);                         /* ret */
+	
+	unsigned char *pc = vm->bytecode + start;
+	
+	while(pc - vm->bytecode < end)
+	{
+		native[pc - vm->bytecode - start] = b.size;
+		
+		/* up to three operands, without reading past the end of the bytecode for those that aren't there */
+		enum inst_type type = *pc;
+		int left = vm->bytecode + vm->bytecode_size - (pc+1);
+		int a = left >= (int)sizeof(int) ? read_int(pc+1) : 0;
+		int c = left >= 2*(int)sizeof(int) ? read_int(pc+1+sizeof(int)) : 0;
+		int d = left >= 3*(int)sizeof(int) ? read_int(pc+1+2*sizeof(int)) : 0;
+		int size = 1;
+		
+		switch(type)
+		{
+			case label: size += sizeof(int); break;
+			case decl: break;
+			
+			case push_adr:
+				jit_add(&b, R12, sizeof(union slot));
+				jit_byte(&b, 0x49); jit_byte(&b, 0xC7); jit_byte(&b, 0x04); jit_byte(&b, 0x24); jit_int(&b, 2*a + 1); /* mov qword [r12], SMALL(a) */
+				size += sizeof(int);
+			break;
+			
+			case push_loc:
+				jit_mem(&b, 0x8B, RAX, RBX, a * sizeof(struct bignum *));
+				jit_push_rax(&b);
+				size += sizeof(int);
+			break;
+			
+			case push_val:
+				jit_mem(&b, 0x8B, RAX, R13, a * sizeof(struct bignum *));
+				jit_push_rax(&b);
+				size += sizeof(int);
+			break;
+			
+			case pop:
+				jit_mem(&b, 0x8B, RDI, R12, 0);
+				jit_call(&b, val_release);
+				jit_add(&b, R12, -(int)sizeof(union slot));
+			break;
+			
+			case print:
+				jit_mem(&b, 0x8B, RDI, R12, 0);
+				jit_mov_ptr(&b, RSI, (void *)(intptr_t)a);
+				jit_call(&b, jit_print);
+				jit_add(&b, R12, -(int)sizeof(union slot));
+				size += sizeof(int);
+			break;
+			
+			case jmpf:
+				jit_mem(&b, 0x8B, RDI, R12, 0);
+				jit_call(&b, jit_is_zero);
+				jit_add(&b, R12, -(int)sizeof(union slot));
+				jit_test(&b);
+				jit_jump(&b, JIT_NE, a, fixups, &num_of_fixups);
+				size += sizeof(int);
+			break;
+			
+			case jmp:
+				jit_jump(&b, JIT_ALWAYS, a, fixups, &num_of_fixups);
+				size += sizeof(int);
+			break;
+			
+			case param: break;
+			
+			case set_equal:
+				jit_mov(&b, RDI, RBX);
+				jit_mov(&b, RSI, R12);
+				jit_call(&b, jit_set_equal);
+				jit_add(&b, R12, -2*(int)sizeof(union slot));
+			break;
+			
+			case less_than:
+			case more_than:
+			case plus:
+			case minus:
+			case multiply:
+			case divide:
+			case and:
+			case or:
+				jit_mov(&b, RDI, R12);
+				jit_call(&b, jit_binary[type - less_than]);
+				jit_add(&b, R12, -(int)sizeof(union slot));
+			break;
+			
+			case store:
+				jit_mem(&b, 0x8D, RDI, RBX, a * sizeof(struct bignum *));
+				jit_mem(&b, 0x8B, RSI, R12, 0);
+				jit_call(&b, jit_store);
+				jit_add(&b, R12, -(int)sizeof(union slot));
+				size += sizeof(int);
+			break;
+			
+			case store_val:
+			case store_loc:
+			case add_loc_val:
+				jit_mem(&b, 0x8D, RDI, RBX, a * sizeof(struct bignum *));
+				jit_mem(&b, 0x8B, RSI, type == store_loc ? RBX : R13, c * sizeof(struct bignum *));
+				jit_call(&b, type == add_loc_val ? (void *)jit_add_to : (void *)jit_store_copy);
+				size += 2*sizeof(int);
+			break;
+			
+			case jmpf_less:
+			case jmpf_more:
+				jit_mov(&b, RDI, R12);
+				jit_call(&b, jit_compare);
+				jit_add(&b, R12, -2*(int)sizeof(union slot));
+				jit_test(&b);
+				jit_jump(&b, type == jmpf_less ? JIT_GE : JIT_LE, a, fixups, &num_of_fixups);
+				size += sizeof(int);
+			break;
+			
+			case jmpf_less_loc_val:
+			case jmpf_more_loc_val:
+				jit_mem(&b, 0x8B, RDI, RBX, c * sizeof(struct bignum *));
+				jit_mem(&b, 0x8B, RSI, R13, d * sizeof(struct bignum *));
+				jit_call(&b, val_cmp);
+				jit_test(&b);
+				jit_jump(&b, type == jmpf_less_loc_val ? JIT_GE : JIT_LE, a, fixups, &num_of_fixups);
+				size += 3*sizeof(int);
+			break;
+			
+			case call:
+			case tail_call:
+			case ret_val:
+			case ret_none:
+				jit_mov_ptr(&b, RAX, pc);
+				jit_byte(&b, 0xE9); jit_int(&b, exit - (b.size + 4));
+				size += type == call || type == tail_call ? sizeof(int) : 0;
+			break;
+			
+			default:
+				/* nothing else is ever inside a function */
+				free(b.code);
+				free(native);
+				free(fixups);
+				
+				return NULL;
+		}
+		
+		pc += size;
+	}
+	
+	/* in case the last instruction falls through */
+	native[end - start] = b.size;
+	jit_mov_ptr(&b, RAX, vm->bytecode + end);
+	jit_byte(&b, 0xE9); jit_int(&b, exit - (b.size + 4));
+	
+	for(i = 0; i<num_of_fixups; i++)
+	{
+		int target = fixups[i].target - start;
+		int rel = native[target] - (fixups[i].at + 4);
+		
+		memcpy(b.code + fixups[i].at, &rel, sizeof(int));
+	}
+	
+	/* /dev/zero rather than MAP_ANONYMOUS, which _POSIX_C_SOURCE hides */
+	struct jit_code *temp = NULL;
+	int fd = open("/dev/zero", O_RDWR);
+	void *mem = fd == -1 ? MAP_FAILED : mmap(NULL, b.size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	
+	if(fd != -1) close(fd);
+	
+	if(mem != MAP_FAILED)
+	{
+		memcpy(mem, b.code, b.size);
+		
+		if(mprotect(mem, b.size, PROT_READ | PROT_EXEC) == 0)
+		{
+			temp = malloc(sizeof(struct jit_code));
+			temp->mem = mem;
+			temp->size = b.size;
+			temp->start = start;
+			temp->end = end;
+			temp->entry = malloc((end - start + 1) * sizeof(unsigned char *));
+			
+			for(i = 0; i<=end - start; i++) temp->entry[i] = native[i] == -1 ? NULL : temp->mem + native[i];
+		} else
+		{
+			munmap(mem, b.size);
+		}
+	}
+	
+	free(b.code);
+	free(native);
+	free(fixups);
+	
+	return temp;
+}
+
+void jit_free(struct jit_code *code)
+{
+	munmap(code->mem, code->size);
+	free(code->entry);
+	free(code);
+}
+
+/* runs code from pc until something it doesn't handle, whose pc it returns */
+unsigned char * jit_run(struct jit_code *code, struct vm *vm, struct bignum **locals, union slot **sp, unsigned char *pc)
+{
+	struct jit_ctx ctx;
+	ctx.locals = locals;
+	ctx.sp = *sp;
+	ctx.consts = vm->consts;
+	ctx.vm = vm;
+	ctx.entry = code->entry[pc - vm->bytecode - code->start];
+	
+	unsigned char *(*fn)(struct jit_ctx *);
+	void *mem = code->mem;
+	memcpy(&fn, &mem, sizeof(fn));
+	
+	pc = fn(&ctx);
+	*sp = ctx.sp;
+	
+	return pc;
+}
+
+/* a function's code, which another instance's thread may publish at any time, see jit_hot */
+#ifdef THREADS
+#define NATIVE_LOAD(p) __atomic_load_n(&(p), __ATOMIC_ACQUIRE)
+#else
+#define NATIVE_LOAD(p) (p)
+#endif
+
+/* for each function, whether it has no call or tail_call, walking the code the way check_code does */
+unsigned char * jit_leaves(struct vm *vm)
+{
+	unsigned char *leaf = malloc(vm->num_of_funcs);
+	memset(leaf, 1, vm->num_of_funcs);
+	
+	int f = -1;
+	int pc;
+	for(pc = 0; pc<vm->bytecode_size; pc += 1 + num_of_operands(vm->bytecode[pc]) * sizeof(int))
+	{
+		enum inst_type type = vm->bytecode[pc];
+		
+		if(type == enter) f = read_int(vm->bytecode + pc + 1 + 3*sizeof(int));
+		else if((type == call || type == tail_call) && f != -1) leaf[f] = 0;
+	}
+	
+	return leaf;
+}
+
+/*
+	counts an enter or a backward jump in function f, compiling it when that reaches
+	JIT_THRESHOLD. runs it from pc if it is compiled, returning where run_vm carries on from;
+	NULL otherwise
+*/
+unsigned char * jit_hot(struct vm *vm, int f, struct bignum **locals, union slot **sp, unsigned char *pc)
+{
+	struct jit_code *code = NATIVE_LOAD(vm->native[f]);
+	
+	if(code == NULL)
+	{
+		/* past the threshold without code means it couldn't be compiled */
+		if(vm->hot[f] >= JIT_THRESHOLD || ++vm->hot[f] < JIT_THRESHOLD) return NULL;
+		
+		code = jit_compile(vm, f);
+		
+		if(code == NULL) return NULL;
+		
+#ifdef THREADS
+		/* instances share their program's code; another one may have got there first */
+		struct jit_code *none = NULL;
+		
+		if(!__atomic_compare_exchange_n(&vm->native[f], &none, code, 0, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE))
+		{
+			jit_free(code);
+			code = none;
+		}
+#else
+		vm->native[f] = code;
+#endif
+	}
+	
+	return jit_run(code, vm, locals, sp, pc);
+}
+#endif
+
+void run_regs(struct vm *vm); /* forward declaration for run_vm */
+
+void run_vm(struct vm *vm)
+{
+	if(vm->registers)
+	{
+		run_regs(vm);
+		return;
+	}
+	
+	active_out = vm->out;
+	
+	if(vm->main == -1)
+	{
+		runtime_error("no main function!");
+	}
+	
+	if(vm->funcs[vm->main].num_of_args != 0)
+	{
+		runtime_error("main can't take arguments!");
+	}
+	
+	/* a frame for main to return into, which carries on at the halt after the code */
+	vm->stack = push_frame(vm->stack, NULL, 0, 1);
+	
+	struct frame *current_frame = &vm->stack->frame[vm->stack->top];
+	current_frame->pc = vm->bytecode + vm->bytecode_size - 1;
+	
+	struct bignum **locals = current_frame->locals;
+	struct bignum *result;
+	unsigned char *pc = vm->bytecode + vm->funcs[vm->main].offset;
+	
+	/* points at the top of the operand stack; emit_code sized it, so there are no bounds checks */
+	union slot *sp = current_frame->op.stack - 1;
+	
+	/* stepping, tracing and profiling go through HOOK before every instruction, a plain run never looks at them */
+	int hooked = vm->step || vm->trace != NULL || vm->profile != NULL;
+	struct trace *trace = vm->trace;
+	struct profile *profile = vm->profile;
+	
+	if(profile != NULL) profile->base = vm->stack->top;
+	
+	active_trace = vm->trace;
+	active_code = vm->bytecode;
+	
+#ifdef JIT
+	/* NULL when nothing is to be compiled; the hooks have to see every instruction */
+	struct jit_code **native = NULL;
+	
+	if(vm->jit && !hooked)
+	{
+		if(vm->native == NULL) vm->native = calloc(vm->num_of_funcs, sizeof(struct jit_code *));
+		if(vm->hot == NULL) vm->hot = calloc(vm->num_of_funcs, sizeof(int));
+		if(vm->leaf == NULL) vm->leaf = jit_leaves(vm);
+		
+		native = vm->native;
+	}
+#endif
+	
+	#define HOOK \
+		if(trace != NULL) \
+		{ \
+			trace_inst(trace, pc - vm->bytecode, sp - current_frame->op.stack + 1, sp); \
+			\
+			if(trace_wanted) \
+			{ \
+				trace_wanted = 0; \
+				dump_trace(vm->out, trace, vm->bytecode); \
+			} \
+		} \
+		if(profile != NULL) profile_inst(profile, vm->bytecode, pc - vm->bytecode, vm->stack->top, current_frame->func); \
+		if(vm->step) step_vm(vm, current_frame, sp)
+	
+#ifdef THREADED
+	/* same order as enum inst_type */
+	static void *dispatch[] =
+	{
+		&&op_label, &&op_enter, &&op_decl, &&op_push_adr, &&op_push_loc, &&op_push_val, &&op_pop, &&op_print,
+		&&op_jmpf, &&op_jmp, &&op_call, &&op_param, &&op_ret_val, &&op_ret_none, &&op_set_equal,
+		&&op_less_than, &&op_more_than, &&op_plus, &&op_minus, &&op_multiply, &&op_divide,
+		&&op_and, &&op_or,
+		&&op_store, &&op_store_val, &&op_store_loc, &&op_add_loc_val, &&op_jmpf_less, &&op_jmpf_more,
+		&&op_jmpf_less_loc_val, &&op_jmpf_more_loc_val, &&op_tail_call,
+		[halt] = &&op_halt /* the register instructions are never run here */
+	};
+	
+	/* every opcode goes to the hook first, which then goes on through dispatch */
+	void *hook[num_of_inst_types];
+	
+	int i;
+	for(i = 0; i<num_of_inst_types; i++) hook[i] = &&op_hook;
+	
+	void **table = hooked ? hook : dispatch;
+	
+	#define CASE(inst) op_##inst
+	#define NEXT goto *table[*pc]
+	
+	NEXT;
+	
+	op_hook:
+		HOOK;
+	goto *dispatch[*pc];
+#else
+	#define CASE(inst) case inst
+	#define NEXT continue
+	
+	for(;;)
+	{
+	if(hooked)
+	{
+		HOOK;
+	}
+	
+	switch(*pc)
+	{
+#endif
+		CASE(label): pc += 1 + sizeof(int); NEXT;
+		
+		CASE(enter):
+		{
+			int num_of_args = read_int(pc+1);
+			int num_of_locals = read_int(pc+1+sizeof(int));
+			
+			/* sp is still the caller's, with the arguments on top */
+			vm->stack = push_frame(vm->stack, sp - num_of_args + 1, num_of_locals, read_int(pc+1+2*sizeof(int)));
+			
+			current_frame = &vm->stack->frame[vm->stack->top];
+			locals = current_frame->locals;
+			sp = current_frame->op.stack - 1;
+			
+			/* the arguments are the first locals already, everything else starts out as zero */
+			int i;
+			for(i = num_of_args; i<num_of_locals; i++) locals[i] = val_retain(vm->zero);
+			
+			current_frame->func = read_int(pc+1+3*sizeof(int));
+			pc += 1 + 4*sizeof(int);
+			
+#ifdef JIT
+			if(native != NULL && vm->leaf[current_frame->func])
+			{
+				unsigned char *next = jit_hot(vm, current_frame->func, locals, &sp, pc);
+				if(next != NULL) pc = next;
+			}
+#endif
+		}
+		NEXT;
+		
+		/* enter already made room for every local */
+		CASE(decl): pc++; NEXT;
+		
+		CASE(push_adr): sp++; sp->num = SMALL(read_int(pc+1));                   pc += 1 + sizeof(int); NEXT;
+		CASE(push_loc): sp++; sp->num = val_retain(locals[read_int(pc+1)]);       pc += 1 + sizeof(int); NEXT;
+		CASE(push_val): sp++; sp->num = val_retain(vm->consts[read_int(pc+1)]);   pc += 1 + sizeof(int); NEXT;
+		
+		CASE(pop): val_release(sp->num); sp--; pc++; NEXT;
+		
+		CASE(print):
+			val_print(vm->out, sp->num, read_int(pc+1));
+			fputc('\n', vm->out);
+			val_release(sp->num);
+			sp--;
+			pc += 1 + sizeof(int);
+		NEXT;
+		
+		CASE(jmpf):
+			if(val_is_zero(sp->num))
+			{
+				pc = vm->bytecode + read_int(pc+1);
+			} else
+			{
+				pc += 1 + sizeof(int);
+			}
+			
+			val_release(sp->num);
+			sp--;
+		NEXT;
+		
+		CASE(jmp):
+		{
+			unsigned char *target = vm->bytecode + read_int(pc+1);
+			
+#ifdef JIT
+			/* a loop going round again */
+			if(native != NULL && target < pc)
+			{
+				unsigned char *next = jit_hot(vm, current_frame->func, locals, &sp, target);
+				
+				if(next != NULL)
+				{
+					pc = next;
+					NEXT;
+				}
+			}
+#endif
+			
+			pc = target;
+		}
+		NEXT;
+		
+		CASE(call):
+		{
+			unsigned char *target = vm->bytecode + read_int(pc+1);
+			
+			/* the arguments go with the callee, the return value goes where the first one was */
+			current_frame->op.top = sp - read_int(target+1) - current_frame->op.stack;
+			current_frame->pc = pc + 1 + sizeof(int);
+			pc = target;
+		}
+		NEXT;
+		
+		/* the argument is where the callee wants it already */
+		CASE(param): pc++; NEXT;
+		
+		CASE(ret_none):
+			result = val_retain(vm->zero);
+		goto function_return;
+		
+		CASE(ret_val):
+			result = sp->num;
+			sp--;
+			
+		function_return:
+			vm->stack = pop_frame(vm->stack);
+			
+			current_frame = &vm->stack->frame[vm->stack->top];
+			locals = current_frame->locals;
+			sp = current_frame->op.stack + current_frame->op.top;
+			
+			sp++;
+			sp->num = result;
+			pc = current_frame->pc;
+			
+#ifdef JIT
+			/* back into the caller's machine code, if it was running it */
+			if(native != NULL && current_frame->func != -1)
+			{
+				struct jit_code *code = NATIVE_LOAD(native[current_frame->func]);
+				if(code != NULL) pc = jit_run(code, vm, locals, &sp, pc);
+			}
+#endif
+		NEXT;
+		
+		CASE(set_equal):
+			val_release(locals[SMALL_OF(sp[-1].num)]);
+			locals[SMALL_OF(sp[-1].num)] = sp[0].num;
+			sp -= 2;
+			pc++;
+		NEXT;
+		
+		CASE(less_than): sp[-1].num = binary_result(SMALL(val_cmp(sp[-1].num, sp[0].num) < 0), sp); sp--; pc++; NEXT;
+		CASE(more_than): sp[-1].num = binary_result(SMALL(val_cmp(sp[-1].num, sp[0].num) > 0), sp); sp--; pc++; NEXT;
+		CASE(plus):      sp[-1].num = binary_result(val_add(sp[-1].num, sp[0].num), sp);                 sp--; pc++; NEXT;
+		CASE(minus):     sp[-1].num = binary_result(val_sub(sp[-1].num, sp[0].num), sp);                 sp--; pc++; NEXT;
+		CASE(multiply):  sp[-1].num = binary_result(val_mul(sp[-1].num, sp[0].num), sp);                 sp--; pc++; NEXT;
+		CASE(divide):    active_sp = sp; sp[-1].num = binary_result(val_div(sp[-1].num, sp[0].num), sp); active_sp = NULL; sp--; pc++; NEXT;
+		
+		CASE(and): sp[-1].num = binary_result(SMALL(!val_is_zero(sp[-1].num) && !val_is_zero(sp[0].num)), sp); sp--; pc++; NEXT;
+		CASE(or):  sp[-1].num = binary_result(SMALL(!val_is_zero(sp[-1].num) || !val_is_zero(sp[0].num)), sp); sp--; pc++; NEXT;
+		
+		CASE(store):
+			val_release(locals[read_int(pc+1)]);
+			locals[read_int(pc+1)] = sp->num;
+			sp--;
+			pc += 1 + sizeof(int);
+		NEXT;
+		
+		CASE(store_val):
+		{
+			int a = read_int(pc+1);
+			
+			val_release(locals[a]);
+			locals[a] = val_retain(vm->consts[read_int(pc+1+sizeof(int))]);
+			
+			pc += 1 + 2*sizeof(int);
+		}
+		NEXT;
+		
+		CASE(store_loc):
+		{
+			int a = read_int(pc+1);
+			
+			/* retained first in case it is the same local */
+			result = val_retain(locals[read_int(pc+1+sizeof(int))]);
+			val_release(locals[a]);
+			locals[a] = result;
+			
+			pc += 1 + 2*sizeof(int);
+		}
+		NEXT;
+		
+		CASE(add_loc_val):
+		{
+			int a = read_int(pc+1);
+			
+			result = val_add(locals[a], vm->consts[read_int(pc+1+sizeof(int))]);
+			val_release(locals[a]);
+			locals[a] = result;
+			
+			pc += 1 + 2*sizeof(int);
+		}
+		NEXT;
+		
+		CASE(jmpf_less):
+		{
+			int taken = val_cmp(sp[-1].num, sp[0].num) >= 0;
+			
+			val_release(sp[-1].num);
+			val_release(sp[0].num);
+			sp -= 2;
+			
+			pc = taken ? vm->bytecode + read_int(pc+1) : pc + 1 + sizeof(int);
+		}
+		NEXT;
+		
+		CASE(jmpf_more):
+		{
+			int taken = val_cmp(sp[-1].num, sp[0].num) <= 0;
+			
+			val_release(sp[-1].num);
+			val_release(sp[0].num);
+			sp -= 2;
+			
+			pc = taken ? vm->bytecode + read_int(pc+1) : pc + 1 + sizeof(int);
+		}
+		NEXT;
+		
+		CASE(jmpf_less_loc_val):
+			if(val_cmp(locals[read_int(pc+1+sizeof(int))], vm->consts[read_int(pc+1+2*sizeof(int))]) >= 0)
+			{
+				pc = vm->bytecode + read_int(pc+1);
+			} else
+			{
+				pc += 1 + 3*sizeof(int);
+			}
+		NEXT;
+		
+		CASE(jmpf_more_loc_val):
+			if(val_cmp(locals[read_int(pc+1+sizeof(int))], vm->consts[read_int(pc+1+2*sizeof(int))]) <= 0)
+			{
+				pc = vm->bytecode + read_int(pc+1);
+			} else
+			{
+				pc += 1 + 3*sizeof(int);
+			}
+		NEXT;
+		
+		/*
+			the caller's frame goes before the callee's enter makes one in the same slots, so the
+			arguments are moved down to where the caller's started
+		*/
+		CASE(tail_call):
+		{
+			unsigned char *target = vm->bytecode + read_int(pc+1);
+			int num_of_args = read_int(target+1);
+			
+			union slot *args = sp - num_of_args + 1;
+			union slot *base = (union slot *)locals;
+			
+			/* anything under the arguments, though a ret statement leaves nothing */
+			for(sp = args - 1; sp >= current_frame->op.stack; sp--) val_release(sp->num);
+			
+			vm->stack = pop_frame(vm->stack);
+			memmove(base, args, num_of_args * sizeof(union slot));
+			
+			current_frame = &vm->stack->frame[vm->stack->top];
+			locals = current_frame->locals;
+			sp = base + num_of_args - 1;
+			
+			pc = target;
+		}
+		NEXT;
+		
+		CASE(halt):
+			/* main's return value */
+			while(sp >= current_frame->op.stack)
+			{
+				val_release(sp->num);
+				sp--;
+			}
+			
+			current_frame->op.top = -1;
+			vm->stack = pop_frame(vm->stack);
+			
+			if(profile != NULL) profile_end(profile);
+			active_trace = NULL;
+			active_out = NULL;
+		return;
+#ifndef THREADED
+	}
+	}
+#endif
+	
+	#undef CASE
+	#undef NEXT
+	#undef HOOK
+}
+
+/*
+	runs code from translate_regs. a frame's locals are its register file: the function's locals,
+	then a register for every depth its operand stack would have reached. locals start out as
+	zero and the temporaries as NULL, since each is written before it is read. r_param evaluates
+	an argument onto the frame's operand stack, where the callee's registers start, so like on
+	the stack machine the arguments are bound without being copied
+*/
+void run_regs(struct vm *vm)
+{
+	active_out = vm->out;
+	
+	if(vm->main == -1) runtime_error("no main function!");
+	if(vm->funcs[vm->main].num_of_args != 0) runtime_error("main can't take arguments!");
+	
+	/* a frame for main to return into; returning into it ends the run */
+	vm->stack = push_frame(vm->stack, NULL, 0, 1);
+	
+	struct frame *current_frame = &vm->stack->frame[vm->stack->top];
+	current_frame->pc = vm->bytecode + vm->bytecode_size - 1;
+	
+	struct bignum **regs = current_frame->locals;
+	struct bignum *result;
+	unsigned char *pc = vm->bytecode + vm->funcs[vm->main].offset;
+	
+	/* a frame's operand stack only holds the arguments r_param has evaluated for a call */
+	union slot *sp = current_frame->op.stack - 1;
+	
+	int hooked = vm->step || vm->trace != NULL || vm->profile != NULL;
+	struct trace *trace = vm->trace;
+	struct profile *profile = vm->profile;
+	
+	if(profile != NULL) profile->base = vm->stack->top;
+	
+	active_trace = vm->trace;
+	active_code = vm->bytecode;
+	
+	#define OPERAND(n) ((n) >= 0 ? regs[n] : vm->consts[-(n)-1])
+	#define SET(d, value) result = (value); val_release(regs[d]); regs[d] = result
+	
+	#define HOOK \
+		if(trace != NULL) \
+		{ \
+			trace_inst(trace, pc - vm->bytecode, 0, sp); \
+			\
+			if(trace_wanted) \
+			{ \
+				trace_wanted = 0; \
+				dump_trace(vm->out, trace, vm->bytecode); \
+			} \
+		} \
+		if(profile != NULL) profile_inst(profile, vm->bytecode, pc - vm->bytecode, vm->stack->top, current_frame->func); \
+		if(vm->step) step_vm(vm, current_frame, sp)
+	
+	/* d, a, b of a three operand instruction */
+	#define D  read_int(pc+1)
+	#define A  read_int(pc+1+sizeof(int))
+	#define B  read_int(pc+1+2*sizeof(int))
+	
+#ifdef THREADED
+	/* same order as enum inst_type, everything translate_regs doesn't make is an error */
+	static void *dispatch[num_of_inst_types];
+	
+	int i;
+	for(i = 0; i<num_of_inst_types; i++) dispatch[i] = &&op_bad;
+	
+	dispatch[enter] = &&op_enter;
+	dispatch[r_move] = &&op_r_move;
+	dispatch[r_plus] = &&op_r_plus;
+	dispatch[r_minus] = &&op_r_minus;
+	dispatch[r_multiply] = &&op_r_multiply;
+	dispatch[r_divide] = &&op_r_divide;
+	dispatch[r_less_than] = &&op_r_less_than;
+	dispatch[r_more_than] = &&op_r_more_than;
+	dispatch[r_and] = &&op_r_and;
+	dispatch[r_or] = &&op_r_or;
+	dispatch[r_param] = &&op_r_param;
+	dispatch[r_call] = &&op_r_call;
+	dispatch[r_tail_call] = &&op_r_tail_call;
+	dispatch[r_ret] = &&op_r_ret;
+	dispatch[r_ret_none] = &&op_r_ret_none;
+	dispatch[r_print] = &&op_r_print;
+	dispatch[r_jmp] = &&op_r_jmp;
+	dispatch[r_jmpf] = &&op_r_jmpf;
+	dispatch[r_jmpf_less] = &&op_r_jmpf_less;
+	dispatch[r_jmpf_more] = &&op_r_jmpf_more;
+	
+	void *hook[num_of_inst_types];
+	for(i = 0; i<num_of_inst_types; i++) hook[i] = &&op_hook;
+	
+	void **table = hooked ? hook : dispatch;
+	
+	#define CASE(inst) op_##inst
+	#define NEXT goto *table[*pc]
+	
+	NEXT;
+	
+	op_hook:
+		HOOK;
+	goto *dispatch[*pc];
+#else
+	#define CASE(inst) case inst
+	#define NEXT continue
+	
+	for(;;)
+	{
+	if(hooked)
+	{
+		HOOK;
+	}
+	
+	switch(*pc)
+	{
+		default: goto op_bad;
+#endif
+		CASE(enter):
+		{
+			int num_of_args = read_int(pc+1);
+			int num_of_locals = read_int(pc+1+sizeof(int));
+			int max_depth = read_int(pc+1+2*sizeof(int));
+			int num_of_regs = num_of_locals + max_depth;
+			
+			/*
+				sp is still the caller's, with the arguments on top, which become the first
+				registers as they do the first locals on the stack machine. no more of them
+				than its operand stack would have held are ever waiting at once
+			*/
+			vm->stack = push_frame(vm->stack, sp - num_of_args + 1, num_of_regs, max_depth);
+			
+			current_frame = &vm->stack->frame[vm->stack->top];
+			regs = current_frame->locals;
+			sp = current_frame->op.stack - 1;
+			
+			int i;
+			for(i = num_of_args; i<num_of_locals; i++) regs[i] = val_retain(vm->zero);
+			for(i = num_of_locals; i<num_of_regs; i++) regs[i] = NULL;
+			
+			current_frame->func = read_int(pc+1+3*sizeof(int));
+			pc += 1 + 4*sizeof(int);
+		}
+		NEXT;
+		
+		CASE(r_move): { int d = D; SET(d, val_retain(OPERAND(A))); } pc += 1 + 2*sizeof(int); NEXT;
+		
+		CASE(r_plus):      { int d = D; SET(d, val_add(OPERAND(A), OPERAND(B))); }                         pc += 1 + 3*sizeof(int); NEXT;
+		CASE(r_minus):     { int d = D; SET(d, val_sub(OPERAND(A), OPERAND(B))); }                         pc += 1 + 3*sizeof(int); NEXT;
+		CASE(r_multiply):  { int d = D; SET(d, val_mul(OPERAND(A), OPERAND(B))); }                         pc += 1 + 3*sizeof(int); NEXT;
+		CASE(r_divide):    { int d = D; active_sp = sp; SET(d, val_div(OPERAND(A), OPERAND(B))); active_sp = NULL; } pc += 1 + 3*sizeof(int); NEXT;
+		CASE(r_less_than): { int d = D; SET(d, SMALL(val_cmp(OPERAND(A), OPERAND(B)) < 0)); }        pc += 1 + 3*sizeof(int); NEXT;
+		CASE(r_more_than): { int d = D; SET(d, SMALL(val_cmp(OPERAND(A), OPERAND(B)) > 0)); }        pc += 1 + 3*sizeof(int); NEXT;
+		CASE(r_and): { int d = D; SET(d, SMALL(!val_is_zero(OPERAND(A)) && !val_is_zero(OPERAND(B)))); } pc += 1 + 3*sizeof(int); NEXT;
+		CASE(r_or):  { int d = D; SET(d, SMALL(!val_is_zero(OPERAND(A)) || !val_is_zero(OPERAND(B)))); } pc += 1 + 3*sizeof(int); NEXT;
+		
+		CASE(r_param): sp++; sp->num = val_retain(OPERAND(read_int(pc+1))); pc += 1 + sizeof(int); NEXT;
+		
+		CASE(r_call):
+			current_frame->pc = pc + 1 + 2*sizeof(int);
+			pc = vm->bytecode + read_int(pc+1);
+		NEXT;
+		
+		CASE(r_tail_call):
+		{
+			unsigned char *target = vm->bytecode + read_int(pc+1);
+			int num_of_args = read_int(target+1);
+			
+			union slot *args = sp - num_of_args + 1;
+			union slot *base = (union slot *)regs;
+			
+			/* anything under the arguments, though a ret statement leaves nothing */
+			for(sp = args - 1; sp >= current_frame->op.stack; sp--) val_release(sp->num);
+			
+			vm->stack = pop_frame(vm->stack);
+			
+			/* down to where the frame started, args being above base a forward copy is safe */
+			int i;
+			for(i = 0; i<num_of_args; i++) base[i] = args[i];
+			
+			current_frame = &vm->stack->frame[vm->stack->top];
+			regs = current_frame->locals;
+			sp = base + num_of_args - 1;
+			
+			pc = target;
+		}
+		NEXT;
+		
+		CASE(r_ret_none):
+			result = val_retain(vm->zero);
+		goto function_return;
+		
+		CASE(r_ret):
+			result = val_retain(OPERAND(read_int(pc+1)));
+			
+		function_return:
+			/* the arguments were the callee's, what is under them is still waiting for another call */
+			sp = (union slot *)regs - 1;
+			vm->stack = pop_frame(vm->stack);
+			
+			current_frame = &vm->stack->frame[vm->stack->top];
+			regs = current_frame->locals;
+			pc = current_frame->pc;
+			
+			if(vm->stack->top == 0)
+			{
+				/* main returned */
+				val_release(result);
+				vm->stack = pop_frame(vm->stack);
+				
+				if(profile != NULL) profile_end(profile);
+				active_trace = NULL;
+				active_out = NULL;
+				return;
+			}
+			
+			/* the call's destination is its last operand, just before where it returns to */
+			{
+				int d = read_int(pc - sizeof(int));
+				val_release(regs[d]);
+				regs[d] = result;
+			}
+		NEXT;
+		
+		CASE(r_print):
+			val_print(vm->out, OPERAND(read_int(pc+1)), read_int(pc+1+sizeof(int)));
+			fputc('\n', vm->out);
+			pc += 1 + 2*sizeof(int);
+		NEXT;
+		
+		CASE(r_jmp): pc = vm->bytecode + read_int(pc+1); NEXT;
+		
+		CASE(r_jmpf):
+			pc = val_is_zero(OPERAND(A)) ? vm->bytecode + read_int(pc+1) : pc + 1 + 2*sizeof(int);
+		NEXT;
+		
+		CASE(r_jmpf_less):
+			pc = val_cmp(OPERAND(A), OPERAND(B)) >= 0 ? vm->bytecode + read_int(pc+1) : pc + 1 + 3*sizeof(int);
+		NEXT;
+		
+		CASE(r_jmpf_more):
+			pc = val_cmp(OPERAND(A), OPERAND(B)) <= 0 ? vm->bytecode + read_int(pc+1) : pc + 1 + 3*sizeof(int);
+		NEXT;
+		
+		op_bad:
+			runtime_error("%s isn't an instruction of the register backend!", inst_names[*pc]);
+		return;
+#ifndef THREADED
+	}
+	}
+#endif
+	
+	#undef CASE
+	#undef NEXT
+	#undef HOOK
+	#undef OPERAND
+	#undef SET
+	#undef D
+	#undef A
+	#undef B
+}
+
+int * create_args(struct arena *arena, int num_of_args, ...)
+{
+    va_list list;
+    va_start(list, num_of_args);
+    
+    int *temp = arena_alloc(arena, num_of_args * sizeof(int));
+    
+    int i;
+    for(i = 0; i<num_of_args; i++) temp[i] = va_arg(list, int);
+    
+    va_end(list);
+    
+    return temp;
+}
+
+/* how many values an instruction leaves on the operand stack, minus how many it takes off */
+int stack_effect(enum inst_type type)
+{
+	switch(type)
+	{
+		case push_adr:
+		case push_loc:
+		case push_val:
+		case call:      return 1;
+		
+		case set_equal:
+		case jmpf_less:
+		case jmpf_more: return -2;
+		
+		case label:
+		case decl:
+		case param: /* the argument stays where it is until call, see emit_call */
+		case jmp:
+		case ret_none:
+		case store_val:
+		case store_loc:
+		case add_loc_val:
+		case jmpf_less_loc_val:
+		case jmpf_more_loc_val:
+		case tail_call: return 0;
+		
+		default:        return -1; /* pop, print, jmpf, ret_val, store and the binary operators */
+	}
+}
+
+struct vm * emit_code(struct vm *vm, enum inst_type type, int *args, int num_of_args)
+{
+    vm->depth += stack_effect(type);
+    if(vm->depth > vm->max_depth) vm->max_depth = vm->depth;
+    
+    if(vm->num_of_insts == vm->code_size)
+    {
+        int old_size = vm->code_size;
+        
+        vm->code_size = vm->code_size == 0 ? 256 : vm->code_size * 2;
+        vm->code = arena_grow(vm->arena, vm->code, old_size * sizeof(struct inst), vm->code_size * sizeof(struct inst));
+    }
+    
+    vm->num_of_insts++;
+    vm->code[vm->num_of_insts-1].type = type;
+    vm->code[vm->num_of_insts-1].args = args;
+    vm->code[vm->num_of_insts-1].num_of_args = num_of_args;
+    
+    return vm;
+}
+
+/* a call to label whose arguments are on the stack; they become the callee's, and the return value takes their place */
+struct vm * emit_call(struct vm *vm, int label, int num_of_args)
+{
+	vm = emit_code(vm, call, create_args(vm->arena, 1, label), 1);
+	vm->depth -= num_of_args;
+	
+	return vm;
+}
+
+struct vm * create_vm(void)
+{
+    struct vm *temp_vm = malloc(sizeof(struct vm));
+    
+    temp_vm->arena = create_arena();
+    temp_vm->code = NULL;
+    temp_vm->num_of_insts = 0;
+    temp_vm->code_size = 0;
+    temp_vm->num_of_labels = 0;
+    
+    temp_vm->bytecode = NULL;
+    temp_vm->bytecode_size = 0;
+    temp_vm->image = NULL;
+    
+    temp_vm->consts = NULL;
+    temp_vm->num_of_consts = 0;
+    temp_vm->consts_size = 0;
+    
+    temp_vm->funcs = NULL;
+    temp_vm->num_of_funcs = 0;
+    temp_vm->funcs_size = 0;
+    temp_vm->main = -1;
+    temp_vm->depth = 0;
+    temp_vm->max_depth = 0;
+    
+    temp_vm->stack = create_frstack(FRSTACK_FRAMES, FRSTACK_SLOTS);
+    temp_vm->zero = SMALL(0);
+    
+    temp_vm->registers = 0;
+    temp_vm->jit = 1;
+    temp_vm->native = NULL;
+    temp_vm->hot = NULL;
+    temp_vm->leaf = NULL;
+    temp_vm->step = 0;
+    temp_vm->trace = NULL;
+    temp_vm->profile = NULL;
+    temp_vm->out = stdout;
+    temp_vm->program = NULL;
+    
+    memset(temp_vm->mem, 0, sizeof(temp_vm->mem));
+    
+    return temp_vm;
+}
+
+void close_source(struct source *source); /* forward declaration for free_vm */
+
+void free_vm(struct vm *vm)
+{
+	arena_free(vm->arena);
+	
+	int i;
+	if(vm->program != NULL)
+	{
+		/* an instance only owns its constants when it had to copy them */
+		if(vm->consts != vm->program->consts)
+		{
+			for(i = 0; i<vm->num_of_consts; i++) val_release(vm->consts[i]);
+			free(vm->consts);
+		}
+	} else
+	{
+		if(vm->image != NULL)
+		{
+			close_source(vm->image);
+		} else
+		{
+			free(vm->bytecode);
+		}
+		
+		for(i = 0; i<vm->num_of_consts; i++) val_release(vm->consts[i]);
+		free(vm->consts);
+		free(vm->funcs);
+	}
+	
+	while(vm->stack->top != -1) vm->stack = pop_frame(vm->stack);
+	free(vm->stack->frame);
+	free(vm->stack->slots);
+	free(vm->stack);
+	
+	val_release(vm->zero);
+	free(vm->trace);
+	free_profile(vm->profile);
+	
+	/* an instance's compiled code is its program's */
+	if(vm->program == NULL)
+	{
+#ifdef JIT
+		if(vm->native != NULL)
+		{
+			for(i = 0; i<vm->num_of_funcs; i++) if(vm->native[i] != NULL) jit_free(vm->native[i]);
+		}
+#endif
+		free(vm->native);
+	}
+	free(vm->hot);
+	free(vm->leaf);
+	
+	free(vm);
+}
+
+/*
+	many runs of one compiled program at once. the program is any vm that compile, compile_regs or
+	load_code made, and it isn't changed by its instances: each of them has its own stack, output
+	and hot counts, and reads the program's bytecode, functions, constants and compiled code, the
+	last of which any instance can add a function to once it gets hot. big
+	constants are the exception, since pushing one counts a reference to it, so an instance of a
+	program that has any gets copies of its own. the program has to outlive its instances
+*/
+#define INSTANCE_FRAMES 16
+#define INSTANCE_SLOTS 256 /* small, since there are many of them; they grow like any other stack */
+
+struct vm * create_instance(struct vm *program, FILE *out)
+{
+	struct vm *temp = malloc(sizeof(struct vm));
+	
+	/* the code, constants and functions, and how it was compiled */
+	*temp = *program;
+	
+	temp->arena = create_arena();
+	temp->code = NULL;
+	temp->num_of_insts = 0;
+	temp->code_size = 0;
+	temp->image = NULL;
+	temp->consts_size = 0;
+	temp->funcs_size = 0;
+	
+	temp->stack = create_frstack(INSTANCE_FRAMES, INSTANCE_SLOTS);
+	temp->hot = NULL;
+	temp->leaf = NULL;
+	temp->step = 0;
+	temp->trace = NULL;
+	temp->profile = NULL;
+	temp->out = out;
+	temp->program = program;
+	
+	memset(temp->mem, 0, sizeof(temp->mem));
+	
+	/* made here rather than by the first run, which could be on any thread */
+	if(program->jit && program->native == NULL) program->native = calloc(program->num_of_funcs, sizeof(struct jit_code *));
+	temp->native = program->native;
+	
+	int i;
+	for(i = 0; i<program->num_of_consts; i++) if(!IS_SMALL(program->consts[i])) break;
+	
+	if(i < program->num_of_consts)
+	{
+		temp->consts = malloc(program->num_of_consts * sizeof(struct bignum *));
+		
+		for(i = 0; i<program->num_of_consts; i++)
+		{
+			struct bignum *n = program->consts[i];
+			
+			if(!IS_SMALL(n))
+			{
+				n = bn_from_limbs(n->limb, n->size);
+				n->sign = program->consts[i]->sign;
+			}
+			
+			temp->consts[i] = n;
+		}
+	}
+	
+	return temp;
+}
+
+/*
+	runs vm, an instance or not, to the end. a runtime error goes to its out like the rest of its
+	output, and rather than exiting it comes back here with -1, leaving vm as it was before the
+	run, with what was on its frames and operand stacks released
+*/
+int run_instance(struct vm *vm)
+{
+	jmp_buf error;
+	jmp_buf *outer = active_exit;
+	
+	active_exit = &error;
+	
+	if(setjmp(error) != 0)
+	{
+		active_exit = outer;
+		active_trace = NULL;
+		active_out = NULL;
+		
+		/* what is on each frame's operand stack, up to the arguments of the frame above it */
+		union slot *top = active_sp;
+		active_sp = NULL;
+		
+		while(vm->stack->top != -1)
+		{
+			struct frame *frame = &vm->stack->frame[vm->stack->top];
+			
+			if(top != NULL)
+			{
+				union slot *slot;
+				for(slot = frame->op.stack; slot<=top; slot++) val_release(slot->num);
+			}
+			
+			top = (union slot *)frame->locals - 1;
+			vm->stack = pop_frame(vm->stack);
+		}
+		
+		return -1;
+	}
+	
+	run_vm(vm);
+	
+	active_exit = outer;
+	
+	return 0;
+}
+
+#ifdef THREADS
+/*
+	runs instances on a pool of threads. every thread has a deque of its own: instances are handed
+	out to them in turn, a thread takes its next one from the back of its own deque and, once that
+	is empty, steals from the front of the others', so the ones that finish early take work off
+	those that are behind instead of all of them waiting on one queue
+*/
+struct deque
+{
+	struct vm **jobs; /* a ring of size, from head for tail - head */
+	int head, tail;
+	int size;
+	pthread_mutex_t lock;
+};
+
+struct runner
+{
+	pthread_t *threads;
+	struct deque *deques;
+	int num_of_threads;
+	int next; /* the deque the next submitted instance goes to */
+	
+	pthread_mutex_t lock; /* for the rest */
+	pthread_cond_t work;
+	pthread_cond_t idle;
+	int queued; /* submitted and not yet taken */
+	int running; /* submitted and not yet finished */
+	int failed; /* runs that ended on a runtime error */
+	int stop;
+};
+
+struct runner_thread
+{
+	struct runner *runner;
+	int self;
+};
+
+/* from the back of the thread's own deque, or the front of another; NULL if they are all empty */
+struct vm * take_job(struct runner *runner, int self)
+{
+	struct vm *vm = NULL;
+	
+	int i;
+	for(i = 0; i<runner->num_of_threads && vm == NULL; i++)
+	{
+		struct deque *deque = &runner->deques[(self + i) % runner->num_of_threads];
+		
+		pthread_mutex_lock(&deque->lock);
+		
+		if(deque->tail != deque->head)
+		{
+			if(i == 0)
+			{
+				deque->tail--;
+				vm = deque->jobs[deque->tail % deque->size];
+			} else
+			{
+				vm = deque->jobs[deque->head % deque->size];
+				deque->head++;
+			}
+		}
+		
+		pthread_mutex_unlock(&deque->lock);
+	}
+	
+	if(vm != NULL)
+	{
+		pthread_mutex_lock(&runner->lock);
+		runner->queued--;
+		pthread_mutex_unlock(&runner->lock);
+	}
+	
+	return vm;
+}
+
+void * runner_thread(void *arg)
+{
+	struct runner_thread *thread = arg;
+	struct runner *runner = thread->runner;
+	
+	pool_thread = 1;
+	
+	for(;;)
+	{
+		struct vm *vm = take_job(runner, thread->self);
+		
+		if(vm == NULL)
+		{
+			pthread_mutex_lock(&runner->lock);
+			
+			while(runner->queued == 0 && !runner->stop) pthread_cond_wait(&runner->work, &runner->lock);
+			
+			int stop = runner->queued == 0 && runner->stop;
+			pthread_mutex_unlock(&runner->lock);
+			
+			if(stop) break;
+			continue;
+		}
+		
+		int failed = run_instance(vm);
+		fflush(vm->out);
+		
+		pthread_mutex_lock(&runner->lock);
+		
+		if(failed) runner->failed++;
+		runner->running--;
+		if(runner->running == 0) pthread_cond_broadcast(&runner->idle);
+		
+		pthread_mutex_unlock(&runner->lock);
+	}
+	
+	free(thread);
+	
+	return NULL;
+}
+
+/* threads threads, at least one; NULL if they couldn't all be started */
+struct runner * create_runner(int threads)
+{
+	if(threads < 1) threads = 1;
+	
+	struct runner *temp = malloc(sizeof(struct runner));
+	
+	temp->threads = malloc(threads * sizeof(pthread_t));
+	temp->deques = malloc(threads * sizeof(struct deque));
+	temp->num_of_threads = threads; /* take_job reads it unlocked, so it is set before any thread starts */
+	temp->next = 0;
+	temp->queued = 0;
+	temp->running = 0;
+	temp->failed = 0;
+	temp->stop = 0;
+	
+	pthread_mutex_init(&temp->lock, NULL);
+	pthread_cond_init(&temp->work, NULL);
+	pthread_cond_init(&temp->idle, NULL);
+	
+	int i;
+	for(i = 0; i<threads; i++)
+	{
+		struct deque *deque = &temp->deques[i];
+		
+		deque->size = 64;
+		deque->jobs = malloc(deque->size * sizeof(struct vm *));
+		deque->head = 0;
+		deque->tail = 0;
+		pthread_mutex_init(&deque->lock, NULL);
+	}
+	
+	/* the deques are all there before any thread can steal from them */
+	for(i = 0; i<threads; i++)
+	{
+		struct runner_thread *thread = malloc(sizeof(struct runner_thread));
+		thread->runner = temp;
+		thread->self = i;
+		
+		if(pthread_create(&temp->threads[i], NULL, runner_thread, thread) != 0)
+		{
+			free(thread);
+			break;
+		}
+	}
+	
+	if(i < threads)
+	{
+		/* the ones that did start are stopped rather than left with fewer deques than they were told */
+		pthread_mutex_lock(&temp->lock);
+		temp->stop = 1;
+		pthread_cond_broadcast(&temp->work);
+		pthread_mutex_unlock(&temp->lock);
+		
+		int started = i;
+		for(i = 0; i<started; i++) pthread_join(temp->threads[i], NULL);
+		
+		for(i = 0; i<threads; i++)
+		{
+			pthread_mutex_destroy(&temp->deques[i].lock);
+			free(temp->deques[i].jobs);
+		}
+		
+		pthread_mutex_destroy(&temp->lock);
+		pthread_cond_destroy(&temp->work);
+		pthread_cond_destroy(&temp->idle);
+		
+		free(temp->deques);
+		free(temp->threads);
+		free(temp);
+		
+		return NULL;
+	}
+	
+	return temp;
+}
+
+/* queues vm to be run by run_instance on one of the threads; it is the caller's again once runner_wait returns */
+void runner_submit(struct runner *runner, struct vm *vm)
+{
+	struct deque *deque = &runner->deques[runner->next];
+	runner->next = (runner->next + 1) % runner->num_of_threads;
+	
+	pthread_mutex_lock(&deque->lock);
+	
+	if(deque->tail - deque->head == deque->size)
+	{
+		/* unrolled into a ring twice the size */
+		struct vm **jobs = malloc(2 * deque->size * sizeof(struct vm *));
+		
+		int i;
+		for(i = 0; i<deque->size; i++) jobs[i] = deque->jobs[(deque->head + i) % deque->size];
+		
+		free(deque->jobs);
+		deque->jobs = jobs;
+		deque->tail -= deque->head;
+		deque->head = 0;
+		deque->size *= 2;
+	}
+	
+	deque->jobs[deque->tail % deque->size] = vm;
+	deque->tail++;
+	
+	pthread_mutex_unlock(&deque->lock);
+	
+	pthread_mutex_lock(&runner->lock);
+	runner->queued++;
+	runner->running++;
+	pthread_cond_signal(&runner->work);
+	pthread_mutex_unlock(&runner->lock);
+}
+
+/* until everything submitted so far has run, returning how many of those ended on a runtime error */
+int runner_wait(struct runner *runner)
+{
+	pthread_mutex_lock(&runner->lock);
+	
+	while(runner->running > 0) pthread_cond_wait(&runner->idle, &runner->lock);
+	
+	int failed = runner->failed;
+	runner->failed = 0;
+	
+	pthread_mutex_unlock(&runner->lock);
+	
+	return failed;
+}
+
+/* waits for what was submitted to finish, then stops the threads */
+void free_runner(struct runner *runner)
+{
+	pthread_mutex_lock(&runner->lock);
+	runner->stop = 1;
+	pthread_cond_broadcast(&runner->work);
+	pthread_mutex_unlock(&runner->lock);
+	
+	int i;
+	for(i = 0; i<runner->num_of_threads; i++) pthread_join(runner->threads[i], NULL);
+	
+	for(i = 0; i<runner->num_of_threads; i++)
+	{
+		pthread_mutex_destroy(&runner->deques[i].lock);
+		free(runner->deques[i].jobs);
+	}
+	
+	pthread_mutex_destroy(&runner->lock);
+	pthread_cond_destroy(&runner->work);
+	pthread_cond_destroy(&runner->idle);
+	
+	free(runner->deques);
+	free(runner->threads);
+	free(runner);
+}
+#else
+/* without threads, the instances are run one after the other as they are submitted */
+struct runner
+{
+	int failed;
+};
+
+struct runner * create_runner(int threads)
+{
+	struct runner *temp = malloc(sizeof(struct runner));
+	temp->failed = 0;
+	
+	return temp;
+}
+
+void runner_submit(struct runner *runner, struct vm *vm)
+{
+	if(run_instance(vm) != 0) runner->failed++;
+	fflush(vm->out);
+}
+
+int runner_wait(struct runner *runner)
+{
+	int failed = runner->failed;
+	runner->failed = 0;
+	
+	return failed;
+}
+
+void free_runner(struct runner *runner)
+{
+	free(runner);
+}
+#endif
+
+/* records the function that was just emitted and the stack depth it needs, so its frames can be sized once */
+struct vm * add_function(struct vm *vm, int label, int name, int num_of_args, int num_of_locals)
+{
+	/* grown by doubling, a realloc per function copies the whole table over and over in a thread's malloc arena */
+	if(vm->num_of_funcs == vm->funcs_size)
+	{
+		vm->funcs_size = vm->funcs_size ? vm->funcs_size * 2 : 8;
+		vm->funcs = realloc(vm->funcs, vm->funcs_size * sizeof(struct function));
+	}
+	vm->num_of_funcs++;
+	vm->funcs[vm->num_of_funcs-1].label = label;
+	vm->funcs[vm->num_of_funcs-1].num_of_args = num_of_args;
+	vm->funcs[vm->num_of_funcs-1].num_of_locals = num_of_locals;
+	vm->funcs[vm->num_of_funcs-1].max_depth = vm->max_depth;
+	vm->funcs[vm->num_of_funcs-1].start = -1;
+	vm->funcs[vm->num_of_funcs-1].offset = -1;
+	vm->funcs[vm->num_of_funcs-1].name = name;
+	
+	vm->depth = 0;
+	vm->max_depth = 0;
+	
+	return vm;
+}
+
+struct vm * add_const(struct vm *vm, struct bignum *n)
+{
+	if(vm->num_of_consts == vm->consts_size)
+	{
+		vm->consts_size = vm->consts_size ? vm->consts_size * 2 : 8;
+		vm->consts = realloc(vm->consts, vm->consts_size * sizeof(struct bignum *));
+	}
+	vm->num_of_consts++;
+	vm->consts[vm->num_of_consts-1] = n;
+	
+	return vm;
+}
+
+/* the constant a binary instruction makes out of two constants, NULL if it has to be left for run time */
+struct bignum * fold(enum inst_type type, struct bignum *a, struct bignum *b)
+{
+	switch(type)
+	{
+		case plus:      return val_add(a, b);
+		case minus:     return val_sub(a, b);
+		case multiply:  return val_mul(a, b);
+		case divide:    return val_is_zero(b) ? NULL : val_div(a, b); /* the error is raised when it runs */
+		case less_than: return SMALL(val_cmp(a, b) < 0);
+		case more_than: return SMALL(val_cmp(a, b) > 0);
+		case and:       return SMALL(!val_is_zero(a) && !val_is_zero(b));
+		case or:        return SMALL(!val_is_zero(a) || !val_is_zero(b));
+		default:        return NULL;
+	}
+}
+
+/* replaces code[i] with type and up to 3 operands; they are allocated anew, code[i] may share its old ones after a memmove */
+void set_inst(struct vm *vm, int i, enum inst_type type, int num_of_args, int a, int b, int c)
+{
+	vm->code[i].type = type;
+	vm->code[i].args = create_args(vm->arena, 3, a, b, c);
+	vm->code[i].num_of_args = num_of_args;
+}
+
+/*
+	peephole pass between parse and link_code. instructions are copied down one at a time and
+	after each the end of what has been kept so far is rewritten until nothing matches:
+
+		decl                                         (dropped, enter makes room for locals)
+		param                                        (dropped, arguments stay on the stack for call)
+		push_val a, push_val b, <binary op>       -> push_val a op b
+		push_loc/push_val, pop                    -> (nothing)
+		push_adr a ... set_equal                  -> ... store a
+		push_val c, store a                       -> store_val a, c
+		push_loc b, store a                       -> store_loc a, b
+		push_loc a, push_val c, plus/minus, store a -> add_loc_val a, c (or -c)
+		push_val c, jmpf L                        -> jmp L if c is 0, otherwise nothing
+		less_than/more_than, jmpf L               -> jmpf_less/jmpf_more L
+		push_loc a, push_val c, jmpf_less/more L  -> jmpf_less/more_loc_val L, a, c
+		call L, ret_val                           -> tail_call L
+
+	a label is never part of a pattern, so nothing is fused across a jump target. push_adr is
+	only ever emitted at the start of an assignment and expressions hold no statements, so the
+	set_equal that ends an assignment belongs to the last push_adr still waiting for one
+*/
+struct vm * optimize_code(struct vm *vm)
+{
+	int *adrs = malloc((vm->num_of_insts + 1) * sizeof(int)); /* kept push_adrs without their set_equal yet */
+	int num_of_adrs = 0;
+	
+	int i, n = 0;
+	for(i = 0; i<vm->num_of_insts; i++)
+	{
+		if(vm->code[i].type == decl || vm->code[i].type == param) continue;
+		
+		vm->code[n] = vm->code[i];
+		n++;
+		
+		if(vm->code[n-1].type == push_adr) adrs[num_of_adrs++] = n-1;
+		
+		for(;;)
+		{
+			struct inst *last = &vm->code[n-1];
+			struct inst *prev = n >= 2 ? &vm->code[n-2] : NULL;
+			struct inst *prev2 = n >= 3 ? &vm->code[n-3] : NULL;
+			struct inst *prev3 = n >= 4 ? &vm->code[n-4] : NULL;
+			
+			if(prev2 != NULL && prev2->type == push_val && prev->type == push_val)
+			{
+				struct bignum *k = fold(last->type, vm->consts[prev2->args[0]], vm->consts[prev->args[0]]);
+				
+				if(k != NULL)
+				{
+					vm = add_const(vm, k);
+					prev2->args[0] = vm->num_of_consts-1;
+					n -= 2;
+					continue;
+				}
+			}
+			
+			if(last->type == pop && prev != NULL && (prev->type == push_loc || prev->type == push_val))
+			{
+				n -= 2;
+				break;
+			}
+			
+			if(last->type == set_equal && num_of_adrs > 0)
+			{
+				int p = adrs[--num_of_adrs];
+				int a = vm->code[p].args[0];
+				
+				memmove(&vm->code[p], &vm->code[p+1], (n-1 - (p+1)) * sizeof(struct inst));
+				n--;
+				
+				set_inst(vm, n-1, store, 1, a, 0, 0);
+				continue;
+			}
+			
+			if(last->type == store && prev3 != NULL && prev3->type == push_loc && prev2->type == push_val &&
+			   (prev->type == plus || prev->type == minus) && prev3->args[0] == last->args[0])
+			{
+				int a = last->args[0];
+				int c = prev2->args[0];
+				
+				if(prev->type == minus)
+				{
+					vm = add_const(vm, val_sub(vm->zero, vm->consts[(int)c]));
+					c = vm->num_of_consts-1;
+				}
+				
+				n -= 3;
+				set_inst(vm, n-1, add_loc_val, 2, a, c, 0);
+				break;
+			}
+			
+			if(last->type == store && prev != NULL && (prev->type == push_val || prev->type == push_loc))
+			{
+				int a = last->args[0];
+				int b = prev->args[0];
+				
+				n--;
+				set_inst(vm, n-1, prev->type == push_val ? store_val : store_loc, 2, a, b, 0);
+				break;
+			}
+			
+			if(last->type == jmpf && prev != NULL && prev->type == push_val)
+			{
+				int target = last->args[0];
+				
+				if(val_is_zero(vm->consts[prev->args[0]]))
+				{
+					n--;
+					set_inst(vm, n-1, jmp, 1, target, 0, 0);
+				} else
+				{
+					n -= 2;
+				}
+				break;
+			}
+			
+			if(last->type == jmpf && prev != NULL && (prev->type == less_than || prev->type == more_than))
+			{
+				int target = last->args[0];
+				enum inst_type type = prev->type == less_than ? jmpf_less : jmpf_more;
+				
+				n--;
+				set_inst(vm, n-1, type, 1, target, 0, 0);
+				continue;
+			}
+			
+			if(last->type == ret_val && prev != NULL && prev->type == call)
+			{
+				int target = prev->args[0];
+				
+				n--;
+				set_inst(vm, n-1, tail_call, 1, target, 0, 0);
+				break;
+			}
+			
+			if((last->type == jmpf_less || last->type == jmpf_more) && prev2 != NULL && prev2->type == push_loc && prev->type == push_val)
+			{
+				int target = last->args[0];
+				int a = prev2->args[0];
+				int c = prev->args[0];
+				enum inst_type type = last->type == jmpf_less ? jmpf_less_loc_val : jmpf_more_loc_val;
+				
+				n -= 2;
+				set_inst(vm, n-1, type, 3, target, a, c);
+				break;
+			}
+			
+			break;
+		}
+	}
+	
+	vm->num_of_insts = n;
+	
+	free(adrs);
+	
+	return vm;
+}
+
+/*
+	what an entry of the operand stack holds while translate_regs follows the stack code: a
+	value in a register or a constant, in the same encoding as the operands, or the local that
+	push_adr pushed
+*/
+struct vreg
+{
+	int operand;
+	int adr; /* from push_adr, operand is then the local */
+};
+
+/*
+	compiles the code parse emitted into register code, the same way run_vm would have run it,
+	but keeping track of where each value on the operand stack is instead of pushing it. a
+	push_loc or push_val pushes nothing, so the instruction that uses it reads the local or the
+	constant directly; the result of an operator goes to the register for the depth it ends up at.
+	every statement leaves the stack empty, so it is empty at every label and nothing has to be
+	carried over a jump
+*/
+struct vm * translate_regs(struct vm *vm)
+{
+	struct inst *code = vm->code;
+	int num_of_insts = vm->num_of_insts;
+	
+	vm->code = NULL;
+	vm->num_of_insts = 0;
+	vm->code_size = 0;
+	
+	/* as deep as the deepest function goes */
+	int size = 1;
+	int i;
+	for(i = 0; i<vm->num_of_funcs; i++) if(vm->funcs[i].max_depth + 1 > size) size = vm->funcs[i].max_depth + 1;
+	
+	struct vreg *stack = malloc(size * sizeof(struct vreg));
+	int depth = 0;
+	int num_of_locals = 0; /* of the function being translated, temporaries come after them */
+	
+	/* index into funcs or -1 for every label, as link_code has it, so a label isn't looked for in all of them */
+	int *func_of = malloc((vm->num_of_labels + 1) * sizeof(int));
+	for(i = 0; i<vm->num_of_labels; i++) func_of[i] = -1;
+	for(i = 0; i<vm->num_of_funcs; i++) func_of[vm->funcs[i].label] = i;
+	
+	for(i = 0; i<num_of_insts; i++)
+	{
+		struct inst *inst = &code[i];
+		struct inst *last = vm->num_of_insts > 0 ? &vm->code[vm->num_of_insts-1] : NULL;
+		
+		switch(inst->type)
+		{
+			case label:
+			{
+				int f = func_of[inst->args[0]];
+				if(f != -1) num_of_locals = vm->funcs[f].num_of_locals;
+				
+				depth = 0;
+				vm = emit_code(vm, label, inst->args, 1);
+			}
+			break;
+			
+			case decl: break;
+			
+			case push_adr:
+				stack[depth].operand = inst->args[0];
+				stack[depth].adr = 1;
+				depth++;
+			break;
+			
+			case push_loc:
+				stack[depth].operand = inst->args[0];
+				stack[depth].adr = 0;
+				depth++;
+			break;
+			
+			case push_val:
+				stack[depth].operand = -inst->args[0] - 1;
+				stack[depth].adr = 0;
+				depth++;
+			break;
+			
+			case set_equal:
+			{
+				int a = stack[depth-2].operand;
+				int v = stack[depth-1].operand;
+				depth -= 2;
+				
+				/* a temporary was written by the instruction just before, which can write the local instead */
+				if(v >= num_of_locals && last != NULL && last->type >= r_move && last->type <= r_or && last->args[0] == v)
+				{
+					last->args[0] = a;
+				} else
+				{
+					vm = emit_code(vm, r_move, create_args(vm->arena, 2, a, v), 2);
+				}
+			}
+			break;
+			
+			case plus:
+			case minus:
+			case multiply:
+			case divide:
+			case less_than:
+			case more_than:
+			case and:
+			case or:
+			{
+				int a = stack[depth-2].operand;
+				int b = stack[depth-1].operand;
+				depth -= 2;
+				
+				struct bignum *k = a < 0 && b < 0 ? fold(inst->type, vm->consts[-a-1], vm->consts[-b-1]) : NULL;
+				
+				if(k != NULL)
+				{
+					vm = add_const(vm, k);
+					stack[depth].operand = -vm->num_of_consts;
+				} else
+				{
+					int d = num_of_locals + depth;
+					vm = emit_code(vm, r_less_than + (inst->type - less_than), create_args(vm->arena, 3, d, a, b), 3);
+					stack[depth].operand = d;
+				}
+				
+				stack[depth].adr = 0;
+				depth++;
+			}
+			break;
+			
+			case param:
+				depth--;
+				vm = emit_code(vm, r_param, create_args(vm->arena, 1, stack[depth].operand), 1);
+			break;
+			
+			case call:
+			{
+				if(i+1 < num_of_insts && code[i+1].type == ret_val)
+				{
+					vm = emit_code(vm, r_tail_call, inst->args, 1);
+					i++;
+					break;
+				}
+				
+				int d = num_of_locals + depth;
+				vm = emit_code(vm, r_call, create_args(vm->arena, 2, inst->args[0], d), 2);
+				
+				stack[depth].operand = d;
+				stack[depth].adr = 0;
+				depth++;
+			}
+			break;
+			
+			case pop: depth--; break;
+			
+			case print:
+				depth--;
+				vm = emit_code(vm, r_print, create_args(vm->arena, 2, stack[depth].operand, inst->args[0]), 2);
+			break;
+			
+			case ret_val:
+				depth--;
+				vm = emit_code(vm, r_ret, create_args(vm->arena, 1, stack[depth].operand), 1);
+			break;
+			
+			case ret_none: vm = emit_code(vm, r_ret_none, NULL, 0); break;
+			
+			case jmp: vm = emit_code(vm, r_jmp, inst->args, 1); break;
+			
+			case jmpf:
+			{
+				int v = stack[depth-1].operand;
+				depth--;
+				
+				/* a comparison into the register just tested becomes the branch */
+				if(v >= num_of_locals && last != NULL && (last->type == r_less_than || last->type == r_more_than) && last->args[0] == v)
+				{
+					last->type = last->type == r_less_than ? r_jmpf_less : r_jmpf_more;
+					last->args[0] = inst->args[0];
+				} else
+				{
+					vm = emit_code(vm, r_jmpf, create_args(vm->arena, 2, inst->args[0], v), 2);
+				}
+			}
+			break;
+			
+			default:
+				printf("ERROR! %s can't be translated to registers!\n", inst_names[inst->type]);
+				exit(-1);
+		}
+	}
+	
+	free(stack);
+	free(func_of);
+	
+	vm->registers = 1;
+	
+	return vm;
+}
+
+void print_code(struct vm *vm)
+{
+    int i;
+    for(i = 0; i<vm->num_of_insts; i++)
+    {
+        printf("(");
+        
+        printf("%s", inst_names[vm->code[i].type]);
+        
+        if(vm->code[i].type == push_val)
+        {
+            printf(" ");
+            val_print(stdout, vm->consts[vm->code[i].args[0]], 0);
+        } else
+        {
+            int j;
+            for(j = 0; j<vm->code[i].num_of_args; j++)
+            {
+                if(j == 0) printf(" %d", vm->code[i].args[j]);
+                if(j > 0)  printf(", %d", vm->code[i].args[j]);
+            }
+        }
+        
+        printf(")\n");
+    }
+}
+
+#define TK_RING 4 /* a power of 2, at least 2 for prev_tk */
+
+/* a token as parse_jobs keeps them, in half the space; the lexeme comes back from type and sym */
+struct lexed
+{
+	enum tk_type type;
+	int sym;
+};
+
+struct parser
+{
+	char *code;
+	int begin;
+	struct arena *arena; /* symbol tables, freed once the code is emitted */
+	
+	/* tokens are lexed as the parser asks for them, only the current one and the one before it are ever looked at */
+	struct token ring[TK_RING];
+	int tk_pos; /* tokens read so far, current_tk is ring[tk_pos % TK_RING] */
+	struct token *current_tk;
+	
+	/* for parse_jobs: one function lexed already, read from here with begin as the index, instead of code */
+	struct lexed *tokens;
+	int num_of_tokens;
+	int unit; /* that function's index, -1 in a serial parse */
+	
+	int panic;
+	int syntax_error; /* used to supress semantic errors if a syntax error occurs */
+	int had_error;
+	
+	struct node *current_tb;
+	int rel_addr;
+	
+	struct vm *vm;
+}; 
+
+void error(struct parser *parser, char *msg)
+{
+	if(parser->panic) return;
+	
+	compile_error("ERROR: %s\n", msg);
+	parser->panic = 1;
+	parser->syntax_error = 1;
+	parser->had_error = 1;
+}
+
+/* lexes the next token into the ring, past the end of input it stays on eoi */
+void advance(struct parser *parser)
+{
+	if(parser->current_tk != NULL && parser->current_tk->type == eoi) return;
+	
+	parser->tk_pos++;
+	parser->current_tk = &parser->ring[parser->tk_pos & (TK_RING - 1)];
+	
+	if(parser->tokens == NULL)
+	{
+		*parser->current_tk = next_token(parser->code, &parser->begin);
+	} else if(parser->begin < parser->num_of_tokens)
+	{
+		struct lexed *tk = &parser->tokens[parser->begin];
+		
+		parser->current_tk->type = tk->type;
+		parser->current_tk->sym = tk->sym;
+		parser->current_tk->lex = tk->sym == -1 ? tk_names[tk->type] : interner.strings[tk->sym];
+		parser->begin++;
+	} else
+	{
+		parser->current_tk->lex = tk_names[eoi];
+		parser->current_tk->type = eoi;
+		parser->current_tk->sym = -1;
+	}
+}
+
+/* the token before current_tk */
+struct token * prev_tk(struct parser *parser)
+{
+	return &parser->ring[(parser->tk_pos - 1) & (TK_RING - 1)];
+}
+
+void expect_type(struct parser *parser, enum tk_type type)
+{
+	if(parser->current_tk->type != type)
+	{
+		error(parser, "expected different token type!");
+	}
+	
+	if(!parser->panic) advance(parser); /* advance input if not panicking */
+}
+
+void parser_and(struct parser *parser); /* forward declaration for funcparens and val */
+
+/* a function to call. a worker of parse_jobs has them all, but those after its own aren't declared yet in a serial parse */
+struct entry * search_func(struct parser *parser, int sym)
+{
+	struct entry *entry = search_entry(parser->current_tb, sym, func_type);
+	
+	if(entry != NULL && parser->unit != -1 && entry->rel_addr > parser->unit)
+	{
+		compile_error("ERROR! '%s' hasn't been declared!\n", sym_name(sym));
+		return NULL;
+	}
+	
+	return entry;
+}
+
+int funcparens(struct parser *parser)
+{
+	int args = 0;
+	
+	expect_type(parser, tk_lparen);
+	
+	if(parser->current_tk->type == id  || 
+	   parser->current_tk->type == num ||
+	   parser->current_tk->type == integer)
+	{
+		parser_and(parser);
+		
+		if(!parser->had_error) parser->vm = emit_code(parser->vm, param, NULL, 0);
+		
+		args++;
+		
+		while(parser->current_tk->type == tk_comma)
+		{
+			if(parser->panic) break;
+			
+			expect_type(parser, tk_comma);
+			parser_and(parser);
+				
+			if(!parser->had_error) parser->vm = emit_code(parser->vm, param, NULL, 0);
+			
+			args++;
+		}
+	}
+	
+	expect_type(parser, tk_rparen);
+	
+	return args;
+}
+
+void val(struct parser *parser)
+{	
+	struct entry *entry;
+
+	if(parser->current_tk->type == id)
+	{
+		int temp_sym = parser->current_tk->sym;
+		enum type temp_type = var_type;
+		
+		expect_type(parser, id);
+		
+		if(parser->current_tk->type == tk_lparen)
+		{
+			if(!parser->syntax_error)
+			{
+				entry = search_func(parser, temp_sym);
+				
+				int args = funcparens(parser);
+				
+				if(entry == NULL)
+				{
+					parser->had_error = 1;
+				} else if(entry->num_of_args != args)
+				{
+					compile_error("ERROR: incorrect number of arguments!\n");
+					parser->had_error = 1;
+				}
+			}
+			
+			if(!parser->had_error)
+			{
+				parser->vm = emit_call(parser->vm, entry->rel_addr, entry->num_of_args);
+			}
+		} else
+		{
+			if(!parser->syntax_error)
+			{
+				entry = search_entry(parser->current_tb, temp_sym, temp_type);
+				
+				if(entry == NULL) parser->had_error = 1;
+			}
+			
+			if(!parser->had_error)
+			{
+				int *args = create_args(parser->vm->arena, 1, entry->rel_addr);
+				parser->vm = emit_code(parser->vm, push_loc, args, 1);
+			}
+		}
+	} else if(parser->current_tk->type == num ||
+			  parser->current_tk->type == integer)
+	{
+		if(parser->current_tk->type == num)
+		{
+			compile_error("ERROR: '%s' is not an integer!\n", parser->current_tk->lex);
+			parser->had_error = 1;
+		}
+		
+		if(!parser->had_error)
+		{
+			char *lex = parser->current_tk->lex;
+			parser->vm = add_const(parser->vm, val_norm(bn_from_str(lex, strlen(lex))));
+			
+			int *args = create_args(parser->vm->arena, 1, parser->vm->num_of_consts-1);
+			parser->vm = emit_code(parser->vm, push_val, args, 1);
+		}
+		expect_type(parser, parser->current_tk->type);
+	} else if(parser->current_tk->type == tk_lparen)
+	{
+		expect_type(parser, tk_lparen);
+		parser_and(parser);
+		expect_type(parser, tk_rparen);
+	} else
+	{
+		error(parser, "bad value.");
+	}
+}
+
+void term(struct parser *parser)
+{
+	val(parser);
+	
+	while(parser->current_tk->type == tk_star ||
+	      parser->current_tk->type == tk_slash)
+	{
+		if(parser->panic) break;
+		
+		enum tk_type temp = parser->current_tk->type;
+		
+		expect_type(parser, parser->current_tk->type);
+		val(parser);
+		
+		if(!parser->had_error)
+		{
+			if(temp == tk_star) parser->vm = emit_code(parser->vm, multiply, NULL, 0);
+			if(temp == tk_slash) parser->vm = emit_code(parser->vm, divide, NULL, 0);
+		}
+	}
+}
+
+void expr(struct parser *parser)
+{
+	term(parser);
+	
+	while(parser->current_tk->type == tk_plus ||
+	      parser->current_tk->type == tk_minus)
+	{
+		if(parser->panic) break;
+		
+		enum tk_type temp = parser->current_tk->type;
+		
+		expect_type(parser, parser->current_tk->type);
+		term(parser);
+		
+		if(!parser->had_error)
+		{
+			if(temp == tk_plus) parser->vm = emit_code(parser->vm, plus, NULL, 0);
+			if(temp == tk_minus) parser->vm = emit_code(parser->vm, minus, NULL, 0);
+		}
+	}
+}
+
+void rel(struct parser *parser)
+{
+	expr(parser);
+	
+	while(parser->current_tk->type == tk_less ||
+	      parser->current_tk->type == tk_more)
+	{
+		if(parser->panic) break;
+		
+		enum tk_type temp = parser->current_tk->type;
+		
+		expect_type(parser, parser->current_tk->type);
+		expr(parser);
+		
+		if(!parser->had_error)
+		{
+			if(temp == tk_less) parser->vm = emit_code(parser->vm, less_than, NULL, 0);
+			if(temp == tk_more) parser->vm = emit_code(parser->vm, more_than, NULL, 0);
+		}
+	}
+}
+
+void parser_or(struct parser *parser)
+{
+	rel(parser);
+	
+	while(parser->current_tk->type == tk_or)
+	{
+		if(parser->panic) break;
+		
+		expect_type(parser, tk_or);
+		rel(parser);
+		
+		if(!parser->had_error) parser->vm = emit_code(parser->vm, or, NULL, 0);
+	}
+} 
+
+void parser_and(struct parser *parser)
+{
+	parser_or(parser);
+	
+	while(parser->current_tk->type == tk_and)
+	{
+		if(parser->panic) break;
+		
+		expect_type(parser, tk_and);
+		parser_or(parser);
+		
+		if(!parser->had_error) parser->vm = emit_code(parser->vm, and, NULL, 0);
+	}
+} 
+
+void body(struct parser *parser); /* forward declaration of body for flow */
+
+void flow(struct parser *parser)
+{	
+	enum tk_type temp = parser->current_tk->type;
+
+	expect_type(parser, parser->current_tk->type); /* previous function says it has to be "if" or "while" */
+	
+	if(!parser->syntax_error) parser->current_tb = push_tb(parser->arena, parser->current_tb);
+	
+	expect_type(parser, tk_lparen);
+	
+	int temp_label = parser->vm->num_of_labels;
+	
+	if(temp == tk_if)
+	{
+		parser_and(parser);
+		if(!parser->had_error)
+		{
+			int *args = create_args(parser->vm->arena, 1, temp_label);
+			parser->vm = emit_code(parser->vm, jmpf, args, 1);
+			parser->vm->num_of_labels++;
+		}
+	} else if(temp == tk_while)
+	{
+		if(!parser->had_error)
+		{
+			int *args = create_args(parser->vm->arena, 1, temp_label);
+			parser->vm = emit_code(parser->vm, label, args, 1);
+		}
+		
+		parser_and(parser);
+		
+		if(!parser->had_error)
+		{
+			int *args = create_args(parser->vm->arena, 1, temp_label+1);
+			parser->vm = emit_code(parser->vm, jmpf, args, 1);
+			parser->vm->num_of_labels += 2;
+		}
+	}
+	
+	expect_type(parser, tk_arrow);
+	
+	body(parser);
+	
+	if(temp == tk_if)
+	{
+		if(!parser->had_error)
+		{
+			int *args = create_args(parser->vm->arena, 1, temp_label);
+			parser->vm = emit_code(parser->vm, label, args, 1);
+		}
+	} else if(temp == tk_while)
+	{
+		if(!parser->had_error)
+		{
+			int *args1 = create_args(parser->vm->arena, 1, temp_label);
+			parser->vm = emit_code(parser->vm, jmp, args1, 1);
+			
+			int *args2 = create_args(parser->vm->arena, 1, temp_label+1);
+			parser->vm = emit_code(parser->vm, label, args2, 1);
+		}
+	}
+	
+	expect_type(parser, tk_rparen);
+	
+	if(!parser->syntax_error) parser->current_tb = pop_tb(parser->current_tb);
+}
+
+void parser_return(struct parser *parser)
+{
+	expect_type(parser, tk_ret);
+	parser_and(parser);
+	expect_type(parser, tk_semi);
+	
+	if(!parser->had_error) parser->vm = emit_code(parser->vm, ret_val, NULL, 0);
+}
+
+void parser_print(struct parser *parser)
+{
+	struct entry *entry;
+	
+	expect_type(parser, tk_print);
+	
+	if(!parser->syntax_error)
+	{
+		entry = search_entry(parser->current_tb, parser->current_tk->sym, var_type);
+		
+		if(entry == NULL) parser->had_error = 1;
+	}
+	
+	if(!parser->had_error)
+	{
+		int *args = create_args(parser->vm->arena, 1, entry->rel_addr);
+		parser->vm = emit_code(parser->vm, push_loc, args, 1);
+	}
+	
+	expect_type(parser, id);
+	
+	/* print x . n; pads x with zeros to at least n digits */
+	int digits = 0;
+	
+	if(parser->current_tk->type == tk_dot)
+	{
+		expect_type(parser, tk_dot);
+		
+		if(parser->current_tk->type == integer)
+		{
+			char *lex = parser->current_tk->lex;
+			
+			if(strlen(lex) > 9 || atoi(lex) > PRINT_MAX_DIGITS)
+			{
+				compile_error("ERROR: can't print with more than %d digits, not %s!\n", PRINT_MAX_DIGITS, lex);
+				parser->had_error = 1;
+			} else
+			{
+				digits = atoi(lex);
+			}
+		}
+		
+		expect_type(parser, integer);
+	}
+	
+	if(!parser->had_error)
+	{
+		int *args = create_args(parser->vm->arena, 1, digits);
+		parser->vm = emit_code(parser->vm, print, args, 1);
+	}
+	
+	expect_type(parser, tk_semi);
+}
+
+void next(struct parser *parser)
+{
+	struct entry *entry;
+	
+	if(parser->current_tk->type == tk_equal)
+	{
+		if(!parser->syntax_error)
+		{
+			entry = search_entry(parser->current_tb, prev_tk(parser)->sym, var_type);
 			
-			case less_than:
-				inter = top < topminus1;
-				current_frame->op = pop_op(current_frame->op);
-				current_frame->op = pop_op(current_frame->op);
-				current_frame->op = push_op(current_frame->op, inter);
-			break;
+			if(entry == NULL) parser->had_error = 1;
+		}
+		
+		if(!parser->had_error)
+		{
+			int *args = create_args(parser->vm->arena, 1, entry->rel_addr);
+			parser->vm = emit_code(parser->vm, push_adr, args, 1);
+		}
+		
+		expect_type(parser, tk_equal);
+		parser_and(parser);
+		
+		if(!parser->had_error) parser->vm = emit_code(parser->vm, set_equal, NULL, 0);
+		
+		expect_type(parser, tk_semi);
+	} else if(parser->current_tk->type == tk_lparen)
+	{
+		if(!parser->syntax_error)
+		{
+			entry = search_func(parser, prev_tk(parser)->sym);
 			
-			case more_than:
-				inter = top > topminus1;
-				current_frame->op = pop_op(current_frame->op);
-				current_frame->op = pop_op(current_frame->op);
-				current_frame->op = push_op(current_frame->op, inter);
-			break;
+			int args = funcparens(parser);
 			
-			case plus:
-				inter = top + topminus1;
-				current_frame->op = pop_op(current_frame->op);
-				current_frame->op = pop_op(current_frame->op);
-				current_frame->op = push_op(current_frame->op, inter);
-			break;
+			if(entry == NULL)
+			{
+				parser->had_error = 1;
+			} else if(entry->num_of_args != args)
+			{
+				compile_error("ERROR: incorrect number of arguments!\n");
+				parser->had_error = 1;
+			}
 			
-			case minus:
-				inter = top - topminus1;
-				current_frame->op = pop_op(current_frame->op);
-				current_frame->op = pop_op(current_frame->op);
-				current_frame->op = push_op(current_frame->op, inter);
+			if(!parser->had_error)
+			{
+				parser->vm = emit_call(parser->vm, entry->rel_addr, args);
+				
+				/* the call is a statement here, its value isn't used */
+				parser->vm = emit_code(parser->vm, pop, NULL, 0);
+			}
+		}
+		
+		expect_type(parser, tk_semi);
+	} else
+	{
+		error(parser, "bad operator on id.");
+	}
+}
+
+void idstart(struct parser *parser)
+{
+	expect_type(parser, id);
+	next(parser);
+}
+
+void declaration(struct parser *parser)
+{
+	expect_type(parser, tk_decl);
+	
+	if(!parser->syntax_error)
+	{
+		parser->current_tb = create_entry(parser->arena, parser->current_tb, parser->rel_addr, parser->current_tk->sym, var_type);
+		parser->rel_addr++;
+	}
+	
+	if(!parser->had_error)
+	{
+		parser->vm = emit_code(parser->vm, decl, NULL, 0);
+		
+		int *args = create_args(parser->vm->arena, 1, parser->rel_addr-1);
+		parser->vm = emit_code(parser->vm, push_adr, args, 1);
+	}
+	
+	expect_type(parser, id);
+	expect_type(parser, tk_equal);
+	parser_and(parser);
+	
+	if(!parser->had_error) parser->vm = emit_code(parser->vm, set_equal, NULL, 0);
+	
+	expect_type(parser, tk_semi);
+}
+
+void statement(struct parser *parser)
+{
+	if(parser->current_tk->type == tk_decl)
+	{
+		declaration(parser);
+	} else if(parser->current_tk->type == id)
+	{
+		idstart(parser); /* statements that start with an id */
+	} else if(parser->current_tk->type == tk_print)
+	{
+		parser_print(parser);
+	} else if(parser->current_tk->type == tk_ret)
+	{
+		parser_return(parser);
+	} else if(parser->current_tk->type == tk_if ||
+			  parser->current_tk->type == tk_while)
+	{
+		flow(parser);
+	} else
+	{
+		error(parser, "expected different start of statement.");
+	}
+}
+
+void sync(struct parser *parser)
+{
+	while(parser->current_tk->type != eoi)
+	{
+		if(parser->current_tk->type == tk_if ||
+		   parser->current_tk->type == tk_while) break;
+		
+		if(parser->current_tk->type == tk_semi)
+		{
+			advance(parser);
 			break;
+		}
+		
+		advance(parser);
+	}
+	
+	parser->panic = 0;
+}
+
+void body(struct parser *parser)
+{
+	if(parser->panic) sync(parser);
+	
+	while(parser->current_tk->type != tk_rparen)
+	{
+		if(parser->current_tk->type == eoi) break;
+		
+		statement(parser);
+		if(parser->panic) sync(parser);
+	}
+}
+
+void funcdecl(struct parser *parser)
+{	
+	expect_type(parser, tk_lparen);
+
+	/* rel_addr is not incremented for function declarations; parse_jobs has made their entries already, labelled by index */
+	if(!parser->syntax_error && parser->unit == -1)
+	{
+		parser->current_tb = create_entry(parser->arena, parser->current_tb, parser->vm->num_of_labels, parser->current_tk->sym, func_type);
+		parser->vm->num_of_labels++;
+	}
+	
+	int func_label = parser->unit == -1 ? parser->vm->num_of_labels-1 : parser->unit;
+	int func_sym = parser->current_tk->sym;
+	int num_of_args = 0;
+	
+	if(!parser->had_error)
+	{
+		int *args = create_args(parser->vm->arena, 1, func_label);
+		parser->vm = emit_code(parser->vm, label, args, 1);
+	}
+	
+	expect_type(parser, id);
+	
+	if(!parser->syntax_error) parser->current_tb = push_tb(parser->arena, parser->current_tb); /* new scope for inside of function */
+	
+	
+	if(!parser->syntax_error && parser->unit == -1 && parser->current_tb->back != NULL) parser->current_tb->back->entry[parser->current_tb->back->num_of_entries-1].num_of_args = 0;
+	
+	
+	if(parser->current_tk->type == id)
+	{
+		
+		/*
+			THESE ARE FOR FUNCTION ARGUMENTS, ***MIGHT*** NEED TO FIX SYMBOL TABLES LATER FOR THIS
+		*/
+		
+		if(!parser->syntax_error)
+		{
+			parser->current_tb = create_entry(parser->arena, parser->current_tb, parser->rel_addr, parser->current_tk->sym, var_type);
+			if(parser->unit == -1) parser->current_tb->back->entry[parser->current_tb->back->num_of_entries-1].num_of_args++;
+			parser->rel_addr++;
+			num_of_args++;
+		}
+		
+		expect_type(parser, id);
+		
+		while(parser->current_tk->type == tk_comma)
+		{
+			if(parser->panic) break;
+			
+			expect_type(parser, tk_comma);
+			
+			if(!parser->syntax_error)
+			{
+				parser->current_tb = create_entry(parser->arena, parser->current_tb, parser->rel_addr, parser->current_tk->sym, var_type);
+				if(parser->unit == -1) parser->current_tb->back->entry[parser->current_tb->back->num_of_entries-1].num_of_args++;
+				parser->rel_addr++;
+				num_of_args++;
+			}
+			
+			expect_type(parser, id);
+		}
+	}
+	
+	expect_type(parser, tk_arrow);
+	
+	body(parser);
+	
+	expect_type(parser, tk_rparen);
+	
+	if(!parser->had_error)
+	{
+		parser->vm = emit_code(parser->vm, ret_none, NULL, 0);
+		if(parser->unit == -1 && func_sym == intern("main", 4)) parser->vm->main = parser->vm->num_of_funcs;
+		
+		parser->vm = add_function(parser->vm, func_label, func_sym, num_of_args, parser->rel_addr);
+	}
+	
+	if(!parser->syntax_error) parser->current_tb = pop_tb(parser->current_tb);
+}
+
+void funclist(struct parser *parser)
+{
+	parser->current_tb = push_tb(parser->arena, parser->current_tb); /* global scope for function declarations */
+	
+	while(parser->current_tk->type != eoi)
+	{
+		parser->rel_addr = 0;
+		
+		funcdecl(parser);
+	}
+	
+	if(!parser->syntax_error) parser->current_tb = pop_tb(parser->current_tb);
+
+	expect_type(parser, eoi);
+}
+
+void end_phase(struct vm *vm, enum phase phase, size_t allocated, size_t held)
+{
+	vm->mem[phase].allocated = allocated;
+	vm->mem[phase].peak = held;
+}
+
+/* lexes and parses code into a vm with its code emitted but not linked, NULL if there were any errors */
+struct vm * parse(char *code)
+{
+	struct parser *parser = malloc(sizeof(struct parser));
+	
+	lex_reset();
+	
+	parser->code = code;
+	parser->begin = 0;
+	parser->tokens = NULL;
+	parser->num_of_tokens = 0;
+	parser->unit = -1;
+	parser->panic = 0;
+	parser->syntax_error = 0;
+	parser->had_error = 0;
+	
+	parser->arena = create_arena();
+	parser->current_tb = NULL;
+	
+	parser->vm = create_vm();
+	
+	/* the first token, the rest are lexed as funclist goes */
+	parser->tk_pos = -1;
+	parser->current_tk = NULL;
+	advance(parser);
+
+	funclist(parser);
+	
+	/* clears out symbol table stack if an error occurs; this won't do anything if the program
+	   executes properly */
+	while(parser->current_tb != NULL)
+	{
+		parser->current_tb = pop_tb(parser->current_tb);
+	}
+	
+	struct vm *vm = parser->vm;
+	int had_error = parser->had_error;
+	
+	end_phase(vm, phase_parse, parser->arena->allocated + vm->arena->allocated, parser->arena->reserved + vm->arena->reserved);
+	
+	arena_free(parser->arena);
+	free(parser);
+	
+	if(had_error)
+	{
+		free_vm(vm);
+		return NULL;
+	}
+	
+	return vm;
+}
+
+/* a top level function for parse_jobs and a session */
+struct unit
+{
+	int first, end; /* its tokens */
+	int name;
+	int num_of_args;
+	
+	/* filled in by parse_unit, out of whose vm it is merged */
+	struct vm *vm;
+	int code_start, code_end;
+	int const_start, const_end;
+	int label_start, label_end; /* the labels inside it, its own is its index */
+	int func; /* index into vm->funcs */
+	int failed;
+};
+
+/*
+	parses units[k] on its own into parser->vm, which has its first num_of_units labels kept for
+	the functions, out of tokens. every function is in globals already, labelled by its index
+*/
+void parse_unit(struct parser *parser, struct unit *units, int k, struct lexed *tokens, struct node *globals)
+{
+	struct unit *unit = &units[k];
+	
+	parser->tokens = tokens + unit->first;
+	parser->num_of_tokens = unit->end - unit->first;
+	parser->begin = 0;
+	parser->unit = k;
+	parser->panic = 0;
+	parser->syntax_error = 0;
+	parser->had_error = 0;
+	parser->current_tb = globals;
+	parser->rel_addr = 0;
+	parser->tk_pos = -1;
+	parser->current_tk = NULL;
+	
+	quiet_errors = 0;
+	
+	unit->vm = parser->vm;
+	unit->code_start = parser->vm->num_of_insts;
+	unit->const_start = parser->vm->num_of_consts;
+	unit->label_start = parser->vm->num_of_labels;
+	
+	advance(parser);
+	funcdecl(parser);
+	
+	unit->code_end = parser->vm->num_of_insts;
+	unit->const_end = parser->vm->num_of_consts;
+	unit->label_end = parser->vm->num_of_labels;
+	unit->func = parser->vm->num_of_funcs - 1;
+	unit->failed = parser->had_error || quiet_errors > 0 || parser->current_tk->type != eoi;
+}
+
+#ifdef THREADS
+
+struct pool
+{
+	struct lexed *tokens;
+	struct node *globals; /* every function, read only while the workers run */
+	struct unit *units;
+	int num_of_units;
+	
+	pthread_mutex_t lock;
+	int next; /* the unit to hand out next */
+};
+
+/* takes units off the pool until there are none left, parsing them into a vm of its own */
+void * parse_worker(void *arg)
+{
+	struct pool *pool = arg;
+	struct parser *parser = malloc(sizeof(struct parser));
+	
+	quiet = 1;
+	pool_thread = 1;
+	
+	parser->code = NULL;
+	parser->arena = create_arena();
+	parser->vm = create_vm();
+	parser->vm->num_of_labels = pool->num_of_units; /* the ones below are the functions' */
+	
+	for(;;)
+	{
+		pthread_mutex_lock(&pool->lock);
+		int k = pool->next;
+		pool->next++;
+		pthread_mutex_unlock(&pool->lock);
+		
+		if(k >= pool->num_of_units) break;
+		
+		parse_unit(parser, pool->units, k, pool->tokens, pool->globals);
+	}
+	
+	return parser;
+}
+
+/* one vm out of the workers', as parse would have made it */
+struct vm * merge_units(struct unit *units, int num_of_units, int main_sym)
+{
+	struct vm *vm = create_vm();
+	
+	int *label_of = malloc(num_of_units * sizeof(int));
+	int labels = 0;
+	
+	int k, i;
+	for(k = 0; k<num_of_units; k++) vm->code_size += units[k].code_end - units[k].code_start;
+	vm->code = arena_alloc(vm->arena, vm->code_size * sizeof(struct inst));
+	vm->funcs = malloc(num_of_units * sizeof(struct function));
+	vm->funcs_size = num_of_units;
+	
+	for(k = 0; k<num_of_units; k++)
+	{
+		struct unit *unit = &units[k];
+		
+		/* its label, then the ones inside it, numbered on from there as parse would have */
+		label_of[k] = labels;
+		labels += 1 + unit->label_end - unit->label_start;
+		
+		int const_base = vm->num_of_consts;
+		for(i = unit->const_start; i<unit->const_end; i++) vm = add_const(vm, unit->vm->consts[i]);
+		
+		for(i = unit->code_start; i<unit->code_end; i++)
+		{
+			struct inst *inst = &vm->code[vm->num_of_insts];
+			*inst = unit->vm->code[i];
+			vm->num_of_insts++;
 			
-			case multiply:
-				inter = top * topminus1;
-				current_frame->op = pop_op(current_frame->op);
-				current_frame->op = pop_op(current_frame->op);
-				current_frame->op = push_op(current_frame->op, inter);
-			break;
+			/* the operands are each instruction's own, and are taken over with the workers' arenas */
+			int *args = inst->args;
 			
-			case divide:
-				inter = top / topminus1;
-				current_frame->op = pop_op(current_frame->op);
-				current_frame->op = pop_op(current_frame->op);
-				current_frame->op = push_op(current_frame->op, inter);
-			break;
+			if(inst->num_of_args == 0) continue;
 			
-			case and:
-				inter = (unsigned int)top && (unsigned int)topminus1;
-				current_frame->op = pop_op(current_frame->op);
-				current_frame->op = pop_op(current_frame->op);
-				current_frame->op = push_op(current_frame->op, (float)inter);
+			if(inst->type == label || is_branch(inst->type))
+			{
+				int n = args[0];
+				args[0] = n < num_of_units ? label_of[n] : label_of[k] + 1 + (n - unit->label_start);
+			} else if(inst->type == push_val)
+			{
+				args[0] += const_base - unit->const_start;
+			}
+		}
+		
+		vm->funcs[k] = unit->vm->funcs[unit->func];
+		vm->funcs[k].label = label_of[k];
+		vm->funcs[k].name = unit->name;
+		vm->num_of_funcs++;
+		
+		if(unit->name == main_sym) vm->main = k;
+	}
+	
+	vm->num_of_labels = labels;
+	
+	free(label_of);
+	
+	return vm;
+}
+
+/*
+	parse on jobs threads. the whole source is lexed first, serially, so symbols are interned in
+	the same order as in a serial parse, and split where each top level function's parens close.
+	the functions all go in one global scope before any is parsed, so a call resolves whichever
+	thread got to its callee, and each is then parsed on its own into the vm of the worker that
+	took it: functions labelled by their index, everything else numbered from past the last of
+	them. merge_units puts them back together in source order, renumbering labels and constants,
+	so what comes out is what parse makes, instruction for instruction. on any error, or anything
+	that doesn't split cleanly, it throws the lot away and returns what parse does, which prints
+	the errors
+*/
+struct vm * parse_jobs(char *code, int jobs)
+{
+	if(jobs <= 1) return parse(code);
+	
+	quiet = 1;
+	quiet_errors = 0;
+	
+	lex_reset();
+	
+	struct lexed *tokens = NULL;
+	int num_of_tokens = 0, tokens_size = 0;
+	
+	/* parse interns "main" after the first function's ) and one more token */
+	int main_sym = -1, closed = 0, depth = 0, begin = 0;
+	
+	struct token tk;
+	do
+	{
+		tk = next_token(code, &begin);
+		
+		if(num_of_tokens == tokens_size)
+		{
+			tokens_size = tokens_size * 2 + 1024;
+			tokens = realloc(tokens, tokens_size * sizeof(struct lexed));
+		}
+		
+		tokens[num_of_tokens].type = tk.type;
+		tokens[num_of_tokens].sym = tk.sym;
+		num_of_tokens++;
+		
+		if(closed == 1)
+		{
+			main_sym = intern("main", 4);
+			closed = 2;
+		}
+		
+		if(tk.type == tk_lparen) depth++;
+		if(tk.type == tk_rparen && --depth == 0 && closed == 0) closed = 1;
+	} while(tk.type != eoi);
+	
+	struct unit *units = NULL;
+	int num_of_units = 0, units_size = 0;
+	
+	int i = 0, clean = quiet_errors == 0;
+	while(clean && tokens[i].type != eoi)
+	{
+		if(tokens[i].type != tk_lparen || tokens[i+1].type != id)
+		{
+			clean = 0;
 			break;
-			
-			case or:
-				inter = (unsigned int)floor(top) || (unsigned int)floor(topminus1);
-				current_frame->op = pop_op(current_frame->op);
-				current_frame->op = pop_op(current_frame->op);
-				current_frame->op = push_op(current_frame->op, (float)inter);
+		}
+		
+		if(num_of_units == units_size)
+		{
+			units_size = units_size * 2 + 256;
+			units = realloc(units, units_size * sizeof(struct unit));
+		}
+		
+		struct unit *unit = &units[num_of_units];
+		num_of_units++;
+		
+		unit->first = i;
+		unit->name = tokens[i+1].sym;
+		unit->num_of_args = 0;
+		unit->vm = NULL;
+		unit->failed = 0;
+		
+		int j;
+		for(j = i + 2; tokens[j].type == id || tokens[j].type == tk_comma; j++) if(tokens[j].type == id) unit->num_of_args++;
+		
+		for(depth = 0, j = i; tokens[j].type != eoi; j++)
+		{
+			if(tokens[j].type == tk_lparen) depth++;
+			if(tokens[j].type == tk_rparen && --depth == 0) break;
+		}
+		
+		if(tokens[j].type == eoi)
+		{
+			clean = 0;
 			break;
 		}
 		
-		print_top(vm->stack);
-		getchar();
+		unit->end = i = j + 1;
+	}
+	
+	struct arena *arena = create_arena();
+	struct node *globals = push_tb(arena, NULL);
+	
+	for(i = 0; clean && i<num_of_units; i++)
+	{
+		globals = create_entry(arena, globals, i, units[i].name, func_type);
+		globals->entry[globals->num_of_entries-1].num_of_args = units[i].num_of_args;
+	}
+	
+	/* a redeclared function */
+	if(quiet_errors > 0) clean = 0;
+	
+	quiet = 0;
+	
+	if(!clean || num_of_units < 2)
+	{
+		arena_free(arena);
+		free(units);
+		free(tokens);
+		
+		return parse(code);
+	}
+	
+	if(jobs > num_of_units) jobs = num_of_units;
+	
+	struct pool pool;
+	pool.tokens = tokens;
+	pool.globals = globals;
+	pool.units = units;
+	pool.num_of_units = num_of_units;
+	pool.next = 0;
+	pthread_mutex_init(&pool.lock, NULL);
+	
+	pthread_t *threads = malloc(jobs * sizeof(pthread_t));
+	struct parser **workers = malloc(jobs * sizeof(struct parser *));
+	
+	int started;
+	for(started = 0; started<jobs; started++)
+	{
+		if(pthread_create(&threads[started], NULL, parse_worker, &pool) != 0) break;
+	}
+	
+	for(i = 0; i<started; i++)
+	{
+		void *worker;
+		pthread_join(threads[i], &worker);
+		workers[i] = worker;
+	}
+	
+	/* if no thread could be started, this one does it all */
+	if(started == 0)
+	{
+		workers[0] = parse_worker(&pool);
+		started = 1;
+	}
+	
+	pthread_mutex_destroy(&pool.lock);
+	
+	quiet = 0;
+	
+	int failed = 0;
+	for(i = 0; i<num_of_units; i++) failed |= units[i].failed;
+	
+	struct vm *vm = NULL;
+	size_t allocated = arena->allocated, held = arena->reserved;
+	
+	if(!failed) vm = merge_units(units, num_of_units, main_sym);
+	
+	for(i = 0; i<started; i++)
+	{
+		allocated += workers[i]->arena->allocated;
+		held += workers[i]->arena->reserved;
+		
+		/* the constants have been moved to vm, and the operands go with the arena */
+		if(!failed)
+		{
+			workers[i]->vm->num_of_consts = 0;
+			arena_adopt(vm->arena, workers[i]->vm->arena);
+		}
+		
+		free_vm(workers[i]->vm);
+		arena_free(workers[i]->arena);
+		free(workers[i]);
 	}
+	
+	free(workers);
+	free(threads);
+	arena_free(arena);
+	free(units);
+	free(tokens);
+	
+	if(failed) return parse(code);
+	
+	end_phase(vm, phase_parse, allocated + vm->arena->allocated, held + vm->arena->reserved);
+	
+	return vm;
+}
+#else
+struct vm * parse_jobs(char *code, int jobs)
+{
+	return parse(code);
 }
+#endif
 
-float * create_args(int num_of_args, ...)
+/* lexes and parses code into a vm that is ready to run, NULL if there were any errors; jobs is threads for parse_jobs */
+struct vm * compile(char *code, int jobs)
 {
-    va_list list;
-    va_start(list, num_of_args);
-    
-    float *temp = malloc(num_of_args * sizeof(float));
-    
-    int i;
-    for(i = 0; i<num_of_args; i++) temp[i] = va_arg(list, double);
-    
-    va_end(list);
-    
-    return temp;
+	struct vm *vm = parse_jobs(code, jobs);
+	
+	if(vm == NULL) return NULL;
+	
+	size_t before = vm->arena->allocated;
+	
+	vm = optimize_code(vm);
+	end_phase(vm, phase_optimize, vm->arena->allocated - before, vm->arena->reserved);
+	
+	before = vm->arena->allocated;
+	
+	vm = link_code(vm);
+	end_phase(vm, phase_link, vm->arena->allocated - before, vm->arena->reserved);
+	
+	before = vm->arena->allocated;
+	
+	vm = pack_code(vm);
+	end_phase(vm, phase_pack, vm->arena->allocated - before + vm->bytecode_size, vm->arena->reserved + vm->bytecode_size);
+	
+	return vm;
 }
 
-struct vm * emit_code(struct vm *vm, enum inst_type type, float *args, int num_of_args)
+/* the same, for the register backend; translate_regs takes the place of optimize_code */
+struct vm * compile_regs(char *code, int jobs)
 {
-    vm->num_of_insts++;
-    vm->code = realloc(vm->code, vm->num_of_insts * sizeof(struct inst));
-    vm->code[vm->num_of_insts-1].type = type;
-    vm->code[vm->num_of_insts-1].args = args;
-    vm->code[vm->num_of_insts-1].num_of_args = num_of_args;
-    
-    if(type == label)
-    {
-        vm->label_list = realloc(vm->label_list, vm->num_of_labels * sizeof(int));
-        vm->label_list[vm->num_of_labels-1] = vm->num_of_insts-1;
-    }
-    
-    return vm;
+	struct vm *vm = parse_jobs(code, jobs);
+	
+	if(vm == NULL) return NULL;
+	
+	size_t before = vm->arena->allocated;
+	
+	vm = translate_regs(vm);
+	end_phase(vm, phase_optimize, vm->arena->allocated - before, vm->arena->reserved);
+	
+	before = vm->arena->allocated;
+	
+	vm = link_code(vm);
+	end_phase(vm, phase_link, vm->arena->allocated - before, vm->arena->reserved);
+	
+	before = vm->arena->allocated;
+	
+	vm = pack_code(vm);
+	end_phase(vm, phase_pack, vm->arena->allocated - before + vm->bytecode_size, vm->arena->reserved + vm->bytecode_size);
+	
+	return vm;
 }
 
-struct vm * create_vm(void)
+/*
+	a function as a session last compiled it, already through optimize_code or translate_regs. a
+	label in its code is either its own, counted from 0 past the function's, or -n-1 for the
+	function callees[n], so it holds wherever the function moves to, for as long as its text and
+	the functions it calls stay the same
+*/
+struct cached
 {
-    struct vm *temp_vm = malloc(sizeof(struct vm));
-    
-    temp_vm->code = NULL;
-    temp_vm->num_of_insts = 0;
-    temp_vm->label_list = NULL;
-    
-    temp_vm->stack = create_frstack();
-    
-    return temp_vm;
+	char *text;
+	int len;
+	unsigned int hash;
+	int name;
+	int num_of_args;
+	
+	struct inst *code;
+	int num_of_insts;
+	int *operands; /* the args of all of code, one after another */
+	int num_of_operands;
+	struct bignum **consts;
+	int num_of_consts;
+	int num_of_labels;
+	struct function func;
+	
+	int *callees; /* symbols, and the number of arguments each had when it was called */
+	int *callee_args;
+	int num_of_callees;
+	
+	int build; /* the last one it was part of */
+};
+
+/*
+	what -repl keeps between compiles. each time, the source is split at its top level parens and
+	every function whose text is in the cache is taken from there; only the rest are lexed, parsed
+	and optimized, then the whole program is laid out again from the cached code and linked
+*/
+struct session
+{
+	int registers;
+	
+	struct cached **table; /* open addressing on hash, NULL for empty */
+	int table_size;
+	
+	int build;
+	int num_of_compiled; /* in the last build */
+	
+	/* the functions of the last build that got as far as running, in order */
+	int *names;
+	int *args;
+	int num_of_funcs;
+};
+
+struct session * create_session(int registers)
+{
+	struct session *temp = malloc(sizeof(struct session));
+	
+	temp->registers = registers;
+	temp->table = NULL;
+	temp->table_size = 0;
+	temp->build = 0;
+	temp->num_of_compiled = 0;
+	temp->names = NULL;
+	temp->args = NULL;
+	temp->num_of_funcs = 0;
+	
+	return temp;
 }
 
-void print_code(struct vm *vm)
+void free_cached(struct cached *cached)
 {
-    int i;
-    for(i = 0; i<vm->num_of_insts; i++)
-    {
-        printf("(");
-        
-        switch(vm->code[i].type)
-        {
-            case label:     printf("label");     break;
-            case decl:      printf("decl");      break;
-            case push_adr:  printf("push_adr");  break;
-            case push_loc:  printf("push_loc");  break;
-            case push_val:  printf("push_val");  break;
-            case pop:       printf("pop");       break;
-            case print:     printf("print");     break;
-            case jmpf:      printf("jmpf");      break;
-            case jmp:       printf("jmp");       break;
-            case call:      printf("call");      break;
-            case param:     printf("param");     break;
-            case ret_val:   printf("ret_val");   break;
-            case ret_none:  printf("ret_none");  break;
-            case set_equal: printf("set_equal"); break;
-            case less_than: printf("less_than"); break;
-            case more_than: printf("more_than"); break;
-            case plus:      printf("plus");      break;
-            case minus:     printf("minus");     break;
-            case multiply:  printf("multiply");  break;
-            case divide:    printf("divide");    break;
-            case and:       printf("and");       break;
-            case or:        printf("or");        break;
-        }
-        
-        int j;
-        for(j = 0; j<vm->code[i].num_of_args; j++)
-        {
-            if(j == 0) printf(" %f", vm->code[i].args[j]);
-            if(j > 0)  printf(", %f", vm->code[i].args[j]);
-        }
-        
-        printf(")\n");
-    }
+	int i;
+	for(i = 0; i<cached->num_of_consts; i++) val_release(cached->consts[i]);
+	
+	free(cached->text);
+	free(cached->code);
+	free(cached->operands);
+	free(cached->consts);
+	free(cached->callees);
+	free(cached->callee_args);
+	free(cached);
 }
 
-struct parser
+void free_session(struct session *session)
 {
-	char *code;
-	int begin;
-	struct token *tk_list;
-	struct token *current_tk;
-	int list_size;
+	int i;
+	for(i = 0; i<session->table_size; i++) if(session->table[i] != NULL) free_cached(session->table[i]);
 	
-	int panic;
-	int syntax_error; /* used to supress semantic errors if a syntax error occurs */
-	int had_error;
+	free(session->table);
+	free(session->names);
+	free(session->args);
+	free(session);
+}
+
+struct cached * find_cached(struct session *session, char *text, int len, unsigned int hash)
+{
+	if(session->table_size == 0) return NULL;
 	
-	struct node *current_tb;
-	float rel_addr;
+	unsigned int h = hash & (session->table_size - 1);
 	
-	struct vm *vm;
-}; 
+	while(session->table[h] != NULL)
+	{
+		struct cached *cached = session->table[h];
+		
+		if(cached->hash == hash && cached->len == len && memcmp(cached->text, text, len) == 0) return cached;
+		
+		h = (h + 1) & (session->table_size - 1);
+	}
+	
+	return NULL;
+}
+
+/* the table again with only the functions of the last build, the rest are freed */
+void sweep_session(struct session *session, struct cached **funcs, int num_of_funcs)
+{
+	int i;
+	for(i = 0; i<session->table_size; i++)
+	{
+		if(session->table[i] != NULL && session->table[i]->build != session->build) free_cached(session->table[i]);
+	}
+	
+	free(session->table);
+	
+	session->table_size = 16;
+	while(session->table_size < 2 * num_of_funcs) session->table_size *= 2;
+	
+	session->table = calloc(session->table_size, sizeof(struct cached *));
+	
+	for(i = 0; i<num_of_funcs; i++)
+	{
+		unsigned int h = funcs[i]->hash & (session->table_size - 1);
+		
+		while(session->table[h] != NULL) h = (h + 1) & (session->table_size - 1);
+		
+		session->table[h] = funcs[i];
+	}
+}
+
+/* takes the function parse_unit put in vm, lowered, out of it and into the cache */
+struct cached * cache_unit(struct vm *vm, struct unit *units, int num_of_units, int k, char *text, int len, unsigned int hash)
+{
+	struct cached *cached = malloc(sizeof(struct cached));
+	
+	cached->text = malloc(len);
+	memcpy(cached->text, text, len);
+	cached->len = len;
+	cached->hash = hash;
+	cached->name = units[k].name;
+	cached->num_of_args = units[k].num_of_args;
+	
+	cached->num_of_insts = vm->num_of_insts;
+	cached->code = malloc(vm->num_of_insts * sizeof(struct inst));
+	
+	int i, j;
+	cached->num_of_operands = 0;
+	for(i = 0; i<vm->num_of_insts; i++) cached->num_of_operands += vm->code[i].num_of_args;
+	cached->operands = malloc(cached->num_of_operands * sizeof(int) + 1);
+	
+	cached->callees = NULL;
+	cached->callee_args = NULL;
+	cached->num_of_callees = 0;
+	
+	int *args = cached->operands;
+	for(i = 0; i<vm->num_of_insts; i++)
+	{
+		struct inst *inst = &cached->code[i];
+		*inst = vm->code[i];
+		
+		if(inst->num_of_args == 0)
+		{
+			inst->args = NULL;
+			continue;
+		}
+		
+		memcpy(args, vm->code[i].args, inst->num_of_args * sizeof(int));
+		inst->args = args;
+		args += inst->num_of_args;
+		
+		if(inst->type != label && !is_branch(inst->type)) continue;
+		
+		int n = inst->args[0];
+		
+		if(n >= num_of_units)
+		{
+			inst->args[0] = n - num_of_units;
+			continue;
+		}
+		
+		for(j = 0; j<cached->num_of_callees; j++) if(cached->callees[j] == units[n].name) break;
+		
+		if(j == cached->num_of_callees)
+		{
+			cached->num_of_callees++;
+			cached->callees = realloc(cached->callees, cached->num_of_callees * sizeof(int));
+			cached->callee_args = realloc(cached->callee_args, cached->num_of_callees * sizeof(int));
+			cached->callees[j] = units[n].name;
+			cached->callee_args[j] = units[n].num_of_args;
+		}
+		
+		inst->args[0] = -j-1;
+	}
+	
+	/* the references go with the function */
+	cached->consts = vm->consts;
+	cached->num_of_consts = vm->num_of_consts;
+	vm->consts = NULL;
+	vm->num_of_consts = 0;
+	vm->consts_size = 0;
+	
+	cached->num_of_labels = vm->num_of_labels - num_of_units;
+	cached->func = vm->funcs[vm->num_of_funcs-1];
+	cached->func.name = cached->name;
+	cached->build = 0;
+	
+	return cached;
+}
 
-void error(struct parser *parser, char *msg)
+/* appends the tokens of code from begin up to end */
+struct lexed * lex_span(char *code, int begin, int end, struct lexed *tokens, int *num_of_tokens, int *tokens_size)
 {
-	if(parser->panic) return;
+	while(begin < end)
+	{
+		if(*num_of_tokens == *tokens_size)
+		{
+			*tokens_size = *tokens_size * 2 + 1024;
+			tokens = realloc(tokens, *tokens_size * sizeof(struct lexed));
+		}
+		
+		struct token tk = next_token(code, &begin);
+		tokens[*num_of_tokens].type = tk.type;
+		tokens[*num_of_tokens].sym = tk.sym;
+		(*num_of_tokens)++;
+	}
 	
-	printf("ERROR: %s\n", msg);
-	parser->panic = 1;
-	parser->syntax_error = 1;
-	parser->had_error = 1;
+	return tokens;
 }
 
-void expect_lex(struct parser *parser, char *str)
+/* whether every function a cached one calls is still declared before it, with the same number of arguments */
+int callees_hold(struct cached *cached, struct node *globals, int k)
 {
-	if(strcmp(parser->current_tk->lex, str) != 0)
+	int i;
+	for(i = 0; i<cached->num_of_callees; i++)
 	{
-		error(parser, "expected different lexeme!");
+		int e = find_entry(globals, cached->callees[i], func_type);
+		
+		if(e == -1 || globals->entry[e].rel_addr > k || globals->entry[e].num_of_args != cached->callee_args[i]) return 0;
 	}
 	
-	if(!parser->panic) parser->current_tk++; /* advance input if not panicking */
+	return 1;
 }
 
-void expect_type(struct parser *parser, enum tk_type type)
+/* moves the constant operands of inst along by base, for a function whose constants no longer start at 0 */
+void rebase_consts(struct inst *inst, int base)
 {
-	if(parser->current_tk->type != type)
+	int j;
+	
+	if(inst->type >= r_move && inst->type <= r_jmpf_more)
 	{
-		error(parser, "expected different token type!");
+		for(j = is_branch(inst->type) ? 1 : 0; j<inst->num_of_args; j++) if(inst->args[j] < 0) inst->args[j] -= base;
+		return;
 	}
 	
-	if(!parser->panic) parser->current_tk++; /* advance input if not panicking */
+	switch(inst->type)
+	{
+		case push_val: inst->args[0] += base; break;
+		case store_val: case add_loc_val: inst->args[1] += base; break;
+		case jmpf_less_loc_val: case jmpf_more_loc_val: inst->args[2] += base; break;
+		default: break;
+	}
 }
 
-void parser_and(struct parser *parser); /* forward declaration for funcparens and val */
-
-int funcparens(struct parser *parser)
+/*
+	compiles code into a vm that is ready to run, reusing whatever functions the session has
+	compiled before, NULL if there were any errors. anything that doesn't split into functions,
+	or fails in one, goes to compile or compile_regs, which prints the errors
+*/
+struct vm * session_compile(struct session *session, char *code)
 {
-	int args = 0;
+	session->build++;
 	
-	expect_lex(parser, "(");
+	struct unit *units = NULL;
+	struct cached **funcs = NULL;
+	int *spans = NULL; /* where each function starts in code and its length */
+	unsigned int *hashes = NULL;
+	int num_of_units = 0, units_size = 0;
 	
-	if(parser->current_tk->type == id  || 
-	   parser->current_tk->type == num ||
-	   parser->current_tk->type == uint)
+	struct lexed *tokens = NULL;
+	int num_of_tokens = 0, tokens_size = 0;
+	
+	quiet = 1;
+	quiet_errors = 0;
+	
+	lex_reset();
+	
+	int at = 0, clean = 1;
+	for(;;)
 	{
-		parser_and(parser);
+		at = span_space(code, at);
 		
-		/* change later !!!  */
-		if(!parser->had_error) parser->vm = emit_code(parser->vm, param, NULL, 0);
-		/* change later !!!  */
+		if(code[at] == '\0') break;
 		
-		args++;
+		/* from paren to paren, strcspn skips what is in between faster than a loop would */
+		int depth = 0, end = at;
+		while(code[end] != '\0')
+		{
+			if(code[end] == '(') depth++;
+			if(code[end] == ')' && --depth == 0) break;
+			end++;
+			end += strcspn(code + end, "()");
+		}
 		
-		while(strcmp(parser->current_tk->lex, ",") == 0)
+		if(code[at] != '(' || code[end] == '\0')
 		{
-			if(parser->panic) break;
-			
-			expect_lex(parser, ",");
-			parser_and(parser);
-				
-			if(!parser->had_error) parser->vm = emit_code(parser->vm, param, NULL, 0);
+			clean = 0;
+			break;
+		}
+		
+		end++;
+		
+		if(num_of_units == units_size)
+		{
+			units_size = units_size * 2 + 256;
+			units = realloc(units, units_size * sizeof(struct unit));
+			funcs = realloc(funcs, units_size * sizeof(struct cached *));
+			spans = realloc(spans, 2 * units_size * sizeof(int));
+			hashes = realloc(hashes, units_size * sizeof(unsigned int));
+		}
+		
+		int k = num_of_units;
+		num_of_units++;
+		
+		spans[2*k] = at;
+		spans[2*k+1] = end - at;
+		hashes[k] = hash_str(code + at, end - at);
+		funcs[k] = find_cached(session, code + at, end - at, hashes[k]);
+		
+		struct unit *unit = &units[k];
+		unit->vm = NULL;
+		unit->failed = 0;
+		unit->first = unit->end = 0;
+		
+		if(funcs[k] != NULL)
+		{
+			unit->name = funcs[k]->name;
+			unit->num_of_args = funcs[k]->num_of_args;
 			
-			args++;
+			at = end;
+			continue;
+		}
+		
+		/* a new function, or one that has changed */
+		unit->first = num_of_tokens;
+		tokens = lex_span(code, at, end, tokens, &num_of_tokens, &tokens_size);
+		unit->end = num_of_tokens;
+		
+		if(unit->end - unit->first < 2 || tokens[unit->first+1].type != id)
+		{
+			clean = 0;
+			break;
 		}
+		
+		unit->name = tokens[unit->first+1].sym;
+		unit->num_of_args = 0;
+		
+		int j;
+		for(j = unit->first + 2; j<unit->end && (tokens[j].type == id || tokens[j].type == tk_comma); j++) if(tokens[j].type == id) unit->num_of_args++;
+		
+		at = end;
 	}
 	
-	expect_lex(parser, ")");
+	if(num_of_units == 0) clean = 0;
 	
-	return args;
-}
-
-void val(struct parser *parser)
-{	
-	struct entry *entry;
-
-	if(parser->current_tk->type == id)
+	struct arena *arena = create_arena();
+	struct node *globals = push_tb(arena, NULL);
+	
+	int k;
+	for(k = 0; clean && k<num_of_units; k++)
 	{
-		char *temp_lex = parser->current_tk->lex;
-		enum type temp_type = var_type;
+		globals = create_entry(arena, globals, k, units[k].name, func_type);
+		globals->entry[globals->num_of_entries-1].num_of_args = units[k].num_of_args;
+	}
+	
+	/* a lexing error or a redeclared function */
+	if(quiet_errors > 0) clean = 0;
+	
+	/* with the same functions as last time in the same order, whatever was cached still holds */
+	int same = num_of_units == session->num_of_funcs;
+	for(k = 0; same && k<num_of_units; k++) same = units[k].name == session->names[k] && units[k].num_of_args == session->args[k];
+	
+	/* otherwise the ones that call something that has gone, moved below them or changed its arguments are compiled again too */
+	for(k = 0; clean && !same && k<num_of_units; k++)
+	{
+		if(funcs[k] == NULL || callees_hold(funcs[k], globals, k)) continue;
 		
-		expect_type(parser, id);
+		units[k].first = num_of_tokens;
+		tokens = lex_span(code, spans[2*k], spans[2*k] + spans[2*k+1], tokens, &num_of_tokens, &tokens_size);
+		units[k].end = num_of_tokens;
+		
+		funcs[k] = NULL;
+	}
+	
+	struct parser *parser = malloc(sizeof(struct parser));
+	parser->code = NULL;
+	parser->arena = arena;
+	
+	session->num_of_compiled = 0;
+	
+	/* each function is parsed and lowered on its own in here, then taken out of it by cache_unit */
+	parser->vm = create_vm();
+	
+	for(k = 0; clean && k<num_of_units; k++)
+	{
+		if(funcs[k] != NULL) continue;
 		
-		if(strcmp(parser->current_tk->lex, "(") == 0)
+		parser->vm->num_of_insts = 0;
+		parser->vm->num_of_funcs = 0;
+		parser->vm->num_of_labels = num_of_units;
+		parser->vm->depth = 0;
+		parser->vm->max_depth = 0;
+		
+		parse_unit(parser, units, k, tokens, globals);
+		
+		if(units[k].failed)
 		{
-			if(!parser->syntax_error)
+			clean = 0;
+			break;
+		}
+		
+		parser->vm = session->registers ? translate_regs(parser->vm) : optimize_code(parser->vm);
+		
+		funcs[k] = cache_unit(parser->vm, units, num_of_units, k, code + spans[2*k], spans[2*k+1], hashes[k]);
+		session->num_of_compiled++;
+	}
+	
+	quiet = 0;
+	
+	free_vm(parser->vm);
+	free(parser);
+	
+	struct vm *vm = NULL;
+	
+	if(clean)
+	{
+		int main_sym = intern("main", 4);
+		
+		vm = create_vm();
+		
+		/* laid out in source order, the labels of each numbered on from those before it as parse would have */
+		int *label_of = malloc(num_of_units * sizeof(int));
+		int labels = 0;
+		
+		int *callee_label = NULL; /* of the function being laid out */
+		int callees_size = 0;
+		
+		for(k = 0; k<num_of_units; k++)
+		{
+			funcs[k]->build = session->build;
+			
+			label_of[k] = labels;
+			labels += 1 + funcs[k]->num_of_labels;
+			vm->code_size += funcs[k]->num_of_insts;
+		}
+		
+		vm->code = arena_alloc(vm->arena, vm->code_size * sizeof(struct inst));
+		vm->funcs = malloc(num_of_units * sizeof(struct function));
+		vm->funcs_size = num_of_units;
+		vm->num_of_labels = labels;
+		
+		for(k = 0; k<num_of_units; k++)
+		{
+			struct cached *cached = funcs[k];
+			
+			int i, base = vm->num_of_consts;
+			for(i = 0; i<cached->num_of_consts; i++) vm = add_const(vm, val_retain(cached->consts[i]));
+			
+			int *args = arena_alloc(vm->arena, cached->num_of_operands * sizeof(int) + 1);
+			memcpy(args, cached->operands, cached->num_of_operands * sizeof(int));
+			
+			if(cached->num_of_callees > callees_size)
+			{
+				callees_size = cached->num_of_callees;
+				callee_label = realloc(callee_label, callees_size * sizeof(int));
+			}
+			
+			for(i = 0; i<cached->num_of_callees; i++)
+			{
+				int e = find_entry(globals, cached->callees[i], func_type);
+				callee_label[i] = label_of[globals->entry[e].rel_addr];
+			}
+			
+			for(i = 0; i<cached->num_of_insts; i++)
 			{
-				entry = search_entry(parser->current_tb, temp_lex, func_type);
+				struct inst *inst = &vm->code[vm->num_of_insts];
+				*inst = cached->code[i];
+				vm->num_of_insts++;
 				
-				int args = funcparens(parser);
+				if(inst->num_of_args == 0) continue;
 				
-				if(entry == NULL) parser->had_error = 1;
+				inst->args = args + (cached->code[i].args - cached->operands);
 				
-				if(entry->num_of_args != args)
+				if(inst->type == label || is_branch(inst->type))
 				{
-					printf("ERROR: incorrect number of arguments!\n");
-					parser->had_error = 1;
+					int n = inst->args[0];
+					
+					inst->args[0] = n < 0 ? callee_label[-n-1] : label_of[k] + 1 + n;
 				}
+				
+				if(base != 0) rebase_consts(inst, base);
 			}
 			
-			if(!parser->had_error)
-			{
-				float *args = create_args(1, entry->rel_addr);
-				parser->vm = emit_code(parser->vm, call, args, 1);
-			}
-		} else
+			vm->funcs[k] = cached->func;
+			vm->funcs[k].label = label_of[k];
+			vm->num_of_funcs++;
+			
+			if(cached->name == main_sym) vm->main = k;
+		}
+		
+		free(label_of);
+		free(callee_label);
+		
+		vm->registers = session->registers;
+		vm = link_code(vm);
+		vm = pack_code(vm);
+		
+		/* when nothing was compiled the table has just these functions in it already */
+		if(!same || session->num_of_compiled > 0)
 		{
-			if(!parser->syntax_error)
+			session->names = realloc(session->names, num_of_units * sizeof(int));
+			session->args = realloc(session->args, num_of_units * sizeof(int));
+			for(k = 0; k<num_of_units; k++)
 			{
-				entry = search_entry(parser->current_tb, temp_lex, temp_type);
-				
-				if(entry == NULL) parser->had_error = 1;
+				session->names[k] = units[k].name;
+				session->args[k] = units[k].num_of_args;
 			}
+			session->num_of_funcs = num_of_units;
 			
-			if(!parser->had_error)
-			{
-				float *args = create_args(1, entry->rel_addr);
-				parser->vm = emit_code(parser->vm, push_loc, args, 1);
-			}
-		}
-	} else if(parser->current_tk->type == num ||
-			  parser->current_tk->type == uint)
-	{
-		if(!parser->had_error)
-		{
-			float *args = create_args(1, atof(parser->current_tk->lex));
-			parser->vm = emit_code(parser->vm, push_val, args, 1);
+			sweep_session(session, funcs, num_of_units);
 		}
-		expect_type(parser, parser->current_tk->type);
-	} else if(strcmp(parser->current_tk->lex, "(") == 0)
-	{
-		expect_lex(parser, "(");
-		parser_and(parser);
-		expect_lex(parser, ")");
 	} else
 	{
-		error(parser, "bad value.");
+		/* what this build compiled never made it into the table */
+		for(k = 0; k<num_of_units; k++) if(funcs[k] != NULL && funcs[k]->build == 0) free_cached(funcs[k]);
 	}
-}
-
-void term(struct parser *parser)
-{
-	val(parser);
 	
-	while(strcmp(parser->current_tk->lex, "*") == 0 ||
-	      strcmp(parser->current_tk->lex, "/") == 0)
+	arena_free(arena);
+	free(tokens);
+	free(spans);
+	free(hashes);
+	free(funcs);
+	free(units);
+	
+	if(!clean)
 	{
-		if(parser->panic) break;
-		
-		char *temp = parser->current_tk->lex;
-		
-		expect_lex(parser, parser->current_tk->lex);
-		val(parser);
-		
-		if(!parser->had_error)
-		{
-			if(strcmp(temp, "*") == 0) parser->vm = emit_code(parser->vm, multiply, NULL, 0);
-			if(strcmp(temp, "/") == 0) parser->vm = emit_code(parser->vm, divide, NULL, 0);
-		}
+		vm = session->registers ? compile_regs(code, 1) : compile(code, 1);
+		session->num_of_compiled = vm != NULL ? vm->num_of_funcs : 0;
 	}
+	
+	return vm;
 }
 
-void expr(struct parser *parser)
+void print_mem(struct vm *vm)
 {
-	term(parser);
+	printf("%-6s %12s %12s\n", "phase", "allocated", "peak");
 	
-	while(strcmp(parser->current_tk->lex, "+") == 0 ||
-	      strcmp(parser->current_tk->lex, "-") == 0)
-	{
-		if(parser->panic) break;
-		
-		char *temp = parser->current_tk->lex;
-		
-		expect_lex(parser, parser->current_tk->lex);
-		term(parser);
-		
-		if(!parser->had_error)
-		{
-			if(strcmp(temp, "+") == 0) parser->vm = emit_code(parser->vm, plus, NULL, 0);
-			if(strcmp(temp, "-") == 0) parser->vm = emit_code(parser->vm, minus, NULL, 0);
-		}
-	}
+	int i;
+	for(i = 0; i<num_of_phases; i++) printf("%-6s %12lu %12lu\n", phase_names[i], (unsigned long)vm->mem[i].allocated, (unsigned long)vm->mem[i].peak);
 }
 
-void rel(struct parser *parser)
+/*
+	a source file as one string ending in '\0', which is what the lexer expects. it is mapped
+	rather than read, and the zeros the system fills the rest of the last page with end it;
+	only when the file ends exactly on a page boundary is there no room for that, so then it is
+	read into memory instead, as are pipes and devices, which can't be mapped
+*/
+struct source
 {
-	expr(parser);
+	char *code;
+	size_t size;
+	int mapped;
+};
+
+/* a saved program doesn't need the '\0', so it is opened with terminated 0 and mapped unless it's piped */
+struct source * open_source(char *path, int terminated)
+{
+	struct source *temp = malloc(sizeof(struct source));
+	temp->code = NULL;
+	temp->size = 0;
+	temp->mapped = 0;
+	
+#ifndef _WIN32
+	int fd = open(path, O_RDONLY);
+	struct stat st;
 	
-	while(strcmp(parser->current_tk->lex, "<") == 0 ||
-	      strcmp(parser->current_tk->lex, ">") == 0)
+	if(fd == -1 || fstat(fd, &st) == -1)
 	{
-		if(parser->panic) break;
-		
-		char *temp = parser->current_tk->lex;
-		
-		expect_lex(parser, parser->current_tk->lex);
-		expr(parser);
-		
-		if(!parser->had_error)
-		{
-			if(strcmp(temp, "<") == 0) parser->vm = emit_code(parser->vm, less_than, NULL, 0);
-			if(strcmp(temp, ">") == 0) parser->vm = emit_code(parser->vm, more_than, NULL, 0);
-		}
+		printf("ERROR! unable to open '%s'!\n", path);
+		exit(-1);
 	}
-}
-
-void parser_or(struct parser *parser)
-{
-	rel(parser);
 	
-	while(strcmp(parser->current_tk->lex, "or") == 0)
+	if(S_ISDIR(st.st_mode))
 	{
-		if(parser->panic) break;
-		
-		expect_lex(parser, "or");
-		rel(parser);
-		
-		if(!parser->had_error) parser->vm = emit_code(parser->vm, or, NULL, 0);
+		printf("ERROR! '%s' is a directory!\n", path);
+		exit(-1);
 	}
-} 
-
-void parser_and(struct parser *parser)
-{
-	parser_or(parser);
 	
-	while(strcmp(parser->current_tk->lex, "and") == 0)
+	temp->size = st.st_size;
+	
+	/* pipes and devices have no size to map, they are read below until they end */
+	if(S_ISREG(st.st_mode) && (!terminated || temp->size % sysconf(_SC_PAGESIZE) != 0))
 	{
-		if(parser->panic) break;
-		
-		expect_lex(parser, "and");
-		parser_or(parser);
+		void *map = mmap(NULL, temp->size, PROT_READ, MAP_PRIVATE, fd, 0);
 		
-		if(!parser->had_error) parser->vm = emit_code(parser->vm, and, NULL, 0);
+		if(map != MAP_FAILED)
+		{
+			temp->code = map;
+			temp->mapped = 1;
+		}
 	}
-} 
-
-void body(struct parser *parser); /* forward declaration of body for flow */
-
-void flow(struct parser *parser)
-{	
-	char *temp = parser->current_tk->lex;
-
-	expect_lex(parser, parser->current_tk->lex); /* previous function says it has to be "if" or "while" */
 	
-	if(!parser->syntax_error) parser->current_tb = push_tb(parser->current_tb);
+	close(fd);
 	
-	expect_lex(parser, "(");
+	if(temp->mapped) return temp;
+#endif
 	
-	float temp_label = parser->vm->num_of_labels;
+	FILE *file = fopen(path, "rb");
 	
-	if(strcmp("if", temp) == 0)
+	if(file == NULL)
 	{
-		parser_and(parser);
-		if(!parser->had_error)
-		{
-			float *args = create_args(1, temp_label);
-			parser->vm = emit_code(parser->vm, jmpf, args, 1);
-			parser->vm->num_of_labels++;
-		}
-	} else if(strcmp("while", temp) == 0)
+		printf("ERROR! unable to open '%s'!\n", path);
+		exit(-1);
+	}
+	
+	/* read in chunks rather than asking for the size first, which a pipe doesn't have */
+	size_t cap = 4096;
+	temp->code = malloc(cap + 1);
+	temp->size = 0;
+	
+	size_t got;
+	while((got = fread(temp->code + temp->size, 1, cap - temp->size, file)) > 0)
 	{
-		if(!parser->had_error)
-		{
-			float *args = create_args(1, temp_label);
-			parser->vm = emit_code(parser->vm, label, args, 1);
-		}
+		temp->size += got;
 		
-		parser_and(parser);
-		
-		if(!parser->had_error)
+		if(temp->size == cap)
 		{
-			float *args = create_args(1, temp_label+1);
-			parser->vm = emit_code(parser->vm, jmpf, args, 1);
-			parser->vm->num_of_labels += 2;
+			cap *= 2;
+			temp->code = realloc(temp->code, cap + 1);
 		}
 	}
 	
-	expect_lex(parser, "->");
+	if(ferror(file))
+	{
+		printf("ERROR! unable to read '%s'!\n", path);
+		exit(-1);
+	}
 	
-	body(parser);
+	temp->code[temp->size] = '\0';
 	
-	if(strcmp("if", temp) == 0)
-	{
-		if(!parser->had_error)
-		{
-			float *args = create_args(1, temp_label);
-			parser->vm = emit_code(parser->vm, label, args, 1);
-		}
-	} else if(strcmp("while", temp) == 0)
-	{
-		if(!parser->had_error)
-		{
-			float *args1 = create_args(1, temp_label);
-			parser->vm = emit_code(parser->vm, jmp, args1, 1);
-			
-			float *args2 = create_args(1, temp_label+1);
-			parser->vm = emit_code(parser->vm, label, args2, 1);
-		}
+	fclose(file);
+	
+	return temp;
+}
+
+void close_source(struct source *source)
+{
+#ifndef _WIN32
+	if(source->mapped)
+	{
+		munmap(source->code, source->size);
+		free(source);
+		
+		return;
 	}
+#endif
 	
-	expect_lex(parser, ")");
+	free(source->code);
+	free(source);
+}
+
+double seconds(void)
+{
+#ifndef _WIN32
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
 	
-	if(!parser->syntax_error) parser->current_tb = pop_tb(parser->current_tb);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+#else
+	return (double)clock() / CLOCKS_PER_SEC;
+#endif
 }
 
-void parser_return(struct parser *parser)
+/* peak resident set in KB, 0 where it can't be asked for */
+long peak_rss(void)
 {
-	expect_lex(parser, "ret");
-	parser_and(parser);
-	expect_lex(parser, ";");
+#ifndef _WIN32
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
 	
-	if(!parser->had_error) parser->vm = emit_code(parser->vm, ret_val, NULL, 0);
+	return usage.ru_maxrss;
+#else
+	return 0;
+#endif
 }
 
-void parser_print(struct parser *parser)
+/*
+	compiled programs saved by save_code and run by load_code without parsing them again. every
+	jump and call in the bytecode is already a byte offset from its start, so the bytecode is
+	used straight out of the mapped file. the file is
+
+		struct image_header
+		struct function      funcs[num_of_funcs]
+		constants            sign, size and limbs of each, as ints and uint32_ts
+		bytecode             bytecode_size bytes, ending in halt
+
+	in the byte order and int size of the machine that wrote it, which endian checks
+*/
+#define IMAGE_MAGIC "BNLC"
+#define IMAGE_VERSION 6
+
+struct image_header
 {
-	struct entry *entry;
+	char magic[4];
+	int version;
+	int endian; /* 0x01020304 as written */
+	int num_of_inst_types; /* the opcodes have to mean the same thing as when it was written */
+	int registers;
+	int main;
+	int num_of_funcs;
+	int num_of_consts;
+	int consts_size; /* bytes */
+	int bytecode_size;
+};
+
+/*
+	whether path is a saved program rather than source, from the first bytes of it. only regular
+	files are looked at, reading the start of a pipe would take it away from the source
+*/
+int is_image(char *path)
+{
+	char magic[4];
 	
-	expect_lex(parser, "print");
+#ifndef _WIN32
+	struct stat st;
+	if(stat(path, &st) == -1 || !S_ISREG(st.st_mode)) return 0;
+#endif
 	
-	if(!parser->syntax_error)
+	FILE *file = fopen(path, "rb");
+	
+	if(file == NULL) return 0;
+	
+	int found = fread(magic, 1, 4, file) == 4 && memcmp(magic, IMAGE_MAGIC, 4) == 0;
+	fclose(file);
+	
+	return found;
+}
+
+/* writes a compiled vm to path, -1 if it can't */
+int save_code(struct vm *vm, char *path)
+{
+	struct image_header header;
+	memcpy(header.magic, IMAGE_MAGIC, 4);
+	header.version = IMAGE_VERSION;
+	header.endian = 0x01020304;
+	header.num_of_inst_types = num_of_inst_types;
+	header.registers = vm->registers;
+	header.main = vm->main;
+	header.num_of_funcs = vm->num_of_funcs;
+	header.num_of_consts = vm->num_of_consts;
+	header.consts_size = 0;
+	header.bytecode_size = vm->bytecode_size;
+	
+	int i;
+	for(i = 0; i<vm->num_of_consts; i++)
 	{
-		entry = search_entry(parser->current_tb, parser->current_tk->lex, var_type);
-		
-		if(entry == NULL) parser->had_error = 1;
+		struct bignum *n = val_box(vm->consts[i]); /* small values are written out as bignums */
+		header.consts_size += 2 * sizeof(int) + n->size * sizeof(uint32_t);
+		bn_release(n);
 	}
 	
-	if(!parser->had_error)
+	FILE *file = fopen(path, "wb");
+	
+	if(file == NULL)
 	{
-		float *args = create_args(1, entry->rel_addr);
-		parser->vm = emit_code(parser->vm, push_val, args, 1);
+		printf("ERROR! unable to write '%s'!\n", path);
+		return -1;
 	}
 	
-	expect_type(parser, id);
+	fwrite(&header, sizeof(header), 1, file);
+	fwrite(vm->funcs, sizeof(struct function), vm->num_of_funcs, file);
+	
+	for(i = 0; i<vm->num_of_consts; i++)
+	{
+		struct bignum *n = val_box(vm->consts[i]);
+		fwrite(&n->sign, sizeof(int), 1, file);
+		fwrite(&n->size, sizeof(int), 1, file);
+		fwrite(n->limb, sizeof(uint32_t), n->size, file);
+		bn_release(n);
+	}
 	
-	if(!parser->had_error) parser->vm = emit_code(parser->vm, print, NULL, 0);
+	fwrite(vm->bytecode, 1, vm->bytecode_size, file);
+	
+	if(fclose(file) != 0)
+	{
+		printf("ERROR! unable to write '%s'!\n", path);
+		return -1;
+	}
 	
-	expect_lex(parser, ";");
+	return 0;
 }
 
-void next(struct parser *parser)
+/*
+	whether bytecode out of a file can be run without reading or writing outside of what it
+	was given: every opcode is one the backend it was saved for runs and its operands are all
+	there, it ends in halt, jumps land on instructions and calls on functions, and local,
+	register and constant operands are within their function's frame and the constants. each
+	function's record has to match its enter instruction, and its frame has to be the one its code
+	needs, as pack_code sized it: no more locals than its arguments or the code names, and the
+	operand stack frame_depth works out. that is what keeps a damaged count from becoming a huge
+	allocation, or an operand stack too small for what is pushed on it. prints what is wrong and
+	returns -1 if anything is
+*/
+int check_code(unsigned char *code, int size, struct function *funcs, int num_of_funcs, int num_of_consts, int registers)
 {
-	struct entry *entry;
+	char *start = calloc(size, 1); /* whether each byte begins an instruction */
+	int pc, i, f = -1;
+	char *wrong = NULL;
 	
-	if(strcmp(parser->current_tk->lex, "=") == 0)
+	for(pc = 0; pc<size && wrong == NULL; pc += 1 + num_of_operands(code[pc]) * sizeof(int))
 	{
-		if(!parser->syntax_error)
-		{
-			entry = search_entry(parser->current_tb, (parser->current_tk-1)->lex, var_type);
-			
-			if(entry == NULL) parser->had_error = 1;
-		}
+		enum inst_type type = code[pc];
+		int ok = registers ? type == enter || (type >= r_move && type <= r_jmpf_more) : type >= enter && type <= tail_call;
 		
-		if(!parser->had_error)
+		if(type == halt) ok = pc == size - 1;
+		
+		if(!ok) wrong = "an instruction that doesn't belong";
+		else if(pc + 1 + num_of_operands(type) * (int)sizeof(int) > size) wrong = "an instruction cut off";
+		else if(pc == 0 && type != enter && type != halt) wrong = "code outside of any function";
+		
+		start[pc] = 1;
+	}
+	
+	if(wrong == NULL && code[size-1] != halt) wrong = "no halt at the end";
+	
+	for(i = 0; i<num_of_funcs && wrong == NULL; i++)
+	{
+		struct function *func = &funcs[i];
+		int at = func->offset;
+		
+		if(at < 0 || at >= size || !start[at] || code[at] != enter) wrong = "a function that doesn't start at an enter";
+		else if(read_int(code + at + 1) != func->num_of_args || read_int(code + at + 1 + sizeof(int)) != func->num_of_locals ||
+		        read_int(code + at + 1 + 2*sizeof(int)) != func->max_depth || read_int(code + at + 1 + 3*sizeof(int)) != i) wrong = "a function that doesn't match its enter";
+		else if(func->num_of_args < 0 || func->num_of_args > func->num_of_locals || func->max_depth < 0 || func->num_of_args > size) wrong = "a function with an impossible frame";
+	}
+	
+	for(pc = 0; pc<size && wrong == NULL; pc += 1 + num_of_operands(code[pc]) * sizeof(int))
+	{
+		enum inst_type type = code[pc];
+		int n = num_of_operands(type);
+		int arg[4];
+		
+		for(i = 0; i<n; i++) arg[i] = read_int(code + pc + 1 + i*sizeof(int));
+		
+		if(type == enter)
 		{
-			float *args = create_args(1, entry->rel_addr);
-			parser->vm = emit_code(parser->vm, push_adr, args, 1);
+			f = arg[3];
+			
+			if(f < 0 || f >= num_of_funcs || funcs[f].offset != pc) wrong = "an enter that isn't a function's";
+			
+			continue;
 		}
 		
-		expect_lex(parser, "=");
-		parser_and(parser);
+		if(type == halt) continue;
 		
-		if(!parser->had_error) parser->vm = emit_code(parser->vm, set_equal, NULL, 0);
+		int locals = funcs[f].num_of_locals;
+		int regs = locals + funcs[f].max_depth;
 		
-		expect_lex(parser, ";");
-	} else if(strcmp(parser->current_tk->lex, "(") == 0)
-	{
-		if(!parser->syntax_error)
+		if(is_branch(type))
 		{
-			entry = search_entry(parser->current_tb, (parser->current_tk-1)->lex, func_type);
+			int target = arg[0];
+			int is_call = type == call || type == tail_call || type == r_call || type == r_tail_call;
 			
-			int args = funcparens(parser);
+			if(target < 0 || target >= size || !start[target] || (is_call != (code[target] == enter))) wrong = "a jump or call to the middle of nowhere";
+		}
+		
+		switch(type)
+		{
+			case push_adr:
+			case push_loc:
+			case store: if(arg[0] < 0 || arg[0] >= locals) wrong = "a local out of its frame"; break;
+			case push_val: if(arg[0] < 0 || arg[0] >= num_of_consts) wrong = "a constant that isn't there"; break;
+			case print: if(arg[0] < 0) wrong = "negative digits"; break;
+			case store_loc: if(arg[0] < 0 || arg[0] >= locals || arg[1] < 0 || arg[1] >= locals) wrong = "a local out of its frame"; break;
 			
-			if(entry == NULL) parser->had_error = 1;
+			case store_val:
+			case add_loc_val:
+				if(arg[0] < 0 || arg[0] >= locals) wrong = "a local out of its frame";
+				else if(arg[1] < 0 || arg[1] >= num_of_consts) wrong = "a constant that isn't there";
+			break;
 			
-			if(entry->num_of_args != args)
-			{
-				printf("ERROR: incorrect number of arguments!\n");
-				parser->had_error = 1;
-			}
+			case jmpf_less_loc_val:
+			case jmpf_more_loc_val:
+				if(arg[1] < 0 || arg[1] >= locals) wrong = "a local out of its frame";
+				else if(arg[2] < 0 || arg[2] >= num_of_consts) wrong = "a constant that isn't there";
+			break;
 			
-			if(!parser->had_error)
-			{
-				float *args = create_args(1, entry->rel_addr);
-				parser->vm = emit_code(parser->vm, call, args, 1);
-			}
+			default:
+				if(type < r_move) break;
+				
+				/* registers or constants, after the label of a branch and before the digits of a print */
+				for(i = is_branch(type) ? 1 : 0; i<(type == r_print ? 1 : n); i++)
+				{
+					if(arg[i] >= regs || (arg[i] < 0 && -(arg[i]+1) >= num_of_consts)) wrong = "a register or constant that isn't there";
+				}
+				
+				/* and what's written has to be a register */
+				if(((type >= r_move && type <= r_or && arg[0] < 0) || (type == r_call && arg[1] < 0))) wrong = "a write to a constant";
+				if(type == r_print && arg[1] < 0) wrong = "negative digits";
+			break;
 		}
+	}
+	
+	/* everything is in place now for following each function through once */
+	for(i = 0; i<num_of_funcs && wrong == NULL; i++)
+	{
+		int named;
+		int depth = frame_depth(code, funcs[i].offset, registers, funcs[i].num_of_locals, &named);
 		
-		expect_lex(parser, ";");
-	} else
+		if(depth == -1) wrong = "an operand stack that goes below empty";
+		else if(depth != funcs[i].max_depth || funcs[i].num_of_locals > (named > funcs[i].num_of_args ? named : funcs[i].num_of_args)) wrong = "a function whose frame doesn't fit its code";
+	}
+	
+	free(start);
+	
+	if(wrong != NULL)
 	{
-		error(parser, "bad operator on id.");
+		printf("ERROR! corrupt bytecode file, it has %s!\n", wrong);
+		return -1;
 	}
+	
+	return 0;
 }
 
-void idstart(struct parser *parser)
-{
-	expect_type(parser, id);
-	next(parser);
-}
-
-void declaration(struct parser *parser)
+/*
+	a vm for a file save_code wrote, NULL if it isn't one this build can run. the vm keeps the
+	source, and its bytecode points into it; only the constants are copied out, since they're
+	reference counted
+*/
+struct vm * load_code(struct source *source)
 {
-	expect_lex(parser, "decl");
+	struct image_header header;
 	
-	if(!parser->syntax_error)
+	if(source->size < sizeof(header))
 	{
-		parser->current_tb = create_entry(parser->current_tb, parser->rel_addr, parser->current_tk->lex, var_type);
-		parser->rel_addr++;
+		printf("ERROR! truncated bytecode file!\n");
+		return NULL;
 	}
 	
-	if(!parser->had_error)
+	memcpy(&header, source->code, sizeof(header));
+	
+	if(memcmp(header.magic, IMAGE_MAGIC, 4) != 0 || header.version != IMAGE_VERSION || header.endian != 0x01020304 || header.num_of_inst_types != num_of_inst_types)
 	{
-		parser->vm = emit_code(parser->vm, decl, NULL, 0);
-		
-		float *args = create_args(1, parser->rel_addr-1);
-		parser->vm = emit_code(parser->vm, push_adr, args, 1);
+		printf("ERROR! bytecode file is from a different version or machine, compile it again!\n");
+		return NULL;
 	}
 	
-	expect_type(parser, id);
-	expect_lex(parser, "=");
-	parser_and(parser);
-	
-	if(!parser->had_error) parser->vm = emit_code(parser->vm, set_equal, NULL, 0);
+	size_t funcs_at = sizeof(header);
+	size_t consts_at = funcs_at + (size_t)header.num_of_funcs * sizeof(struct function);
+	size_t bytecode_at = consts_at + header.consts_size;
 	
-	expect_lex(parser, ";");
-}
-
-void statement(struct parser *parser)
-{
-	if(strcmp(parser->current_tk->lex, "decl") == 0)
-	{
-		declaration(parser);
-	} else if(parser->current_tk->type == id)
-	{
-		idstart(parser); /* statements that start with an id */
-	} else if(strcmp(parser->current_tk->lex, "print") == 0)
-	{
-		parser_print(parser);
-	} else if(strcmp(parser->current_tk->lex, "ret") == 0)
+	if(header.num_of_funcs < 0 || header.num_of_consts < 0 || header.consts_size < 0 || header.bytecode_size < 1 || bytecode_at + header.bytecode_size != source->size)
 	{
-		parser_return(parser);
-	} else if(strcmp(parser->current_tk->lex, "if") == 0 ||
-			  strcmp(parser->current_tk->lex, "while") == 0)
-	{
-		flow(parser);
-	} else
-	{
-		error(parser, "expected different start of statement.");
+		printf("ERROR! truncated bytecode file!\n");
+		return NULL;
 	}
-}
-
-void sync(struct parser *parser)
-{
-	while(parser->current_tk->type != eoi)
+	
+	if(header.main < -1 || header.main >= header.num_of_funcs || (header.registers != 0 && header.registers != 1))
 	{
-		if(strcmp(parser->current_tk->lex, "if")      == 0 ||
-		   strcmp(parser->current_tk->lex, "while")   == 0) break;
-		
-		if(strcmp(parser->current_tk->lex, ";") == 0)
-		{
-			parser->current_tk++;
-			break;
-		}
-		
-		parser->current_tk++;
+		printf("ERROR! corrupt bytecode file, it has no such main function or backend!\n");
+		return NULL;
 	}
 	
-	parser->panic = 0;
-}
-
-void body(struct parser *parser)
-{
-	if(parser->panic) sync(parser);
+	/* the constants have to fill consts_size exactly, each a sign of 1 or -1 and a size that fits */
+	char *p = source->code + consts_at;
+	size_t left = header.consts_size;
 	
-	while(strcmp(parser->current_tk->lex, ")") != 0)
+	int i;
+	for(i = 0; i<header.num_of_consts; i++)
 	{
-		if(parser->current_tk->type == eoi) break;
+		int sign, size;
 		
-		statement(parser);
-		if(parser->panic) sync(parser);
-	}
-}
-
-void funcdecl(struct parser *parser)
-{	
-	expect_lex(parser, "(");
-
-	/* rel_addr is not incremented for function declarations */
-	if(!parser->syntax_error)
-	{
-		parser->current_tb = create_entry(parser->current_tb, parser->vm->num_of_labels, parser->current_tk->lex, func_type);
-		parser->vm->num_of_labels++;
+		if(left < 2 * sizeof(int)) break;
+		
+		memcpy(&sign, p, sizeof(int));
+		memcpy(&size, p + sizeof(int), sizeof(int));
+		p += 2 * sizeof(int);
+		left -= 2 * sizeof(int);
+		
+		if((sign != 1 && sign != -1) || size < 0 || (size_t)size > left / sizeof(uint32_t)) break;
+		
+		p += size * sizeof(uint32_t);
+		left -= size * sizeof(uint32_t);
 	}
 	
-	if(!parser->had_error)
+	if(i < header.num_of_consts || left != 0)
 	{
-		float *args = create_args(1, (float)parser->vm->num_of_labels-1);
-		parser->vm = emit_code(parser->vm, label, args, 1);
+		printf("ERROR! corrupt bytecode file, its constants don't add up!\n");
+		return NULL;
 	}
 	
-	expect_type(parser, id);
+	struct function *funcs = (struct function *)(source->code + funcs_at);
 	
-	if(!parser->syntax_error) parser->current_tb = push_tb(parser->current_tb); /* new scope for inside of function */
+	if(check_code((unsigned char *)source->code + bytecode_at, header.bytecode_size, funcs, header.num_of_funcs, header.num_of_consts, header.registers) != 0) return NULL;
 	
+	struct vm *vm = create_vm();
 	
-	parser->current_tb->back->entry[parser->current_tb->back->num_of_entries-1].num_of_args = 0;
+	vm->registers = header.registers;
+	vm->main = header.main;
 	
+	vm->num_of_funcs = header.num_of_funcs;
+	vm->funcs = malloc(header.num_of_funcs * sizeof(struct function));
+	memcpy(vm->funcs, source->code + funcs_at, header.num_of_funcs * sizeof(struct function));
+	vm->funcs_size = header.num_of_funcs;
 	
-	if(parser->current_tk->type == id)
+	for(i = 0; i<header.num_of_funcs; i++) vm->funcs[i].name = -1;
+	
+	vm->consts = malloc(header.num_of_consts * sizeof(struct bignum *));
+	vm->consts_size = header.num_of_consts;
+	
+	p = source->code + consts_at;
+	
+	for(i = 0; i<header.num_of_consts; i++)
 	{
+		int sign, size;
+		memcpy(&sign, p, sizeof(int));
+		memcpy(&size, p + sizeof(int), sizeof(int));
+		p += 2 * sizeof(int);
 		
-		/*
-			THESE ARE FOR FUNCTION ARGUMENTS, ***MIGHT*** NEED TO FIX SYMBOL TABLES LATER FOR THIS
-		*/
+		struct bignum *n = bn_new(size);
+		n->sign = sign;
+		memcpy(n->limb, p, size * sizeof(uint32_t));
+		p += size * sizeof(uint32_t);
 		
-		if(!parser->syntax_error)
-		{
-			parser->current_tb = create_entry(parser->current_tb, parser->rel_addr, parser->current_tk->lex, var_type);
-			parser->current_tb->back->entry[parser->current_tb->back->num_of_entries-1].num_of_args++;
-			parser->rel_addr++;
-		}
+		vm->consts[i] = val_norm(n);
+		vm->num_of_consts++;
+	}
+	
+	vm->bytecode = (unsigned char *)source->code + bytecode_at;
+	vm->bytecode_size = header.bytecode_size;
+	vm->image = source;
+	
+	return vm;
+}
+
+/*
+	-repl: compiles and runs path, then again every time a line is read from stdin, until it
+	ends or the line is q. only the functions that changed since the last time are compiled
+*/
+int repl(char *path, int registers, int jit, int code, int stats)
+{
+	struct session *session = create_session(registers);
+	char line[256];
+	
+	for(;;)
+	{
+		double start = seconds();
 		
-		expect_type(parser, id);
+		struct source *source = open_source(path, 1);
+		struct vm *vm = session_compile(session, source->code);
+		close_source(source);
+		
+		double end = seconds();
+		
+		if(stats && vm != NULL) printf("%s: compiled %d of %d functions in %.6f s\n", path, session->num_of_compiled, vm->num_of_funcs, end - start);
 		
-		while(strcmp(parser->current_tk->lex, ",") == 0)
+		if(vm != NULL)
 		{
-			if(parser->panic) break;
-			
-			expect_lex(parser, ",");
-			
-			if(!parser->syntax_error)
-			{
-				parser->current_tb = create_entry(parser->current_tb, parser->rel_addr, parser->current_tk->lex, var_type);
-				parser->current_tb->back->entry[parser->current_tb->back->num_of_entries-1].num_of_args++;
-				parser->rel_addr++;
-			}
+			if(code) print_code(vm);
 			
-			expect_type(parser, id);
+			/* a runtime error ends this run, not the session, so the next edit can fix it */
+			vm->jit = jit;
+			run_instance(vm);
+			free_vm(vm);
 		}
+		
+		fflush(stdout);
+		
+		if(fgets(line, sizeof(line), stdin) == NULL || strcmp(line, "q\n") == 0 || strcmp(line, "q") == 0) break;
 	}
 	
-	expect_lex(parser, "->");
-	
-	body(parser);
-	
-	expect_lex(parser, ")");
-	
-	if(!parser->had_error) parser->vm = emit_code(parser->vm, ret_none, NULL, 0);
+	free_session(session);
 	
-	if(!parser->syntax_error) parser->current_tb = pop_tb(parser->current_tb);
+	return 0;
 }
 
-void funclist(struct parser *parser)
+#ifndef NO_MAIN
+int main(int argc, char **argv)
 {
-	parser->current_tb = push_tb(parser->current_tb); /* global scope for function declarations */
+	char *path = NULL;
+	char *out = NULL;
+	char *profile = NULL;
+	int code = 0, step = 0, trace = 0, stats = 0, registers = 0, jit = 1, jobs = 1, session = 0;
 	
-	while(parser->current_tk->type != eoi)
+	int i;
+	for(i = 1; i<argc; i++)
 	{
-		parser->rel_addr = 0;
+		if(strcmp(argv[i], "-code") == 0)
+		{
+			code = 1;
+		} else if(strcmp(argv[i], "-step") == 0)
+		{
+			step = 1;
+		} else if(strcmp(argv[i], "-trace") == 0)
+		{
+			trace = 1;
+		} else if(strcmp(argv[i], "-reg") == 0)
+		{
+			registers = 1;
+		} else if(strcmp(argv[i], "-stats") == 0)
+		{
+			stats = 1;
+		} else if(strcmp(argv[i], "-nojit") == 0)
+		{
+			jit = 0;
+		} else if(strcmp(argv[i], "-repl") == 0)
+		{
+			session = 1;
+		} else if(strcmp(argv[i], "-j") == 0 && i + 1<argc)
+		{
+			jobs = atoi(argv[++i]);
+		} else if(strcmp(argv[i], "-profile") == 0 && i + 1<argc)
+		{
+			profile = argv[++i];
+		} else if(strcmp(argv[i], "-o") == 0 && i + 1<argc)
+		{
+			out = argv[++i];
+		} else
+		{
+			path = argv[i];
+		}
+	}
+	
+	if(path == NULL)
+	{
+		printf("usage: %s [-reg] [-nojit] [-code] [-step] [-trace] [-profile out] [-stats] [-j n] [-repl] [-o out] file\n", argv[0]);
+		printf("  -reg    compile for the register machine instead of the stack machine\n");
+		printf("  -nojit  interpret everything, even where hot functions could be compiled\n");
+		printf("  -code   print the instructions before running\n");
+		printf("  -step   print the frame and wait for enter before every instruction\n");
+		printf("  -trace  keep the last %d instructions, printed on a runtime error or SIGUSR1\n", TRACE_SIZE);
+		printf("  -profile  count and time every instruction, function and loop, written as json to out\n");
+		printf("            and as folded call stacks for a flame graph to out.folded\n");
+		printf("  -stats  print the time and memory it took to load and compile\n");
+		printf("  -j      parse on n threads, with the same result as on one\n");
+		printf("  -repl   run it again each time enter is pressed, compiling only the functions that\n");
+		printf("          changed in the meantime; q to quit\n");
+		printf("  -o      save the compiled program to out instead of running it\n");
+		printf("file is either source or a program saved with -o, which runs without compiling\n");
 		
-		funcdecl(parser);
+		return -1;
 	}
 	
-	if(!parser->syntax_error) parser->current_tb = pop_tb(parser->current_tb);
-
-	expect_lex(parser, "\0");
-}
-
-int main(void)
-{
-	struct parser *parser = malloc(sizeof(struct parser));
-	parser->tk_list = malloc(sizeof(struct token));
+	double start = seconds();
 	
-	parser->code = "(f a, b -> decl c = a + b; ret c;) (g -> decl x = 5; f(x, 2); g();)";
-	parser->begin = 0;
-	parser->panic = 0;
-	parser->syntax_error = 0;
-	parser->had_error = 0;
-	parser->list_size = 0;
+	int loaded = is_image(path);
 	
-	parser->current_tb = NULL;
+	if(session && !loaded && out == NULL) return repl(path, registers, jit, code, stats);
 	
-	parser->vm = create_vm();
+	struct source *source = open_source(path, !loaded);
+	struct vm *vm;
 	
-	/* put all of the tokens into a list (tk_list) */
-	do
+	/* a program saved with -o coming through a pipe is only known once it's been read */
+	if(!loaded && source->size >= 4 && memcmp(source->code, IMAGE_MAGIC, 4) == 0) loaded = 1;
+	
+	if(loaded)
 	{
-		parser->list_size++;
-		parser->tk_list = realloc(parser->tk_list, parser->list_size * sizeof(struct token));
-		parser->tk_list[parser->list_size-1] = next_token(parser->code, &parser->begin);
-		//printf("(%s, %d)\n", parser->tk_list[parser->list_size-1].lex, parser->tk_list[parser->list_size-1].type);
-	} while(parser->tk_list[parser->list_size-1].type != eoi);
-
-	parser->current_tk = parser->tk_list;
-
-	funclist(parser);
+		/* the vm owns source from here */
+		vm = load_code(source);
+		
+		if(vm == NULL)
+		{
+			close_source(source);
+			return -1;
+		}
+	} else
+	{
+		vm = registers ? compile_regs(source->code, jobs) : compile(source->code, jobs);
+	}
 	
-	print_code(parser->vm);
+	double end = seconds();
 	
-	run_vm(parser->vm);
+	if(stats) printf("%s: %lu bytes%s, %s in %.6f s, peak rss %ld KB\n", path, (unsigned long)source->size, source->mapped ? " mapped" : "", loaded ? "loaded" : "compiled", end - start, peak_rss());
 	
-	//printf("%d\n", parser->vm->code->args[0]);
+	if(!loaded) close_source(source);
 	
-	//int j;
-	//for(j = 0; j<(int)parser->vm->num_of_labels; j++) printf("%d\n", (int)parser->vm->label_list[j]);
+	if(vm == NULL) return -1;
 	
-	getchar();
+	if(stats && !loaded) print_mem(vm);
 	
-	/* clears out symbol table stack if an error occurs; this won't do anything if the program
-	   executes properly */
-	while(parser->current_tb != NULL)
+	if(out != NULL)
 	{
-		parser->current_tb = pop_tb(parser->current_tb);
+		int failed = save_code(vm, out);
+		free_vm(vm);
+		
+		return failed;
 	}
 	
-	int i;
-	for(i = 0; i<parser->list_size; i++) free(parser->tk_list[i].lex);
+	if(code) print_code(vm);
 	
-	free(parser->tk_list);
+	vm->step = step;
+	vm->jit = jit;
+	if(trace) vm->trace = create_trace();
+	if(profile != NULL) vm->profile = create_profile(vm);
 	
-	free(parser);
+	run_vm(vm);
+	
+	int failed = profile != NULL ? write_profile(vm, profile) : 0;
+	
+	free_vm(vm);
 
-    return 0;
-}
\ No newline at end of file
+    return failed;
+}
+#endif
\ No newline at end of file
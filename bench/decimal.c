@@ -0,0 +1,294 @@
+/*
+	decimal conversion benchmark
+
+	cc -std=c99 -O2 -pthread -o decimal bench/decimal.c -lm
+	./decimal
+
+	first prints a number of a million digits that comes straight from its limbs, the way one
+	loaded from a saved program does, before anything has worked out the powers of ten or their
+	reciprocals: that first call, which pays for them, is what a program printing it sees, so it
+	is the headline, with a second call after it for the conversion alone. then it converts
+	random numbers of a range of sizes to decimal and back, checking both ways against the
+	quadratic conversion 9 digits at a time at the sizes that finishes in reasonable time, and
+	checks print's zero padding. then it times a million digit number both ways and streaming it
+	out with bn_print, which is what print does
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#define NO_MAIN
+#include "../begin.c"
+
+/* the number in decimal the quadratic way, peeling off 9 digits at a time from the bottom */
+char * quadratic_to_str(struct bignum *n)
+{
+	char *str = malloc(n->size * 10 + 3);
+	char *end = str + n->size * 10 + 2;
+	char *p = end;
+
+	*p = '\0';
+
+	uint32_t *mag = malloc((n->size + 1) * sizeof(uint32_t));
+	memcpy(mag, n->limb, n->size * sizeof(uint32_t));
+	int size = n->size;
+
+	do
+	{
+		uint64_t r = 0;
+
+		int i;
+		for(i = size-1; i>=0; i--)
+		{
+			r = r << 32 | mag[i];
+			mag[i] = (uint32_t)(r / 1000000000u);
+			r %= 1000000000u;
+		}
+
+		while(size > 0 && mag[size-1] == 0) size--;
+
+		int digits;
+		for(digits = 0; digits<9 && (size > 0 || r != 0 || digits == 0); digits++)
+		{
+			p--;
+			*p = '0' + r % 10;
+			r /= 10;
+		}
+	} while(size > 0);
+
+	free(mag);
+
+	if(n->sign < 0)
+	{
+		p--;
+		*p = '-';
+	}
+
+	memmove(str, p, end - p + 1);
+
+	return str;
+}
+
+/* n random digits, the first not a zero */
+char * random_digits(int n)
+{
+	char *str = malloc(n + 1);
+
+	int i;
+	for(i = 0; i<n; i++) str[i] = '0' + rand() % 10;
+	if(str[0] == '0') str[0] = '1';
+	str[n] = '\0';
+
+	return str;
+}
+
+/* digits with long runs of nines and zeros, where the corrections in the division end up */
+char * runs_digits(int n)
+{
+	char *str = malloc(n + 1);
+
+	int i;
+	for(i = 0; i<n; i++) str[i] = (i / 997) % 2 ? '9' : '0';
+	str[0] = '1';
+	str[n] = '\0';
+
+	return str;
+}
+
+int check(char *str, int quadratic)
+{
+	int len = strlen(str);
+	struct bignum *n = bn_from_str(str, len);
+	char *back = bn_to_str(n);
+	int fail = strcmp(str, back) != 0;
+
+	if(quadratic)
+	{
+		struct bignum *m = bn_from_str_basecase(str, len);
+		char *slow = quadratic_to_str(n);
+
+		fail |= bn_cmp(n, m) != 0 || strcmp(slow, back) != 0;
+
+		bn_release(m);
+		free(slow);
+	}
+
+	if(fail) printf("FAIL round trip of %d digits\n", len);
+
+	free(back);
+	bn_release(n);
+
+	return fail;
+}
+
+/* what print x . digits writes, against printf's idea of it for one that fits */
+int check_padding(long long v, int digits)
+{
+	char want[64], *got;
+	size_t size;
+	FILE *out = open_memstream(&got, &size);
+
+	struct bignum *n = bn_from_int(v);
+	bn_print(out, n, digits);
+	fclose(out);
+	bn_release(n);
+
+	snprintf(want, sizeof(want), "%.*lld", digits > 0 ? digits : 1, v);
+
+	int fail = strcmp(want, got) != 0;
+	if(fail) printf("FAIL padding %lld to %d digits: %s, not %s\n", v, digits, got, want);
+
+	free(got);
+
+	return fail;
+}
+
+/* a number of size limbs, the top one not a zero */
+struct bignum * random_limbs(int size)
+{
+	struct bignum *temp = bn_new(size);
+
+	int i;
+	for(i = 0; i<size; i++) temp->limb[i] = (uint32_t)rand() << 16 ^ (uint32_t)rand();
+	if(temp->limb[size-1] == 0) temp->limb[size-1] = 1;
+
+	return temp;
+}
+
+/* how long bn_print takes to stream n out, and what it wrote */
+double time_print(struct bignum *n, char **got, size_t *size)
+{
+	FILE *out = open_memstream(got, size);
+
+	double start = seconds();
+	bn_print(out, n, 0);
+	fflush(out);
+	double t = seconds() - start;
+
+	fclose(out);
+
+	return t;
+}
+
+int main(void)
+{
+	int fail = 0;
+	int i;
+
+	srand(1);
+
+	/* 103811 limbs is a million digits, give or take a few */
+	struct bignum *cold = random_limbs(103811);
+	char *first, *second;
+	size_t first_size, second_size;
+
+	double t_first = time_print(cold, &first, &first_size);
+	double t_second = time_print(cold, &second, &second_size);
+
+	printf("%lu digits printed cold in %.2f ms, the first print of a program; %.2f ms once the powers and reciprocals are there\n", (unsigned long)first_size, t_first * 1e3, t_second * 1e3);
+
+	struct bignum *back_cold = bn_from_str(first, (int)first_size);
+
+	if(first_size != second_size || memcmp(first, second, first_size) != 0 || bn_cmp(back_cold, cold) != 0)
+	{
+		printf("FAIL printing %lu digits cold\n", (unsigned long)first_size);
+		fail = 1;
+	}
+
+	free(first); free(second);
+	bn_release(back_cold);
+	bn_release(cold);
+
+	printf("%10s %14s %14s %14s %14s\n", "digits", "to str ms", "quadratic ms", "from str ms", "quadratic ms");
+
+	int sizes[] = {100, 1000, 10000, 30000, 100000, 300000};
+	for(i = 0; i<(int)(sizeof(sizes)/sizeof(sizes[0])); i++)
+	{
+		char *str = random_digits(sizes[i]);
+
+		double start = seconds();
+		struct bignum *n = bn_from_str(str, sizes[i]);
+		double t_from = seconds() - start;
+
+		start = seconds();
+		struct bignum *m = bn_from_str_basecase(str, sizes[i]);
+		double t_from_slow = seconds() - start;
+
+		start = seconds();
+		char *fast = bn_to_str(n);
+		double t_to = seconds() - start;
+
+		start = seconds();
+		char *slow = quadratic_to_str(n);
+		double t_to_slow = seconds() - start;
+
+		if(strcmp(fast, str) != 0 || strcmp(slow, str) != 0 || bn_cmp(n, m) != 0)
+		{
+			printf("FAIL at %d digits\n", sizes[i]);
+			fail = 1;
+		}
+
+		printf("%10d %14.3f %14.3f %14.3f %14.3f\n", sizes[i], t_to * 1e3, t_to_slow * 1e3, t_from * 1e3, t_from_slow * 1e3);
+
+		free(str); free(fast); free(slow);
+		bn_release(n); bn_release(m);
+	}
+
+	for(i = 0; i<300; i++)
+	{
+		char *str = i % 2 ? random_digits(1 + rand() % 20000) : runs_digits(1 + rand() % 20000);
+		fail |= check(str, 1);
+		free(str);
+	}
+
+	long long values[] = {0, 7, -7, 123456789, -123456789, 4611686018427387904LL, -4611686018427387904LL};
+	int paddings[] = {0, 1, 5, 9, 10, 25};
+	int j;
+	for(i = 0; i<(int)(sizeof(values)/sizeof(values[0])); i++)
+	{
+		for(j = 0; j<(int)(sizeof(paddings)/sizeof(paddings[0])); j++) fail |= check_padding(values[i], paddings[j]);
+	}
+
+	/* the million digits, and once more padded out past them */
+	char *str = random_digits(1000000);
+
+	double start = seconds();
+	struct bignum *n = bn_from_str(str, 1000000);
+	printf("1000000 digits parsed in %.2f ms\n", (seconds() - start) * 1e3);
+
+	start = seconds();
+	char *back = bn_to_str(n);
+	printf("1000000 digits to a string in %.2f ms\n", (seconds() - start) * 1e3);
+
+	if(strcmp(str, back) != 0)
+	{
+		printf("FAIL round trip of 1000000 digits\n");
+		fail = 1;
+	}
+
+	char *got;
+	size_t size;
+	FILE *out = open_memstream(&got, &size);
+
+	start = seconds();
+	bn_print(out, n, 1000010);
+	fflush(out);
+	printf("1000000 digits printed in %.2f ms\n", (seconds() - start) * 1e3);
+
+	fclose(out);
+
+	if(size != 1000010 || memcmp(got, "0000000000", 10) != 0 || strcmp(got + 10, str) != 0)
+	{
+		printf("FAIL printing 1000000 digits padded to 1000010\n");
+		fail = 1;
+	}
+
+	free(got); free(back); free(str);
+	bn_release(n);
+
+	str = runs_digits(1000000);
+	fail |= check(str, 0);
+	free(str);
+
+	printf(fail ? "FAILED\n" : "all conversions agree\n");
+
+	return fail;
+}
\ No newline at end of file
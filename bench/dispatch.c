@@ -0,0 +1,56 @@
+/*
+	interpreter dispatch benchmark
+
+	cc -std=c99 -O2 -o dispatch bench/dispatch.c -lm
+	cc -std=c99 -O2 -DNO_COMPUTED_GOTO -o dispatch_switch bench/dispatch.c -lm
+	./dispatch [statements] [runs]
+
+	compiles one function made of a long run of arithmetic statements and times
+	run_vm over its packed bytecode, reporting instructions per second for
+	whichever dispatch the binary was built with
+*/
+
+#define _POSIX_C_SOURCE 199309L
+#define NO_MAIN
+#include "../begin.c"
+
+int main(int argc, char **argv)
+{
+	int statements = argc > 1 ? atoi(argv[1]) : 100;
+	int runs = argc > 2 ? atoi(argv[2]) : 100000;
+
+	char *stmt = "a = a + b * 3 - b; b = (b + 1) * (a < b); ";
+
+	char *code = malloc(statements * strlen(stmt) + 64);
+	strcpy(code, "(main -> decl a = 1; decl b = 2; ");
+
+	char *end = code + strlen(code);
+
+	int i;
+	for(i = 0; i<statements; i++)
+	{
+		memcpy(end, stmt, strlen(stmt));
+		end += strlen(stmt);
+	}
+	strcpy(end, ")");
+
+	struct vm *vm = compile(code, 1);
+	if(vm == NULL) return -1;
+
+	double start = seconds();
+	for(i = 0; i<runs; i++) run_vm(vm);
+	double t = seconds() - start;
+
+	/* straight-line code, so every instruction runs once per run, plus the halt */
+	double insts = (double)(vm->num_of_insts + 1) * runs;
+
+#ifdef THREADED
+	printf("dispatch: computed goto\n");
+#else
+	printf("dispatch: switch\n");
+#endif
+	printf("bytecode: %d instructions in %d bytes\n", vm->num_of_insts, vm->bytecode_size);
+	printf("%.0f instructions in %.3f s: %.1f M instructions/s\n", insts, t, insts / t / 1e6);
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,99 @@
+/*
+	large program check
+
+	cc -std=c99 -O2 -pthread -o large bench/large.c -lm
+	./large [statements]
+
+	compiles and runs a generated program with more instructions, constants and labels than a
+	float holds exactly (2^24), which is where an operand that lost precision would send a jump
+	to the wrong instruction or push the wrong constant. a function of one statement per
+	instruction, 17000001 of them by default, each with its own literal, comes first, then a main
+	whose loop and call land past all of them. both backends have to print exactly what the
+	program says. it takes a couple of gigabytes and most of a minute
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#define NO_MAIN
+#include "../begin.c"
+
+/* filler adds 1 to its argument n times, one statement and one constant each */
+char * generate(int n)
+{
+	char *statement = "a = a + 1;\n";
+	char *main = "(main ->\n\tdecl i = 0;\n\twhile(i < 10 ->\n\t\tprint i . 2;\n\t\ti = i + 1;\n\t)\n\tdecl f = filler(0);\n\tprint f;\n)\n";
+
+	size_t size = (size_t)n * strlen(statement) + strlen(main) + 64;
+	char *code = malloc(size);
+	char *end = code;
+
+	end += sprintf(end, "(filler a ->\n");
+
+	int i;
+	for(i = 0; i<n; i++)
+	{
+		memcpy(end, statement, strlen(statement));
+		end += strlen(statement);
+	}
+
+	end += sprintf(end, "ret a;)\n");
+	sprintf(end, "%s", main);
+
+	return code;
+}
+
+/* runs what compile made of code and checks its output against want */
+int check(char *name, struct vm * (*compile)(char *, int), char *code, char *want)
+{
+	double start = seconds();
+	struct vm *vm = compile(code, 1);
+
+	if(vm == NULL)
+	{
+		printf("FAIL %s doesn't compile\n", name);
+		return 1;
+	}
+
+	double t_compile = seconds() - start;
+	int num_of_insts = vm->num_of_insts;
+	int num_of_consts = vm->num_of_consts;
+
+	char *got;
+	size_t size;
+	vm->out = open_memstream(&got, &size);
+
+	start = seconds();
+	run_vm(vm);
+	double t_run = seconds() - start;
+
+	fclose(vm->out);
+	vm->out = stdout;
+
+	int fail = strcmp(got, want) != 0;
+
+	printf("%-6s %d instructions, %d constants, compiled in %.2f s, ran in %.2f s: %s\n", name, num_of_insts, num_of_consts, t_compile, t_run, fail ? "FAIL" : "ok");
+	if(fail) printf("printed:\n%.200s\nnot:\n%s", got, want);
+
+	free(got);
+	free_vm(vm);
+
+	return fail;
+}
+
+int main(int argc, char **argv)
+{
+	int n = argc > 1 ? atoi(argv[1]) : 17000001;
+
+	char want[256];
+	sprintf(want, "00\n01\n02\n03\n04\n05\n06\n07\n08\n09\n%d\n", n);
+
+	char *code = generate(n);
+
+	int fail = check("stack", compile, code, want);
+	fail |= check("reg", compile_regs, code, want);
+
+	free(code);
+
+	printf(fail ? "FAILED\n" : "both backends ran it correctly\n");
+
+	return fail;
+}
\ No newline at end of file
@@ -0,0 +1,228 @@
+/*
+	bignum multiplication benchmark
+
+	cc -std=c99 -O2 -pthread -o mul bench/mul.c -lm
+	./mul
+
+	times one level of schoolbook, Karatsuba and Toom-3 at a range of sizes (everything below
+	that level goes through mag_mul as usual) to find the crossovers that KARATSUBA_THRESHOLD
+	and TOOM3_THRESHOLD are set from, and the number theoretic transform on one thread and on
+	one per processor for NTT_THRESHOLD, checking they all agree. then it checks the transform
+	against schoolbook on random operands of random sizes and on the largest operands it takes,
+	and times 10000!, 100000! and 3^(2^22), the last two by way of the transform
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#define NO_MAIN
+#include "../begin.c"
+
+uint32_t rand_limb(void)
+{
+	return (uint32_t)rand() << 16 ^ (uint32_t)rand();
+}
+
+/* seconds per call of mul on two n limb operands */
+double time_mul(void (*mul)(uint32_t *, const uint32_t *, int, const uint32_t *, int), uint32_t *r, uint32_t *a, uint32_t *b, int n)
+{
+	int reps = 1;
+	double t;
+
+	do
+	{
+		double start = seconds();
+
+		int i;
+		for(i = 0; i<reps; i++) mul(r, a, n, b, n);
+
+		t = seconds() - start;
+		reps *= 2;
+	} while(t < 0.05);
+
+	return t / (reps / 2);
+}
+
+/* product of lo..hi, split in halves so the big multiplications are balanced */
+struct bignum * range_product(int lo, int hi)
+{
+	if(lo == hi) return bn_from_int(lo);
+
+	int mid = lo + (hi - lo) / 2;
+	struct bignum *a = range_product(lo, mid);
+	struct bignum *b = range_product(mid + 1, hi);
+	struct bignum *temp = bn_mul(a, b);
+
+	bn_release(a);
+	bn_release(b);
+
+	return temp;
+}
+
+/* random operands of random sizes up to max, some all ones bits and some squares, against schoolbook */
+int check_random(int trials, int max)
+{
+	uint32_t *a = malloc(max * sizeof(uint32_t));
+	uint32_t *b = malloc(max * sizeof(uint32_t));
+	uint32_t *r1 = malloc(2 * max * sizeof(uint32_t));
+	uint32_t *r2 = malloc(2 * max * sizeof(uint32_t));
+
+	int i, j, bad = 0;
+	for(i = 0; i<trials; i++)
+	{
+		int an = 1 + rand() % max;
+		int bn = 1 + rand() % max;
+		int ones = i % 8 == 0;
+
+		for(j = 0; j<an; j++) a[j] = ones ? 0xFFFFFFFFu : rand_limb();
+		for(j = 0; j<bn; j++) b[j] = ones ? 0xFFFFFFFFu : rand_limb();
+
+		/* a square is transformed once */
+		uint32_t *y = i % 8 == 1 ? a : b;
+		int yn = i % 8 == 1 ? an : bn;
+
+		mag_mul_basecase(r1, a, an, y, yn);
+		mag_ntt(r2, a, an, y, yn);
+
+		if(memcmp(r1, r2, (an + yn) * sizeof(uint32_t)) != 0)
+		{
+			printf("MISMATCH at %d x %d limbs!\n", an, yn);
+			bad++;
+		}
+	}
+
+	free(a); free(b); free(r1); free(r2);
+
+	return bad;
+}
+
+/* (2^32n - 1)^2 = 2^64n - 2^(32n+1) + 1, which has every coefficient as big as they get */
+int check_ones(int n)
+{
+	uint32_t *a = malloc(n * sizeof(uint32_t));
+	uint32_t *b = malloc(n * sizeof(uint32_t));
+	uint32_t *r = malloc(2 * n * sizeof(uint32_t));
+
+	memset(a, 0xFF, n * sizeof(uint32_t));
+	memset(b, 0xFF, n * sizeof(uint32_t));
+
+	mag_ntt(r, a, n, b, n);
+
+	int i, bad = r[0] != 1 || r[n] != 0xFFFFFFFEu;
+	for(i = 1; i<n; i++) bad |= r[i] != 0;
+	for(i = n + 1; i<2*n; i++) bad |= r[i] != 0xFFFFFFFFu;
+
+	free(a); free(b); free(r);
+
+	return bad;
+}
+
+/* mag_ntt on the number of threads ntt_threads is set to */
+void ntt_one(uint32_t *r, const uint32_t *a, int an, const uint32_t *b, int bn)
+{
+	ntt_threads = 1;
+	mag_ntt(r, a, an, b, bn);
+	ntt_threads = 0;
+}
+
+int main(void)
+{
+	int sizes[] = {8, 16, 24, 32, 40, 48, 64, 96, 128, 160, 192, 256, 384, 512, 1024, 2048, 4096, 8192, 16384, 32768, 65536};
+	int num_of_sizes = sizeof(sizes) / sizeof(sizes[0]);
+	int max_schoolbook = 8192; /* past this it takes seconds a call */
+
+	srand(1);
+
+	printf("%6s %12s %12s %12s %12s %12s\n", "limbs", "schoolbook", "karatsuba", "toom3", "ntt", "ntt threads");
+
+	int i;
+	for(i = 0; i<num_of_sizes; i++)
+	{
+		int n = sizes[i];
+
+		uint32_t *a = malloc(n * sizeof(uint32_t));
+		uint32_t *b = malloc(n * sizeof(uint32_t));
+		uint32_t *r1 = malloc(2 * n * sizeof(uint32_t));
+		uint32_t *r2 = malloc(2 * n * sizeof(uint32_t));
+		uint32_t *r3 = malloc(2 * n * sizeof(uint32_t));
+		uint32_t *r4 = malloc(2 * n * sizeof(uint32_t));
+		uint32_t *r5 = malloc(2 * n * sizeof(uint32_t));
+
+		int j;
+		for(j = 0; j<n; j++)
+		{
+			a[j] = rand_limb();
+			b[j] = rand_limb();
+		}
+
+		double t1 = n <= max_schoolbook ? time_mul(mag_mul_basecase, r1, a, b, n) : 0;
+		double t2 = time_mul(mag_karatsuba, r2, a, b, n);
+		double t3 = time_mul(mag_toom3, r3, a, b, n);
+		double t4 = time_mul(ntt_one, r4, a, b, n);
+		double t5 = time_mul(mag_ntt, r5, a, b, n);
+
+		size_t bytes = 2 * n * sizeof(uint32_t);
+		if((n <= max_schoolbook && memcmp(r1, r2, bytes) != 0) || memcmp(r2, r3, bytes) != 0 || memcmp(r2, r4, bytes) != 0 || memcmp(r2, r5, bytes) != 0)
+		{
+			printf("MISMATCH at %d limbs!\n", n);
+			return -1;
+		}
+
+		if(n <= max_schoolbook)
+		{
+			printf("%6d %10.2fus", n, t1 * 1e6);
+		} else
+		{
+			printf("%6d %12s", n, "-");
+		}
+
+		printf(" %10.2fus %10.2fus %10.2fus %10.2fus\n", t2 * 1e6, t3 * 1e6, t4 * 1e6, t5 * 1e6);
+
+		free(a); free(b); free(r1); free(r2); free(r3); free(r4); free(r5);
+	}
+
+	int bad = check_random(400, 3000);
+	printf("ntt against schoolbook on 400 random operands up to 3000 limbs: %d wrong\n", bad);
+
+	int ones = 1 << (NTT_MAX_LOG - 1);
+	bad = check_ones(ones);
+	printf("ntt on two %d limb operands of all ones, the most it takes: %s\n", ones, bad ? "WRONG" : "right");
+
+	double start = seconds();
+
+	struct bignum *f = bn_from_int(1);
+	for(i = 2; i<=10000; i++)
+	{
+		struct bignum *k = bn_from_int(i);
+		struct bignum *temp = bn_mul(f, k);
+
+		bn_release(f);
+		bn_release(k);
+		f = temp;
+	}
+
+	double t_fact = seconds() - start;
+
+	char *str = bn_to_str(f);
+	printf("10000! has %d digits, computed in %.2f ms\n", (int)strlen(str), t_fact * 1e3);
+
+	free(str);
+	bn_release(f);
+
+	start = seconds();
+	f = range_product(1, 100000);
+	printf("100000! has %d limbs, computed in %.2f ms\n", f->size, (seconds() - start) * 1e3);
+	bn_release(f);
+
+	start = seconds();
+	f = bn_from_int(3);
+	for(i = 0; i<22; i++)
+	{
+		struct bignum *temp = bn_mul(f, f);
+
+		bn_release(f);
+		f = temp;
+	}
+	printf("3^(2^22) has %d limbs, computed in %.2f ms\n", f->size, (seconds() - start) * 1e3);
+	bn_release(f);
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,169 @@
+/*
+	operand stack microbenchmark
+
+	cc -std=c99 -O2 -o opstack bench/opstack.c -lm
+	./opstack [iterations]
+
+	runs the loop
+
+		(main -> decl i = 0; while(i < n -> i = i + 1;))
+
+	compiled and interpreted by run_vm, whose operand stack is sp moving over the frame's part
+	of the frstack that push_frame set aside, and compares its time per iteration and per
+	instruction with the operand stack traffic of the same loop alone replayed on the old
+	realloc-per-push stack, push_loc, push_val, less_than, jmpf, push_adr, push_loc, push_val,
+	plus, set_equal, jmp per iteration. the values are small ones, which are never allocated, so that bignum arithmetic
+	doesn't come into either. how many instructions run_vm ran is counted with the profiler on a
+	shorter run of the same loop, so the comparison stays right whatever the peephole pass fuses
+*/
+
+#define _POSIX_C_SOURCE 199309L
+#define NO_MAIN
+#include "../begin.c"
+
+/* the stack as it was before it was preallocated */
+struct opstack * old_push_op(struct opstack *op, union slot n)
+{
+    op->top++;
+    op->stack = realloc(op->stack, (op->top + 1) * sizeof(union slot));
+    op->stack[op->top] = n;
+
+    return op;
+}
+
+struct opstack * old_pop_op(struct opstack *op)
+{
+    if(op->stack != NULL)
+    {
+        op->top--;
+
+        if(op->top == -1)
+        {
+            free(op->stack);
+            op->stack = NULL;
+        } else
+        {
+            op->stack = realloc(op->stack, (op->top + 1) * sizeof(union slot));
+        }
+    } else
+    {
+        printf("RUNTIME ERROR: unable to pop!\n");
+        exit(-1);
+    }
+
+    return op;
+}
+
+#define INSTS_PER_ITER 10
+
+union slot slot(int n)
+{
+	union slot temp;
+	temp.num = SMALL(n);
+
+	return temp;
+}
+
+#define INT(s) ((int)SMALL_OF((s).num))
+
+/* volatile so the loop can't be folded away */
+volatile int locals[2];
+
+double run_old(long iters)
+{
+	struct opstack op = {NULL, -1, 0};
+	int inter;
+
+	double start = seconds();
+
+	long i;
+	for(i = 0; i<iters; i++)
+	{
+		old_push_op(&op, slot(locals[0]));                          /* push_loc */
+		old_push_op(&op, slot(locals[1]));                          /* push_val */
+		inter = INT(op.stack[op.top-1]) < INT(op.stack[op.top]);    /* less_than */
+		old_pop_op(&op);
+		old_pop_op(&op);
+		old_push_op(&op, slot(inter));
+		old_pop_op(&op);                                            /* jmpf */
+		old_push_op(&op, slot(0));                                  /* push_adr */
+		old_push_op(&op, slot(locals[0]));                          /* push_loc */
+		old_push_op(&op, slot(1));                                  /* push_val */
+		inter = INT(op.stack[op.top-1]) + INT(op.stack[op.top]);    /* plus */
+		old_pop_op(&op);
+		old_pop_op(&op);
+		old_push_op(&op, slot(inter));
+		locals[INT(op.stack[op.top-1])] = INT(op.stack[op.top]);    /* set_equal */
+		old_pop_op(&op);
+		old_pop_op(&op);
+		/* jmp has no stack traffic */
+	}
+
+	return seconds() - start;
+}
+
+/* the loop above compiled for n iterations, interpreted only */
+struct vm * compile_loop(long n)
+{
+	char code[128];
+	snprintf(code, sizeof(code), "(main -> decl i = 0; while(i < %ld -> i = i + 1;))", n);
+
+	struct vm *vm = compile(code, 1);
+	if(vm == NULL) exit(-1);
+
+	vm->jit = 0;
+
+	return vm;
+}
+
+/* instructions run_vm runs for the loop of n iterations, from the profiler's counts */
+long long count_insts(long n)
+{
+	struct vm *vm = compile_loop(n);
+	vm->profile = create_profile(vm);
+
+	run_vm(vm);
+
+	long long count = 0;
+	int i;
+	for(i = 0; i<vm->bytecode_size; i++) count += vm->profile->counts[i];
+
+	free_vm(vm);
+
+	return count;
+}
+
+double run_new(long iters, long long *insts)
+{
+	/* the loop has the same instructions every iteration, so two short runs give the rest */
+	long long per_iter = (count_insts(2000) - count_insts(1000)) / 1000;
+	*insts = count_insts(1000) + per_iter * (iters - 1000);
+
+	struct vm *vm = compile_loop(iters);
+
+	double start = seconds();
+	run_vm(vm);
+	double t = seconds() - start;
+
+	free_vm(vm);
+
+	return t;
+}
+
+int main(int argc, char **argv)
+{
+	long iters = argc > 1 ? atol(argv[1]) : 10000000;
+
+	locals[0] = 0;
+	locals[1] = 1000000000;
+	double t_old = run_old(iters);
+
+	long long insts;
+	double t_new = run_new(iters, &insts);
+
+	printf("iterations: %ld\n", iters);
+	printf("realloc stack:  %8.3f s  %6.2f ns/iteration  %6.2f ns/inst  (%d stack instructions each, nothing else)\n", t_old, t_old * 1e9 / iters, t_old * 1e9 / ((double)iters * INSTS_PER_ITER), INSTS_PER_ITER);
+	printf("run_vm:         %8.3f s  %6.2f ns/iteration  %6.2f ns/inst  (%.1f instructions each, dispatch included)\n", t_new, t_new * 1e9 / iters, t_new * 1e9 / insts, (double)insts / iters);
+
+	return 0;
+}
@@ -0,0 +1,97 @@
+/*
+	profiler check
+
+	cc -std=c99 -O2 -o profile bench/profile.c -lm
+	./profile [corpus]
+
+	profiles bench/corpus/tail.bl on both backends and checks that every enter was charged to
+	the function it opens. sum calls itself a million times through tail_call, which pops the
+	caller before jumping to the enter, so an enter charged to whoever was on top of the frame
+	stack would make main, which runs a handful of instructions, look like it takes a sizeable
+	part of the run. main has to come out with no more than 1% of the time, and both functions
+	with the calls they were made
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#define NO_MAIN
+#include "../begin.c"
+
+/* the function called name in vm, -1 if there isn't one */
+int find_func(struct vm *vm, char *name)
+{
+	int i;
+	for(i = 0; i<vm->num_of_funcs; i++) if(vm->funcs[i].name == intern(name, strlen(name))) return i;
+
+	return -1;
+}
+
+/* profiles code on one backend, returns how many checks failed */
+int check(char *code, int registers)
+{
+	char *backend = registers ? "registers" : "stack";
+
+	struct vm *vm = registers ? compile_regs(code, 1) : compile(code, 1);
+	if(vm == NULL) return 1;
+
+	vm->out = fopen("/dev/null", "w");
+	vm->profile = create_profile(vm);
+
+	run_vm(vm);
+
+	struct profile *profile = vm->profile;
+	int sum = find_func(vm, "sum");
+	int main_func = find_func(vm, "main");
+	int wrong = 0;
+
+	uint64_t total = 0;
+	int i;
+	for(i = 0; i<vm->bytecode_size; i++) total += profile->cycles[i];
+
+	struct profile_func *s = &profile->funcs[sum];
+	struct profile_func *m = &profile->funcs[main_func];
+
+	printf("%-9s sum: %lld calls, %llu self; main: %lld calls, %llu self (%.3f%% of %llu %s)\n", backend,
+	       s->calls, (unsigned long long)s->self, m->calls, (unsigned long long)m->self,
+	       100.0 * m->self / total, (unsigned long long)total, PROFILE_UNIT);
+
+	if(s->calls != 1000001 || m->calls != 1)
+	{
+		printf("ERROR! %s: sum should be called 1000001 times and main once!\n", backend);
+		wrong++;
+	}
+
+	if(profile->counts[vm->funcs[sum].offset] != s->calls)
+	{
+		printf("ERROR! %s: sum's enter ran %lld times for %lld calls!\n", backend, profile->counts[vm->funcs[sum].offset], s->calls);
+		wrong++;
+	}
+
+	if(m->self * 100 > total)
+	{
+		printf("ERROR! %s: main was charged for more than 1%% of the run, sum's enters went to it!\n", backend);
+		wrong++;
+	}
+
+	fclose(vm->out);
+	free_vm(vm);
+
+	return wrong;
+}
+
+int main(int argc, char **argv)
+{
+	char *corpus = argc > 1 ? argv[1] : "bench/corpus";
+
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/tail.bl", corpus);
+
+	struct source *source = open_source(path, 1);
+
+	int wrong = check(source->code, 0) + check(source->code, 1);
+
+	close_source(source);
+
+	printf("%s\n", wrong ? "FAILED" : "ok");
+
+	return wrong ? -1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,95 @@
+/*
+	instance runner benchmark
+
+	cc -std=c99 -O2 -pthread -o runner bench/runner.c -lm
+	./runner [scripts] [threads]
+
+	compiles two small programs once, one of which ends on a division by zero, and runs them as
+	scripts instances between them, one in ten the failing one, each printing into a buffer of
+	its own. they are run on a runner of 1, 2, 4 and so on up to threads threads (the number of
+	processors by default), reporting scripts per second for each and checking that every
+	instance printed what its program prints when it is run on its own, and that only the failing
+	ones ended on an error. the program's hot function is compiled to machine code where JIT is
+	defined
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#define NO_MAIN
+#include "../begin.c"
+
+#include <unistd.h>
+
+char *program_code =
+	"(fib n -> if(n < 2 -> ret n;) ret fib(n - 1) + fib(n - 2);)"
+	"(main -> decl a = fib(15); print a; decl b = 99999999999999999999 * a; print b;)";
+char *program_output = "610\n60999999999999999999390\n";
+
+char *failing_code = "(main -> decl a = 1; decl b = 0; decl c = a / b; print c;)";
+char *failing_output = "RUNTIME ERROR: division by zero!\n";
+
+int main(int argc, char **argv)
+{
+	int scripts = argc > 1 ? atoi(argv[1]) : 20000;
+	int max_threads = argc > 2 ? atoi(argv[2]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+	struct vm *program = compile(program_code, 1);
+	struct vm *failing = compile(failing_code, 1);
+	if(program == NULL || failing == NULL) return -1;
+
+	/* fib gets hot in every instance, and the first to compile it does so for all of them */
+	program->jit = 1;
+
+	struct vm **vms = malloc(scripts * sizeof(struct vm *));
+	FILE **outs = malloc(scripts * sizeof(FILE *));
+	char **bufs = malloc(scripts * sizeof(char *));
+	size_t *sizes = malloc(scripts * sizeof(size_t));
+
+	int threads, i, failures = 0;
+	for(threads = 1; threads <= max_threads; threads *= 2)
+	{
+		struct runner *runner = create_runner(threads);
+		if(runner == NULL) return -1;
+
+		double start = seconds();
+
+		for(i = 0; i<scripts; i++)
+		{
+			outs[i] = open_memstream(&bufs[i], &sizes[i]);
+			vms[i] = create_instance(i % 10 == 9 ? failing : program, outs[i]);
+			runner_submit(runner, vms[i]);
+		}
+
+		int failed = runner_wait(runner);
+		double t = seconds() - start;
+
+		int wrong = 0;
+		for(i = 0; i<scripts; i++)
+		{
+			free_vm(vms[i]);
+			fclose(outs[i]);
+
+			if(strcmp(bufs[i], i % 10 == 9 ? failing_output : program_output) != 0) wrong++;
+			free(bufs[i]);
+		}
+
+		free_runner(runner);
+
+		printf("%2d threads: %d scripts in %.3f s, %.0f scripts/s, %d runtime errors, %d wrong\n", threads, scripts, t, scripts / t, failed, wrong);
+
+		if(wrong > 0 || failed != scripts / 10)
+		{
+			printf("ERROR! %d threads: %d instances printed the wrong thing and %d of %d ended on an error!\n", threads, wrong, failed, scripts / 10);
+			failures++;
+		}
+	}
+
+	free(vms);
+	free(outs);
+	free(bufs);
+	free(sizes);
+
+	free_vm(program);
+	free_vm(failing);
+
+	return failures ? -1 : 0;
+}
\ No newline at end of file
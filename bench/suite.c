@@ -0,0 +1,378 @@
+/*
+	end to end benchmark suite
+
+	cc -std=c99 -O2 -o suite bench/suite.c -lm
+	./suite [-runs n] [-funcs n] [-corpus dir] [-lex kernels] [-o file]
+
+	compiles and runs each program in bench/corpus plus one generated source with thousands of
+	funcdecls, timing every stage on its own:
+
+		lex       next_token over the whole source, nothing else
+		parse     funclist, which pulls its tokens from the lexer and emits as it goes
+		emit      emit_code alone, replaying the instructions parse emitted into a fresh vm
+		optimize  optimize_code
+		link      link_code and pack_code
+		run       run_vm, with the program's output thrown away
+		regs      translate_regs, link_code and pack_code on a second parse
+		run_regs  run_vm on the register code, output thrown away the same way
+
+	each stage is repeated -runs times (10 by default) and summarised as min, median, mean and
+	standard deviation in seconds. the results go to -o (bench/results.json by default) as JSON,
+	tagged with the dispatch, thresholds and lexer kernels the binary ran with so runs from
+	different versions can be compared; a table of the medians is printed as well, with the
+	lexer's throughput in MB/s. -lex picks the lexer's kernels, "scalar", "sse2" or "avx2",
+	instead of the widest the CPU has
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#define NO_MAIN
+#include "../begin.c"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+enum stage
+{
+	stage_lex,
+	stage_parse,
+	stage_emit,
+	stage_optimize,
+	stage_link,
+	stage_run,
+	stage_regs,
+	stage_run_regs,
+	num_of_stages
+};
+
+char *stage_names[] = {"lex", "parse", "emit", "optimize", "link", "run", "regs", "run_regs"};
+
+struct stats
+{
+	double min;
+	double median;
+	double mean;
+	double stddev;
+};
+
+struct result
+{
+	char *name;
+	size_t bytes;
+	int tokens;
+	int insts; /* after linking */
+	struct stats stage[num_of_stages];
+};
+
+int compare_doubles(const void *a, const void *b)
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+struct stats summarise(double *t, int n)
+{
+	struct stats temp;
+
+	qsort(t, n, sizeof(double), compare_doubles);
+
+	temp.min = t[0];
+	temp.median = n % 2 ? t[n/2] : (t[n/2 - 1] + t[n/2]) / 2;
+
+	double sum = 0;
+	int i;
+	for(i = 0; i<n; i++) sum += t[i];
+	temp.mean = sum / n;
+
+	double var = 0;
+	for(i = 0; i<n; i++) var += (t[i] - temp.mean) * (t[i] - temp.mean);
+	temp.stddev = n > 1 ? sqrt(var / (n - 1)) : 0;
+
+	return temp;
+}
+
+/* the tokens in code, lexed and thrown away */
+int lex_all(char *code)
+{
+	int begin = 0;
+	int tokens = 0;
+
+	lex_reset();
+
+	struct token tk;
+	do
+	{
+		tk = next_token(code, &begin);
+		tokens++;
+	} while(tk.type != eoi);
+
+	return tokens;
+}
+
+/* a copy of vm's code as parse left it, since link_code rewrites it in place */
+struct inst * copy_code(struct vm *vm)
+{
+	struct inst *temp = malloc(vm->num_of_insts * sizeof(struct inst));
+	memcpy(temp, vm->code, vm->num_of_insts * sizeof(struct inst));
+
+	return temp;
+}
+
+/* runs vm with stdout pointed at /dev/null */
+void run_quietly(struct vm *vm)
+{
+	fflush(stdout);
+
+	int saved = dup(1);
+	int null = open("/dev/null", O_WRONLY);
+	dup2(null, 1);
+	close(null);
+
+	run_vm(vm);
+
+	fflush(stdout);
+	dup2(saved, 1);
+	close(saved);
+}
+
+struct result bench(char *name, char *code, int runs)
+{
+	struct result temp;
+	double *t[num_of_stages];
+
+	int i, j;
+	for(i = 0; i<num_of_stages; i++) t[i] = malloc(runs * sizeof(double));
+
+	temp.name = name;
+	temp.bytes = strlen(code);
+
+	for(i = 0; i<runs; i++)
+	{
+		double start = seconds();
+		temp.tokens = lex_all(code);
+		t[stage_lex][i] = seconds() - start;
+
+		start = seconds();
+		struct vm *vm = parse(code);
+		t[stage_parse][i] = seconds() - start;
+
+		if(vm == NULL)
+		{
+			printf("ERROR! %s doesn't compile!\n", name);
+			exit(-1);
+		}
+
+		struct inst *code_copy = copy_code(vm);
+		int num_of_insts = vm->num_of_insts;
+
+		struct vm *replay = create_vm();
+
+		start = seconds();
+		for(j = 0; j<num_of_insts; j++) replay = emit_code(replay, code_copy[j].type, code_copy[j].args, code_copy[j].num_of_args);
+		t[stage_emit][i] = seconds() - start;
+
+		free_vm(replay);
+		free(code_copy);
+
+		start = seconds();
+		vm = optimize_code(vm);
+		t[stage_optimize][i] = seconds() - start;
+
+		start = seconds();
+		vm = link_code(vm);
+		vm = pack_code(vm);
+		t[stage_link][i] = seconds() - start;
+
+		temp.insts = vm->num_of_insts;
+
+		start = seconds();
+		run_quietly(vm);
+		t[stage_run][i] = seconds() - start;
+
+		free_vm(vm);
+		
+		vm = parse(code);
+		
+		start = seconds();
+		vm = translate_regs(vm);
+		vm = link_code(vm);
+		vm = pack_code(vm);
+		t[stage_regs][i] = seconds() - start;
+		
+		start = seconds();
+		run_quietly(vm);
+		t[stage_run_regs][i] = seconds() - start;
+		
+		free_vm(vm);
+	}
+
+	for(i = 0; i<num_of_stages; i++)
+	{
+		temp.stage[i] = summarise(t[i], runs);
+		free(t[i]);
+	}
+
+	return temp;
+}
+
+/* n functions shaped like real code, each called once from main */
+char * generate(int n)
+{
+	char *body = "(func%d alpha, beta -> decl gamma = alpha + beta * 3; while(gamma < 100 and beta > 0 -> gamma = gamma + alpha; beta = beta - 1;) if(gamma > 50 or alpha < 2 -> gamma = gamma / 2;) ret gamma;)\n";
+	char *call = "x = x + func%d(%d, 7);\n";
+
+	size_t size = (size_t)n * (strlen(body) + strlen(call) + 32) + 64;
+	char *code = malloc(size);
+	char *end = code;
+
+	int i;
+	for(i = 0; i<n; i++) end += sprintf(end, body, i);
+
+	end += sprintf(end, "(main -> decl x = 0;\n");
+	for(i = 0; i<n; i++) end += sprintf(end, call, i, i % 13);
+	sprintf(end, "print x;)\n");
+
+	return code;
+}
+
+void print_stats(FILE *file, struct stats *stats)
+{
+	fprintf(file, "{\"min\": %.9f, \"median\": %.9f, \"mean\": %.9f, \"stddev\": %.9f}", stats->min, stats->median, stats->mean, stats->stddev);
+}
+
+void write_json(FILE *file, struct result *results, int num_of_results, int runs)
+{
+	fprintf(file, "{\n");
+#ifdef THREADED
+	fprintf(file, "  \"dispatch\": \"computed goto\",\n");
+#else
+	fprintf(file, "  \"dispatch\": \"switch\",\n");
+#endif
+#ifdef JIT
+	fprintf(file, "  \"jit_threshold\": %d,\n", JIT_THRESHOLD);
+#else
+	fprintf(file, "  \"jit_threshold\": null,\n");
+#endif
+	fprintf(file, "  \"karatsuba_threshold\": %d,\n", KARATSUBA_THRESHOLD);
+	fprintf(file, "  \"toom3_threshold\": %d,\n", TOOM3_THRESHOLD);
+	fprintf(file, "  \"ntt_threshold\": %d,\n", NTT_THRESHOLD);
+	fprintf(file, "  \"dec_threshold\": %d,\n", DEC_THRESHOLD);
+	fprintf(file, "  \"lex_kernels\": \"%s\",\n", lex_kernel);
+	fprintf(file, "  \"runs\": %d,\n", runs);
+	fprintf(file, "  \"programs\": [\n");
+
+	int i, j;
+	for(i = 0; i<num_of_results; i++)
+	{
+		fprintf(file, "    {\n");
+		fprintf(file, "      \"name\": \"%s\",\n", results[i].name);
+		fprintf(file, "      \"bytes\": %lu,\n", (unsigned long)results[i].bytes);
+		fprintf(file, "      \"tokens\": %d,\n", results[i].tokens);
+		fprintf(file, "      \"insts\": %d,\n", results[i].insts);
+		fprintf(file, "      \"seconds\": {\n");
+
+		for(j = 0; j<num_of_stages; j++)
+		{
+			fprintf(file, "        \"%s\": ", stage_names[j]);
+			print_stats(file, &results[i].stage[j]);
+			fprintf(file, j < num_of_stages - 1 ? ",\n" : "\n");
+		}
+
+		fprintf(file, "      }\n");
+		fprintf(file, i < num_of_results - 1 ? "    },\n" : "    }\n");
+	}
+
+	fprintf(file, "  ]\n");
+	fprintf(file, "}\n");
+}
+
+int main(int argc, char **argv)
+{
+	char *programs[] = {"recursion", "loop", "arith", "bignum", "tail", "fib"};
+	int num_of_programs = sizeof(programs) / sizeof(programs[0]);
+
+	int runs = 10;
+	int funcs = 5000;
+	char *corpus = "bench/corpus";
+	char *out = "bench/results.json";
+	char *lex = NULL;
+
+	int i;
+	for(i = 1; i + 1<argc; i += 2)
+	{
+		if(strcmp(argv[i], "-runs") == 0)
+		{
+			runs = atoi(argv[i+1]);
+		} else if(strcmp(argv[i], "-funcs") == 0)
+		{
+			funcs = atoi(argv[i+1]);
+		} else if(strcmp(argv[i], "-corpus") == 0)
+		{
+			corpus = argv[i+1];
+		} else if(strcmp(argv[i], "-lex") == 0)
+		{
+			lex = argv[i+1];
+		} else if(strcmp(argv[i], "-o") == 0)
+		{
+			out = argv[i+1];
+		}
+	}
+
+	if(runs < 1) runs = 1;
+
+	if(lex == NULL)
+	{
+		pick_kernels();
+	} else if(set_kernels(lex) != 0)
+	{
+		printf("ERROR! no '%s' lexer kernels here!\n", lex);
+		return -1;
+	}
+
+	struct result *results = malloc((num_of_programs + 1) * sizeof(struct result));
+
+	for(i = 0; i<num_of_programs; i++)
+	{
+		char path[1024];
+		snprintf(path, sizeof(path), "%s/%s.bl", corpus, programs[i]);
+
+		struct source *source = open_source(path, 1);
+		results[i] = bench(programs[i], source->code, runs);
+		close_source(source);
+	}
+
+	char *generated = generate(funcs);
+	results[num_of_programs] = bench("generated", generated, runs);
+	free(generated);
+
+	printf("%-10s", "program");
+	for(i = 0; i<num_of_stages; i++) printf(" %10s", stage_names[i]);
+	printf("  lex MB/s   (median seconds over %d runs, %s lexer)\n", runs, lex_kernel);
+	for(i = 0; i<=num_of_programs; i++)
+	{
+		printf("%-10s", results[i].name);
+
+		int j;
+		for(j = 0; j<num_of_stages; j++) printf(" %10.6f", results[i].stage[j].median);
+		printf(" %10.1f", results[i].bytes / results[i].stage[stage_lex].median / 1e6);
+
+		printf("\n");
+	}
+
+	FILE *file = fopen(out, "w");
+	if(file == NULL)
+	{
+		printf("ERROR! unable to write '%s'!\n", out);
+		return -1;
+	}
+
+	write_json(file, results, num_of_programs + 1, runs);
+	fclose(file);
+
+	printf("results written to %s\n", out);
+
+	free(results);
+
+	return 0;
+}
\ No newline at end of file